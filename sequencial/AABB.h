@@ -0,0 +1,108 @@
+//
+// Created by dominik on 17.10.26.
+//
+
+#ifndef SEQUENCIAL_AABB_H
+#define SEQUENCIAL_AABB_H
+
+#include "Vector.h"
+#include <limits>
+
+/**
+ * @brief Axis-aligned bounding box
+ *
+ * A default constructed box is empty (min is +infinity and max is -infinity), so growing it by any point or box gives that point or box.
+ * Objects without bounds (e.g. infinite planes) return an infinite box, see isFinite
+ */
+struct AABB
+{
+   Vector3f minPoint{ std::numeric_limits<float>::infinity(), std::numeric_limits<float>::infinity(),
+                      std::numeric_limits<float>::infinity() };
+   Vector3f maxPoint{ -std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity(),
+                      -std::numeric_limits<float>::infinity() };
+
+   AABB() = default;
+
+   AABB( const Vector3f& minPoint, const Vector3f& maxPoint ) : minPoint( minPoint ), maxPoint( maxPoint )
+   {
+   }
+
+   static AABB infinite()
+   {
+      constexpr float inf = std::numeric_limits<float>::infinity();
+      return { Vector3f( -inf, -inf, -inf ), Vector3f( inf, inf, inf ) };
+   }
+
+   void grow( const Vector3f& point )
+   {
+      minPoint = VectorOps::min( minPoint, point );
+      maxPoint = VectorOps::max( maxPoint, point );
+   }
+
+   void grow( const AABB& other )
+   {
+      minPoint = VectorOps::min( minPoint, other.minPoint );
+      maxPoint = VectorOps::max( maxPoint, other.maxPoint );
+   }
+
+   [[nodiscard]] bool isEmpty() const
+   {
+      return minPoint.x() > maxPoint.x() || minPoint.y() > maxPoint.y() || minPoint.z() > maxPoint.z();
+   }
+
+   [[nodiscard]] bool isFinite() const
+   {
+      for( size_t i = 0; i < 3; ++i )
+      {
+         if( !std::isfinite( minPoint[ i ] ) || !std::isfinite( maxPoint[ i ] ) )
+            return false;
+      }
+      return true;
+   }
+
+   [[nodiscard]] Vector3f extents() const
+   {
+      return maxPoint - minPoint;
+   }
+
+   [[nodiscard]] Vector3f centroid() const
+   {
+      return ( minPoint + maxPoint ) * 0.5f;
+   }
+
+   [[nodiscard]] float surfaceArea() const
+   {
+      if( isEmpty() )
+         return 0.f;
+
+      auto e = extents();
+      return 2.f * ( e.x() * e.y() + e.y() * e.z() + e.z() * e.x() );
+   }
+
+   /**
+    * @brief Ray-box slab test. The same math as in Block::intersects, but only the entry distance is computed
+    * @param origin Ray start point
+    * @param inverseDirection Inverse of the ray direction
+    * @param maxDistance Hits further than this distance are ignored
+    * @param entryDistance Out parameter with the distance where the ray enters the box. Negative if the ray starts inside
+    * @return True if the ray hits the box closer than maxDistance
+    */
+   bool intersects( const Vector3f& origin, const Vector3f& inverseDirection, float maxDistance, float& entryDistance ) const
+   {
+      // Written per component, this runs for every visited BVH node
+      float tx1 = ( minPoint.x() - origin.x() ) * inverseDirection.x();
+      float tx2 = ( maxPoint.x() - origin.x() ) * inverseDirection.x();
+      float ty1 = ( minPoint.y() - origin.y() ) * inverseDirection.y();
+      float ty2 = ( maxPoint.y() - origin.y() ) * inverseDirection.y();
+      float tz1 = ( minPoint.z() - origin.z() ) * inverseDirection.z();
+      float tz2 = ( maxPoint.z() - origin.z() ) * inverseDirection.z();
+
+      float tMin = std::max( std::max( std::min( tx1, tx2 ), std::min( ty1, ty2 ) ), std::min( tz1, tz2 ) );
+      float tMax = std::min( std::min( std::max( tx1, tx2 ), std::max( ty1, ty2 ) ), std::max( tz1, tz2 ) );
+
+      entryDistance = tMin;
+      return tMax >= std::max( tMin, 0.f ) && tMin < maxDistance;
+   }
+};
+
+#endif //SEQUENCIAL_AABB_H
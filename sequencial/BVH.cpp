@@ -0,0 +1,251 @@
+//
+// Created by dominik on 17.10.26.
+//
+
+#include "BVH.h"
+#include <algorithm>
+#include <numeric>
+
+BVH::BVH( const std::vector<AABB>& primitiveBounds, uint32_t maxLeafSize )
+   : maxLeafSize( std::max( 1u, maxLeafSize ) )
+{
+   if( primitiveBounds.empty() )
+      return;
+
+   auto primitiveCount = static_cast<uint32_t>( primitiveBounds.size() );
+   primitiveIndices.resize( primitiveCount );
+   std::iota( primitiveIndices.begin(), primitiveIndices.end(), 0u );
+
+   std::vector<Vector3f> centroids;
+   centroids.reserve( primitiveCount );
+   for( const auto& bounds: primitiveBounds )
+      centroids.emplace_back( bounds.centroid() );
+
+   // A binary tree with N leaves has 2N - 1 nodes
+   nodes.reserve( 2 * primitiveCount - 1 );
+   Node root;
+   root.leftFirst = 0;
+   root.primitiveCount = primitiveCount;
+   for( const auto& bounds: primitiveBounds )
+      root.bounds.grow( bounds );
+   nodes.push_back( root );
+
+   subdivide( 0, primitiveBounds, centroids, 0 );
+   nodes.shrink_to_fit();
+}
+
+BVH::BVH( MappedArray<Node> nodes ) : nodes( std::move( nodes ) )
+{
+}
+
+const std::vector<uint32_t>& BVH::getPrimitiveIndices() const
+{
+   return primitiveIndices;
+}
+
+const MappedArray<BVH::Node>& BVH::getNodes() const
+{
+   return nodes;
+}
+
+bool BVH::isEmpty() const
+{
+   return nodes.empty();
+}
+
+bool BVH::isValid( size_t primitiveCount ) const
+{
+   // The children come after their parents, so the depth of a node is final once the loop gets to it
+   std::vector<uint8_t> depths( nodes.size(), 0 );
+   for( size_t i = 0; i < nodes.size(); ++i )
+   {
+      const Node& node = nodes[ i ];
+      if( node.isLeaf() )
+      {
+         if( static_cast<uint64_t>( node.leftFirst ) + node.primitiveCount > primitiveCount )
+            return false;
+         continue;
+      }
+
+      if( node.leftFirst <= i || static_cast<uint64_t>( node.leftFirst ) + 1 >= nodes.size() || depths[ i ] + 1 >= MAX_DEPTH )
+         return false;
+      auto childDepth = static_cast<uint8_t>( depths[ i ] + 1 );
+      depths[ node.leftFirst ] = std::max( depths[ node.leftFirst ], childDepth );
+      depths[ node.leftFirst + 1 ] = std::max( depths[ node.leftFirst + 1 ], childDepth );
+   }
+   return true;
+}
+
+float BVH::getDegradation() const
+{
+   if( parents.empty() || initialCost <= 0.0 )
+      return 1.f;
+
+   double rootArea = std::max( static_cast<double>( nodes[ 0 ].bounds.surfaceArea() ), static_cast<double>( std::numeric_limits<float>::min() ) );
+   return static_cast<float>( cost / rootArea / initialCost );
+}
+
+double BVH::nodeCost( const Node& node, const AABB& bounds )
+{
+   double area = bounds.surfaceArea();
+   return node.isLeaf() ? area * INTERSECTION_COST * node.primitiveCount : area * TRAVERSAL_COST;
+}
+
+void BVH::prepareRefit()
+{
+   if( !parents.empty() )
+      return;
+
+   parents.assign( nodes.size(), 0 );
+   cost = 0.0;
+   for( uint32_t i = 0; i < nodes.size(); ++i )
+   {
+      const Node& node = nodes[ i ];
+      cost += nodeCost( node, node.bounds );
+      if( node.isLeaf() )
+      {
+         if( primitiveLeaves.size() < node.leftFirst + node.primitiveCount )
+            primitiveLeaves.resize( node.leftFirst + node.primitiveCount );
+         std::fill_n( primitiveLeaves.begin() + node.leftFirst, node.primitiveCount, i );
+      }
+      else
+      {
+         parents[ node.leftFirst ] = i;
+         parents[ node.leftFirst + 1 ] = i;
+      }
+   }
+
+   double rootArea = std::max( static_cast<double>( nodes[ 0 ].bounds.surfaceArea() ), static_cast<double>( std::numeric_limits<float>::min() ) );
+   initialCost = cost / rootArea;
+}
+
+void BVH::subdivide( uint32_t nodeIndex, const std::vector<AABB>& primitiveBounds, const std::vector<Vector3f>& centroids,
+                     int depth )
+{
+   // Copy, the node vector may reallocate while we add children
+   Node node = nodes[ nodeIndex ];
+
+   if( node.primitiveCount <= 1 || depth >= MAX_DEPTH - 1 )
+      return;
+
+   Split split = findBestSplit( node, primitiveBounds, centroids );
+   float leafCost = INTERSECTION_COST * static_cast<float>( node.primitiveCount );
+
+   // Small nodes become leaves when splitting doesn't pay off. Large nodes are always split to keep the leaves short
+   if( split.axis < 0 || ( split.cost >= leafCost && node.primitiveCount <= maxLeafSize ) )
+      return;
+
+   auto first = primitiveIndices.begin() + node.leftFirst;
+   auto last = first + node.primitiveCount;
+   auto middle = std::partition( first, last, [ & ]( uint32_t index )
+   {
+      return split.binOf( centroids[ index ] ) <= split.bin;
+   } );
+
+   // Should not happen since the split is between two non-empty bins, but keep a median split as a safety net against rounding
+   if( middle == first || middle == last )
+   {
+      middle = first + node.primitiveCount / 2;
+      int axis = split.axis;
+      std::nth_element( first, middle, last, [ & ]( uint32_t a, uint32_t b )
+      {
+         return centroids[ a ][ axis ] < centroids[ b ][ axis ];
+      } );
+   }
+
+   auto leftCount = static_cast<uint32_t>( middle - first );
+   auto leftIndex = static_cast<uint32_t>( nodes.size() );
+
+   Node left, right;
+   left.leftFirst = node.leftFirst;
+   left.primitiveCount = leftCount;
+   right.leftFirst = node.leftFirst + leftCount;
+   right.primitiveCount = node.primitiveCount - leftCount;
+
+   for( auto i = left.leftFirst; i < left.leftFirst + left.primitiveCount; ++i )
+      left.bounds.grow( primitiveBounds[ primitiveIndices[ i ] ] );
+   for( auto i = right.leftFirst; i < right.leftFirst + right.primitiveCount; ++i )
+      right.bounds.grow( primitiveBounds[ primitiveIndices[ i ] ] );
+
+   nodes.push_back( left );
+   nodes.push_back( right );
+
+   nodes[ nodeIndex ].leftFirst = leftIndex;
+   nodes[ nodeIndex ].primitiveCount = 0;
+
+   subdivide( leftIndex, primitiveBounds, centroids, depth + 1 );
+   subdivide( leftIndex + 1, primitiveBounds, centroids, depth + 1 );
+}
+
+BVH::Split BVH::findBestSplit( const Node& node, const std::vector<AABB>& primitiveBounds,
+                               const std::vector<Vector3f>& centroids ) const
+{
+   Split best;
+
+   AABB centroidBounds;
+   for( auto i = node.leftFirst; i < node.leftFirst + node.primitiveCount; ++i )
+      centroidBounds.grow( centroids[ primitiveIndices[ i ] ] );
+
+   // Guard against flat nodes (e.g. a single axis-aligned primitive), which have no area
+   float parentArea = std::max( node.bounds.surfaceArea(), std::numeric_limits<float>::min() );
+   float bestCost = std::numeric_limits<float>::infinity();
+
+   for( int axis = 0; axis < 3; ++axis )
+   {
+      float axisMin = centroidBounds.minPoint[ axis ];
+      float axisMax = centroidBounds.maxPoint[ axis ];
+      if( axisMax <= axisMin )
+         continue;
+
+      Split candidate;
+      candidate.axis = axis;
+      candidate.binMin = axisMin;
+      candidate.binScale = static_cast<float>( BIN_COUNT ) / ( axisMax - axisMin );
+
+      AABB binBounds[ BIN_COUNT ];
+      uint32_t binCounts[ BIN_COUNT ] = {};
+      for( auto i = node.leftFirst; i < node.leftFirst + node.primitiveCount; ++i )
+      {
+         auto primitive = primitiveIndices[ i ];
+         int bin = candidate.binOf( centroids[ primitive ] );
+         ++binCounts[ bin ];
+         binBounds[ bin ].grow( primitiveBounds[ primitive ] );
+      }
+
+      // Costs of the planes between the bins. Sweep from both sides accumulating the counts and areas
+      float leftAreas[ BIN_COUNT - 1 ], rightAreas[ BIN_COUNT - 1 ];
+      uint32_t leftCounts[ BIN_COUNT - 1 ], rightCounts[ BIN_COUNT - 1 ];
+      AABB leftBox, rightBox;
+      uint32_t leftSum = 0, rightSum = 0;
+      for( int i = 0; i < BIN_COUNT - 1; ++i )
+      {
+         leftSum += binCounts[ i ];
+         leftBox.grow( binBounds[ i ] );
+         leftCounts[ i ] = leftSum;
+         leftAreas[ i ] = leftBox.surfaceArea();
+
+         rightSum += binCounts[ BIN_COUNT - 1 - i ];
+         rightBox.grow( binBounds[ BIN_COUNT - 1 - i ] );
+         rightCounts[ BIN_COUNT - 2 - i ] = rightSum;
+         rightAreas[ BIN_COUNT - 2 - i ] = rightBox.surfaceArea();
+      }
+
+      for( int i = 0; i < BIN_COUNT - 1; ++i )
+      {
+         if( leftCounts[ i ] == 0 || rightCounts[ i ] == 0 )
+            continue;
+
+         float cost = static_cast<float>( leftCounts[ i ] ) * leftAreas[ i ] +
+                      static_cast<float>( rightCounts[ i ] ) * rightAreas[ i ];
+         if( cost < bestCost )
+         {
+            bestCost = cost;
+            best = candidate;
+            best.bin = i;
+         }
+      }
+   }
+
+   best.cost = TRAVERSAL_COST + INTERSECTION_COST * bestCost / parentArea;
+   return best;
+}
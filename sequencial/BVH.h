@@ -0,0 +1,254 @@
+//
+// Created by dominik on 17.10.26.
+//
+
+#ifndef SEQUENCIAL_BVH_H
+#define SEQUENCIAL_BVH_H
+
+#include "AABB.h"
+#include "MappedArray.h"
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Bounding volume hierarchy over a list of primitive bounding boxes
+ *
+ * The tree is built top-down using the surface area heuristic (SAH) evaluated over a fixed number of bins per axis.
+ * The nodes are stored in a flat array. The children of an interior node are always stored next to each other, so a node only stores the index of its left child.
+ * The BVH doesn't know anything about the primitives themselves. It only reorders their indices, so that every leaf references a contiguous range of getPrimitiveIndices().
+ * The owner of the primitives is expected to reorder its primitives in the same way, so the leaves reference contiguous ranges of primitives.
+ *
+ * When the primitives move, refit updates the bounds of the affected nodes without rebuilding the tree.
+ * The tree gets worse as the primitives move away from where it was built, getDegradation tells when a rebuild pays off
+ */
+class BVH
+{
+   public:
+      struct Node
+      {
+         AABB bounds;
+         // Index of the left child for interior nodes (right child is leftFirst + 1) or index of the first primitive for leaves
+         uint32_t leftFirst = 0;
+         // Number of primitives in a leaf. 0 for interior nodes
+         uint32_t primitiveCount = 0;
+
+         [[nodiscard]] bool isLeaf() const
+         {
+            return primitiveCount > 0;
+         }
+      };
+
+      BVH() = default;
+
+      /**
+       * @brief Builds the hierarchy
+       * @param primitiveBounds Bounding boxes of all primitives. All of them have to be finite
+       * @param maxLeafSize Leaves with up to this many primitives are kept when splitting them doesn't pay off. Larger values suit SIMD leaf kernels
+       */
+      explicit BVH( const std::vector<AABB>& primitiveBounds, uint32_t maxLeafSize = MAX_LEAF_SIZE );
+
+      /**
+       * @brief Uses already built nodes, e.g. mapped from a scene file. The primitive indices aren't known, getPrimitiveIndices is empty
+       */
+      explicit BVH( MappedArray<Node> nodes );
+
+      /**
+       * @brief Traverses the hierarchy front to back and calls the leaf function for every leaf the ray hits
+       *
+       * @param origin Ray start point
+       * @param inverseDirection Inverse of the ray direction
+       * @param maxDistance In/out parameter with the current closest hit distance. Nodes further than this are skipped. The leaf function is expected to shrink it when it finds a closer hit
+       * @param leafFunction Callable as bool( uint32_t first, uint32_t count, float& maxDistance ). The range references primitives in the BVH order.
+       * Returning true stops the traversal (e.g. for occlusion queries)
+       * @return True if the leaf function stopped the traversal
+       */
+      template<typename LeafFunction>
+      bool traverse( const Vector3f& origin, const Vector3f& inverseDirection, float& maxDistance,
+                     LeafFunction&& leafFunction ) const;
+
+      /**
+       * @brief Updates the node bounds after some primitives changed, without changing the tree structure
+       *
+       * Only the leaves of the changed primitives and their ancestors are recomputed, so the cost is O(changed primitives * tree depth).
+       * The parent links needed for it are computed by the first refit
+       * @param changedPositions Positions of the changed primitives in the BVH order
+       * @param boundsFunction Callable as AABB( uint32_t position ), the current bounds of the primitive at a position in the BVH order
+       */
+      template<typename BoundsFunction>
+      void refit( const std::vector<uint32_t>& changedPositions, BoundsFunction&& boundsFunction );
+
+      /**
+       * @return SAH cost of the tree relative to its cost before the first refit. Grows as the refitted nodes get larger and overlap
+       */
+      [[nodiscard]] float getDegradation() const;
+
+      /**
+       * @return The original primitive indices in the BVH order. Leaf ranges index into this array
+       */
+      [[nodiscard]] const std::vector<uint32_t>& getPrimitiveIndices() const;
+
+      [[nodiscard]] const MappedArray<Node>& getNodes() const;
+
+      [[nodiscard]] bool isEmpty() const;
+
+      /**
+       * @brief Checks nodes which weren't built here (mapped from a file), so the traversal can't read outside the nodes or primitives
+       *
+       * The children have to follow their parent (which rules out cycles), the tree can't be deeper than the traversal stack,
+       * and the leaf ranges have to lie within the primitives. Costs one pass over the nodes
+       * @param primitiveCount Number of primitives the leaves reference
+       */
+      [[nodiscard]] bool isValid( size_t primitiveCount ) const;
+
+      static constexpr uint32_t MAX_LEAF_SIZE = 4;
+      static constexpr int MAX_DEPTH = 64;
+
+   private:
+      static constexpr int BIN_COUNT = 16;
+      // Relative cost of traversing a node compared to intersecting a primitive
+      static constexpr float TRAVERSAL_COST = 1.f;
+      static constexpr float INTERSECTION_COST = 1.f;
+
+      // A split plane between two centroid bins along one axis
+      struct Split
+      {
+         int axis = -1;
+         // Bins up to and including this one go to the left child
+         int bin = 0;
+         float binMin = 0.f;
+         float binScale = 0.f;
+         float cost = std::numeric_limits<float>::infinity();
+
+         [[nodiscard]] int binOf( const Vector3f& centroid ) const
+         {
+            int index = static_cast<int>( ( centroid[ axis ] - binMin ) * binScale );
+            return std::clamp( index, 0, BIN_COUNT - 1 );
+         }
+      };
+
+      void subdivide( uint32_t nodeIndex, const std::vector<AABB>& primitiveBounds, const std::vector<Vector3f>& centroids,
+                      int depth );
+
+      /**
+       * Finds the best split plane of a node using binned SAH
+       * @return The split with its SAH cost. The axis is -1 if the node can't be split (all centroids are equal)
+       */
+      Split findBestSplit( const Node& node, const std::vector<AABB>& primitiveBounds,
+                           const std::vector<Vector3f>& centroids ) const;
+
+      // SAH cost of a node with the given bounds, not yet divided by the root area
+      [[nodiscard]] static double nodeCost( const Node& node, const AABB& bounds );
+
+      // Computes the parent links, the leaf of every primitive, and the tree cost when the first refit needs them
+      void prepareRefit();
+
+      MappedArray<Node> nodes;
+      std::vector<uint32_t> primitiveIndices;
+      uint32_t maxLeafSize = MAX_LEAF_SIZE;
+      // Refit data, empty until the first refit
+      std::vector<uint32_t> parents;
+      std::vector<uint32_t> primitiveLeaves;
+      // Sum of nodeCost over all nodes, kept up to date by refit
+      double cost = 0.0;
+      // Cost divided by the root area before the first refit
+      double initialCost = 0.0;
+};
+
+template<typename LeafFunction>
+bool BVH::traverse( const Vector3f& origin, const Vector3f& inverseDirection, float& maxDistance,
+                    LeafFunction&& leafFunction ) const
+{
+   if( nodes.empty() )
+      return false;
+
+   float entry;
+   if( !nodes[ 0 ].bounds.intersects( origin, inverseDirection, maxDistance, entry ) )
+      return false;
+
+   // Stack of nodes to visit together with their entry distance, so we can skip them if a closer hit was found in the meantime
+   uint32_t stack[ MAX_DEPTH ];
+   float stackDistances[ MAX_DEPTH ];
+   int stackSize = 0;
+   uint32_t current = 0;
+
+   while( true )
+   {
+      const Node& node = nodes[ current ];
+
+      if( node.isLeaf() )
+      {
+         if( leafFunction( node.leftFirst, node.primitiveCount, maxDistance ) )
+            return true;
+      }
+      else
+      {
+         float leftEntry, rightEntry;
+         bool hitLeft = nodes[ node.leftFirst ].bounds.intersects( origin, inverseDirection, maxDistance, leftEntry );
+         bool hitRight = nodes[ node.leftFirst + 1 ].bounds.intersects( origin, inverseDirection, maxDistance, rightEntry );
+
+         if( hitLeft && hitRight )
+         {
+            // Visit the closer child first and postpone the other one
+            bool leftFirst = leftEntry <= rightEntry;
+            current = leftFirst ? node.leftFirst : node.leftFirst + 1;
+            stack[ stackSize ] = leftFirst ? node.leftFirst + 1 : node.leftFirst;
+            stackDistances[ stackSize++ ] = leftFirst ? rightEntry : leftEntry;
+            continue;
+         }
+         if( hitLeft || hitRight )
+         {
+            current = hitLeft ? node.leftFirst : node.leftFirst + 1;
+            continue;
+         }
+      }
+
+      // Pop the next node which is still closer than the closest hit
+      do
+      {
+         if( stackSize == 0 )
+            return false;
+         --stackSize;
+      } while( stackDistances[ stackSize ] >= maxDistance );
+      current = stack[ stackSize ];
+   }
+}
+
+template<typename BoundsFunction>
+void BVH::refit( const std::vector<uint32_t>& changedPositions, BoundsFunction&& boundsFunction )
+{
+   if( nodes.empty() || changedPositions.empty() )
+      return;
+   prepareRefit();
+
+   for( auto position: changedPositions )
+   {
+      // Walk up from the leaf until a node doesn't change. The nodes above it are then up to date too
+      uint32_t current = primitiveLeaves[ position ];
+      while( true )
+      {
+         Node& node = nodes[ current ];
+         AABB bounds;
+         if( node.isLeaf() )
+         {
+            for( auto i = node.leftFirst; i < node.leftFirst + node.primitiveCount; ++i )
+               bounds.grow( boundsFunction( i ) );
+         }
+         else
+         {
+            bounds = nodes[ node.leftFirst ].bounds;
+            bounds.grow( nodes[ node.leftFirst + 1 ].bounds );
+         }
+
+         if( bounds.minPoint == node.bounds.minPoint && bounds.maxPoint == node.bounds.maxPoint )
+            break;
+         cost += nodeCost( node, bounds ) - nodeCost( node, node.bounds );
+         node.bounds = bounds;
+
+         if( current == 0 )
+            break;
+         current = parents[ current ];
+      }
+   }
+}
+
+#endif //SEQUENCIAL_BVH_H
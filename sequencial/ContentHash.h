@@ -0,0 +1,102 @@
+//
+// Created by dominik on 18.10.26.
+//
+
+#ifndef SEQUENCIAL_CONTENTHASH_H
+#define SEQUENCIAL_CONTENTHASH_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+/**
+ * @brief Streaming 128-bit hash of binary data, used to address the contents of rendered frames (see FrameCache)
+ *
+ * Not a cryptographic hash. Every 8 bytes are mixed into two lanes with different multipliers (the MurmurHash64A step),
+ * and every added buffer mixes in its size, so splitting the same bytes into different buffers gives a different hash.
+ * Only memory without padding bytes can be added, the values of the padding are undefined
+ */
+class ContentHash
+{
+   public:
+      void add( const void* data, size_t size )
+      {
+         const auto* bytes = static_cast<const unsigned char*>( data );
+         size_t end = size / 8 * 8;
+         for( size_t i = 0; i < end; i += 8 )
+         {
+            uint64_t word;
+            std::memcpy( &word, bytes + i, 8 );
+            mix( word );
+         }
+
+         uint64_t tail = 0;
+         if( size > end )
+            std::memcpy( &tail, bytes + end, size - end );
+         mix( tail );
+         mix( size );
+      }
+
+      template<typename T>
+      void addValue( const T& value )
+      {
+         static_assert( std::has_unique_object_representations_v<T> || std::is_floating_point_v<T>, "The value has padding bytes" );
+         add( &value, sizeof( value ) );
+      }
+
+      // Adds the elements of a contiguous container (a std::vector or MappedArray) of types without padding
+      template<typename Array>
+      void addArray( const Array& array )
+      {
+         add( array.data(), array.size() * sizeof( array[ 0 ] ) );
+      }
+
+      void addString( const std::string& text )
+      {
+         add( text.data(), text.size() );
+      }
+
+      /**
+       * @return The hash as 32 lowercase hexadecimal digits
+       */
+      [[nodiscard]] std::string toString() const
+      {
+         static constexpr char digits[] = "0123456789abcdef";
+         std::string text;
+         for( uint64_t lane: lanes )
+         {
+            for( int shift = 60; shift >= 0; shift -= 4 )
+               text.push_back( digits[ ( finish( lane ) >> shift ) & 0xF ] );
+         }
+         return text;
+      }
+
+   private:
+      static constexpr uint64_t MULTIPLIERS[ 2 ] = { 0xC6A4A7935BD1E995ull, 0x9E3779B97F4A7C15ull };
+
+      void mix( uint64_t word )
+      {
+         for( int lane = 0; lane < 2; ++lane )
+         {
+            uint64_t k = word * MULTIPLIERS[ lane ];
+            k ^= k >> 47;
+            k *= MULTIPLIERS[ lane ];
+            lanes[ lane ] = ( lanes[ lane ] ^ k ) * MULTIPLIERS[ lane ];
+         }
+      }
+
+      // Final avalanche, so the last words affect all the bits
+      static uint64_t finish( uint64_t lane )
+      {
+         lane ^= lane >> 33;
+         lane *= 0xFF51AFD7ED558CCDull;
+         lane ^= lane >> 33;
+         lane *= 0xC4CEB9FE1A85EC53ull;
+         return lane ^ ( lane >> 33 );
+      }
+
+      uint64_t lanes[ 2 ] = { 0x243F6A8885A308D3ull, 0x13198A2E03707344ull };
+};
+
+#endif //SEQUENCIAL_CONTENTHASH_H
@@ -0,0 +1,86 @@
+//
+// Created by dominik on 18.10.26.
+//
+
+#include "RenderDaemon.h"
+#include <charconv>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+   // A whole number from 0 to maxCount. from_chars doesn't accept a sign, so "-1" isn't wrapped around to a huge count
+   unsigned int parseCount( const std::string& argument, const std::string& value, unsigned int maxCount )
+   {
+      unsigned int count = 0;
+      auto result = std::from_chars( value.data(), value.data() + value.size(), count );
+      if( result.ec != std::errc() || result.ptr != value.data() + value.size() || count > maxCount )
+         throw std::runtime_error( argument + " needs a number from 0 to " + std::to_string( maxCount ) + ", got " + value );
+      return count;
+   }
+}
+
+/**
+ * @brief Runs the renderer as a daemon which keeps the scenes loaded and renders the jobs received over a Unix domain socket (see RenderDaemon)
+ *
+ * --threads sets the size of the pool shared by all jobs (all hardware threads by default), --jobs the number of jobs rendered at once,
+ * --preload loads a scene before the first job, and --cache enables the frame cache in a directory, with a size limit in MB set by --cache-size
+ * (1024 MB by default). The commands can be sent by any socket client, e.g.
+ * echo "render 3 level3.png priority=1" | socat - UNIX-CONNECT:/tmp/raytracer.sock
+ *
+ * Usage: renderdaemon <socket path> [--threads T] [--jobs J] [--cache directory] [--cache-size MB] [--preload scene]...
+ */
+int main( int argc, char** argv )
+{
+   if( argc < 2 || argc % 2 != 0 )
+   {
+      std::cout << "Usage: " << argv[ 0 ] << " <socket path> [--threads T] [--jobs J] [--cache directory] [--cache-size MB] [--preload scene]..." << std::endl;
+      std::cout << "Commands: render <scene> <output> [priority=N] [width=N] [height=N] [fov=DEGREES] [distance=D] [compression=fast|balanced|max], "
+            "load <scene>, unload <scene>, status, quit, shutdown" << std::endl;
+      return -1;
+   }
+
+   try
+   {
+      unsigned int threadCount = 0, concurrentJobs = RenderDaemon::DEFAULT_CONCURRENT_JOBS;
+      std::vector<std::string> preloaded;
+      std::string cacheDirectory;
+      uint64_t cacheSize = FrameCache::DEFAULT_MAX_SIZE;
+      for( int i = 2; i < argc; i += 2 )
+      {
+         std::string argument = argv[ i ], value = argv[ i + 1 ];
+         if( argument == "--threads" )
+            threadCount = parseCount( argument, value, ThreadPool::MAX_THREAD_COUNT );
+         else if( argument == "--jobs" )
+            concurrentJobs = parseCount( argument, value, ThreadPool::MAX_THREAD_COUNT );
+         else if( argument == "--cache" )
+            cacheDirectory = value;
+         else if( argument == "--cache-size" )
+         {
+            auto size = FrameCache::parseMegabytes( value );
+            if( !size )
+               throw std::runtime_error( "--cache-size needs a size in MB" );
+            cacheSize = *size;
+         }
+         else if( argument == "--preload" )
+            preloaded.push_back( value );
+         else
+            throw std::runtime_error( "Unknown argument " + argument );
+      }
+
+      RenderDaemon daemon( threadCount, concurrentJobs );
+      if( !cacheDirectory.empty() )
+         daemon.enableFrameCache( cacheDirectory, cacheSize );
+      for( const auto& scene: preloaded )
+         std::cout << "Loaded " << scene << " in " << daemon.loadScene( scene ) << " ms" << std::endl;
+
+      std::cout << "Listening on " << argv[ 1 ] << std::endl;
+      daemon.serve( argv[ 1 ] );
+   }
+   catch( const std::exception& error )
+   {
+      std::cerr << error.what() << std::endl;
+      return -1;
+   }
+}
@@ -0,0 +1,551 @@
+//
+// Created by dominik on 18.10.26.
+//
+
+#include "Deflate.h"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+#include <queue>
+#include <stdexcept>
+
+namespace
+{
+   constexpr std::array<uint16_t, 29> LENGTH_BASE = {
+      3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+   };
+   constexpr std::array<uint8_t, 29> LENGTH_EXTRA_BITS = {
+      0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+   };
+   constexpr std::array<uint16_t, 30> DISTANCE_BASE = {
+      1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289,
+      16385, 24577
+   };
+   constexpr std::array<uint8_t, 30> DISTANCE_EXTRA_BITS = {
+      0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+   };
+   // Order in which the code lengths of the code length code are stored
+   constexpr std::array<uint8_t, 19> CODE_LENGTH_ORDER = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+   // Length code (without the 257 offset) of every match length
+   constexpr auto LENGTH_CODE = []()
+   {
+      std::array<uint8_t, 259> codes{};
+      for( size_t length = 3; length < codes.size(); ++length )
+      {
+         size_t code = 0;
+         while( code + 1 < LENGTH_BASE.size() && LENGTH_BASE[ code + 1 ] <= length )
+            ++code;
+         codes[ length ] = static_cast<uint8_t>( code );
+      }
+      return codes;
+   }();
+
+   int distanceCode( unsigned int distance )
+   {
+      // Two codes per power of two, distinguished by the bit after the highest one
+      unsigned int value = distance - 1;
+      if( value < 4 )
+         return static_cast<int>( value );
+      int highestBit = std::bit_width( value ) - 1;
+      return 2 * highestBit + static_cast<int>( ( value >> ( highestBit - 1 ) ) & 1u );
+   }
+
+   // Every Huffman code needs at least two symbols, otherwise some decoders reject it as incomplete
+   void ensureTwoSymbols( std::vector<uint32_t>& frequencies )
+   {
+      auto used = std::count_if( frequencies.begin(), frequencies.end(), []( uint32_t frequency ) { return frequency > 0; } );
+      for( size_t i = 0; i < frequencies.size() && used < 2; ++i )
+      {
+         if( frequencies[ i ] == 0 )
+         {
+            frequencies[ i ] = 1;
+            ++used;
+         }
+      }
+   }
+
+   uint16_t reverseBits( uint16_t code, int length )
+   {
+      uint16_t reversed = 0;
+      for( int i = 0; i < length; ++i )
+      {
+         reversed = static_cast<uint16_t>( ( reversed << 1 ) | ( code & 1u ) );
+         code >>= 1;
+      }
+      return reversed;
+   }
+}
+
+// Indexed by CompressionLevel
+const DeflateStream::Settings DeflateStream::LEVEL_SETTINGS[] = {
+   { 8, 32, 0 },
+   { 128, 128, 32 },
+   { 1024, 258, 258 }
+};
+
+DeflateStream::DeflateStream( CompressionLevel level, Format format )
+   : settings( LEVEL_SETTINGS[ static_cast<int>( level ) ] ), format( format ), window( 2 * WINDOW_SIZE ), head( HASH_SIZE, -1 ),
+     previous( WINDOW_SIZE, -1 )
+{
+   symbols.reserve( BLOCK_SYMBOLS );
+}
+
+void DeflateStream::setDictionary( const unsigned char* data, size_t size )
+{
+   if( started )
+      throw std::logic_error( "The dictionary has to be set before writing any data" );
+
+   // Only the last window can be referred to
+   if( size > WINDOW_SIZE )
+   {
+      data += size - WINDOW_SIZE;
+      size = WINDOW_SIZE;
+   }
+
+   if( size > 0 )
+      std::memcpy( window.data(), data, size );
+   windowEnd = size;
+   position = size;
+   for( size_t i = 0; i + MIN_MATCH <= size; ++i )
+      insertHash( i );
+}
+
+void DeflateStream::write( const unsigned char* data, size_t size )
+{
+   if( !started )
+   {
+      started = true;
+      // zlib header: deflate with a 32 KB window, default compression
+      if( format == Format::ZLIB )
+         output.insert( output.end(), { 0x78, 0x9C } );
+   }
+   updateAdler( data, size );
+
+   while( size > 0 )
+   {
+      if( windowEnd == window.size() )
+         slideWindow();
+
+      size_t count = std::min( size, window.size() - windowEnd );
+      std::memcpy( window.data() + windowEnd, data, count );
+      windowEnd += count;
+      data += count;
+      size -= count;
+
+      compress( false );
+   }
+}
+
+void DeflateStream::flush()
+{
+   write( nullptr, 0 );
+   compress( true );
+   if( !symbols.empty() )
+      writeBlock( false );
+
+   // Empty stored block: the block header, padding to a byte, and the zero length with its complement
+   writeBits( 0, 3 );
+   flushBits();
+   output.insert( output.end(), { 0x00, 0x00, 0xFF, 0xFF } );
+}
+
+void DeflateStream::finish()
+{
+   if( finished )
+      return;
+
+   write( nullptr, 0 );
+   compress( true );
+   writeBlock( true );
+   flushBits();
+
+   // Adler-32 checksum of the uncompressed data, big-endian
+   if( format == Format::ZLIB )
+   {
+      uint32_t adler = getAdler();
+      for( int shift = 24; shift >= 0; shift -= 8 )
+         output.push_back( static_cast<unsigned char>( adler >> shift ) );
+   }
+   finished = true;
+}
+
+const std::vector<unsigned char>& DeflateStream::getOutput() const
+{
+   return output;
+}
+
+void DeflateStream::clearOutput()
+{
+   output.clear();
+}
+
+uint32_t DeflateStream::getAdler() const
+{
+   return ( adlerB << 16 ) | adlerA;
+}
+
+uint32_t DeflateStream::combineAdler( uint32_t first, uint32_t second, size_t secondSize )
+{
+   // Every byte of the second piece adds the sum A of the first piece once more to its sum B
+   constexpr uint64_t modulo = 65521;
+   uint64_t remainder = secondSize % modulo;
+   uint64_t sumA = ( first & 0xFFFFu ) + ( second & 0xFFFFu ) + modulo - 1;
+   uint64_t sumB = ( first >> 16 ) + ( second >> 16 ) + remainder * ( first & 0xFFFFu ) + modulo - remainder;
+   return static_cast<uint32_t>( ( ( sumB % modulo ) << 16 ) | ( sumA % modulo ) );
+}
+
+void DeflateStream::compress( bool finishing )
+{
+   while( position < windowEnd )
+   {
+      size_t available = windowEnd - position;
+      // Without the whole lookahead, the match could be cut short by the end of the data which isn't written yet
+      if( !finishing && available < MAX_MATCH )
+         break;
+
+      size_t length = 0;
+      size_t distance = 0;
+      if( available >= MIN_MATCH )
+      {
+         length = findMatch( position, std::min( MAX_MATCH, available ), distance );
+         insertHash( position );
+
+         // Lazy matching: a short match is dropped when the next position starts a longer one
+         size_t nextDistance;
+         if( length > 0 && length < settings.maxLazyMatch && available > MIN_MATCH &&
+             findMatch( position + 1, std::min( MAX_MATCH, available - 1 ), nextDistance ) > length )
+            length = 0;
+      }
+
+      if( length > 0 )
+      {
+         symbols.push_back( { static_cast<uint16_t>( length ), static_cast<uint16_t>( distance ) } );
+         for( size_t i = 1; i < length && position + i + MIN_MATCH <= windowEnd; ++i )
+            insertHash( position + i );
+         position += length;
+      }
+      else
+      {
+         symbols.push_back( { window[ position ], 0 } );
+         ++position;
+      }
+
+      if( symbols.size() >= BLOCK_SYMBOLS )
+         writeBlock( false );
+   }
+}
+
+void DeflateStream::slideWindow()
+{
+   std::memmove( window.data(), window.data() + WINDOW_SIZE, WINDOW_SIZE );
+   windowEnd -= WINDOW_SIZE;
+   position -= WINDOW_SIZE;
+
+   auto slide = []( int32_t& entry )
+   {
+      entry = entry >= static_cast<int32_t>( WINDOW_SIZE ) ? entry - static_cast<int32_t>( WINDOW_SIZE ) : -1;
+   };
+   std::for_each( head.begin(), head.end(), slide );
+   std::for_each( previous.begin(), previous.end(), slide );
+}
+
+uint32_t DeflateStream::hashAt( size_t position ) const
+{
+   uint32_t bytes = window[ position ] | ( window[ position + 1 ] << 8 ) | ( window[ position + 2 ] << 16 );
+   return ( bytes * 2654435761u ) >> ( 32 - HASH_BITS );
+}
+
+void DeflateStream::insertHash( size_t position )
+{
+   uint32_t hash = hashAt( position );
+   previous[ position & ( WINDOW_SIZE - 1 ) ] = head[ hash ];
+   head[ hash ] = static_cast<int32_t>( position );
+}
+
+size_t DeflateStream::findMatch( size_t position, size_t maxLength, size_t& matchDistance ) const
+{
+   size_t bestLength = 0;
+   size_t limit = position > WINDOW_SIZE ? position - WINDOW_SIZE : 0;
+   int32_t candidate = head[ hashAt( position ) ];
+
+   for( int chain = 0; chain < settings.maxChain && candidate >= 0 && static_cast<size_t>( candidate ) >= limit; ++chain )
+   {
+      auto start = static_cast<size_t>( candidate );
+      // Only a longer match is interesting, so the byte which would make it longer is checked first
+      if( window[ start + bestLength ] == window[ position + bestLength ] )
+      {
+         size_t length = 0;
+         while( length < maxLength && window[ start + length ] == window[ position + length ] )
+            ++length;
+
+         if( length > bestLength )
+         {
+            bestLength = length;
+            matchDistance = position - start;
+            if( length >= settings.niceMatch || length == maxLength )
+               break;
+         }
+      }
+
+      int32_t next = previous[ start & ( WINDOW_SIZE - 1 ) ];
+      // The entry was overwritten by a newer position, the rest of the chain is too far
+      if( next >= candidate )
+         break;
+      candidate = next;
+   }
+
+   return bestLength >= MIN_MATCH ? bestLength : 0;
+}
+
+void DeflateStream::writeBlock( bool last )
+{
+   std::vector<uint32_t> literalLengthFrequencies( LITERAL_LENGTH_CODES, 0 );
+   std::vector<uint32_t> distanceFrequencies( DISTANCE_CODES, 0 );
+   for( const auto& symbol: symbols )
+   {
+      if( symbol.distance == 0 )
+         ++literalLengthFrequencies[ symbol.literalLength ];
+      else
+      {
+         ++literalLengthFrequencies[ END_OF_BLOCK + 1 + LENGTH_CODE[ symbol.literalLength ] ];
+         ++distanceFrequencies[ distanceCode( symbol.distance ) ];
+      }
+   }
+   ++literalLengthFrequencies[ END_OF_BLOCK ];
+   ensureTwoSymbols( literalLengthFrequencies );
+   ensureTwoSymbols( distanceFrequencies );
+
+   auto literalLengthCode = buildCode( literalLengthFrequencies, 15 );
+   auto distanceCodes = buildCode( distanceFrequencies, 15 );
+
+   int literalLengthCount = LITERAL_LENGTH_CODES;
+   while( literalLengthCount > END_OF_BLOCK + 1 && literalLengthCode.lengths[ literalLengthCount - 1 ] == 0 )
+      --literalLengthCount;
+   int distanceCount = DISTANCE_CODES;
+   while( distanceCount > 1 && distanceCodes.lengths[ distanceCount - 1 ] == 0 )
+      --distanceCount;
+
+   // Block header: the last block flag and the dynamic Huffman block type
+   writeBits( last ? 1 : 0, 1 );
+   writeBits( 2, 2 );
+   writeCodeLengths( literalLengthCode, literalLengthCount, distanceCodes, distanceCount );
+
+   for( const auto& symbol: symbols )
+   {
+      if( symbol.distance == 0 )
+      {
+         writeCode( literalLengthCode, symbol.literalLength );
+         continue;
+      }
+
+      int lengthCode = LENGTH_CODE[ symbol.literalLength ];
+      writeCode( literalLengthCode, END_OF_BLOCK + 1 + lengthCode );
+      writeBits( symbol.literalLength - LENGTH_BASE[ lengthCode ], LENGTH_EXTRA_BITS[ lengthCode ] );
+
+      int code = distanceCode( symbol.distance );
+      writeCode( distanceCodes, code );
+      writeBits( symbol.distance - DISTANCE_BASE[ code ], DISTANCE_EXTRA_BITS[ code ] );
+   }
+   writeCode( literalLengthCode, END_OF_BLOCK );
+
+   symbols.clear();
+}
+
+void DeflateStream::writeCodeLengths( const HuffmanCode& literalLengthCode, int literalLengthCount, const HuffmanCode& distanceCode,
+                                      int distanceCount )
+{
+   std::vector<uint8_t> lengths( literalLengthCode.lengths.begin(), literalLengthCode.lengths.begin() + literalLengthCount );
+   lengths.insert( lengths.end(), distanceCode.lengths.begin(), distanceCode.lengths.begin() + distanceCount );
+
+   // Run-length encoding of the lengths: 16 repeats the previous length 3-6 times, 17 and 18 repeat zero 3-10 and 11-138 times
+   struct RunSymbol
+   {
+      uint8_t symbol;
+      uint8_t extra;
+   };
+   std::vector<RunSymbol> runs;
+   for( size_t i = 0; i < lengths.size(); )
+   {
+      uint8_t length = lengths[ i ];
+      size_t run = 1;
+      while( i + run < lengths.size() && lengths[ i + run ] == length )
+         ++run;
+      i += run;
+
+      if( length == 0 )
+      {
+         for( ; run >= 11; run -= std::min<size_t>( run, 138 ) )
+            runs.push_back( { 18, static_cast<uint8_t>( std::min<size_t>( run, 138 ) - 11 ) } );
+         if( run >= 3 )
+         {
+            runs.push_back( { 17, static_cast<uint8_t>( run - 3 ) } );
+            run = 0;
+         }
+      }
+      else
+      {
+         runs.push_back( { length, 0 } );
+         for( --run; run >= 3; run -= std::min<size_t>( run, 6 ) )
+            runs.push_back( { 16, static_cast<uint8_t>( std::min<size_t>( run, 6 ) - 3 ) } );
+      }
+      for( ; run > 0; --run )
+         runs.push_back( { length, 0 } );
+   }
+
+   std::vector<uint32_t> frequencies( CODE_LENGTH_CODES, 0 );
+   for( const auto& run: runs )
+      ++frequencies[ run.symbol ];
+   ensureTwoSymbols( frequencies );
+   auto codeLengthCode = buildCode( frequencies, 7 );
+
+   int codeLengthCount = CODE_LENGTH_CODES;
+   while( codeLengthCount > 4 && codeLengthCode.lengths[ CODE_LENGTH_ORDER[ codeLengthCount - 1 ] ] == 0 )
+      --codeLengthCount;
+
+   writeBits( literalLengthCount - 257, 5 );
+   writeBits( distanceCount - 1, 5 );
+   writeBits( codeLengthCount - 4, 4 );
+   for( int i = 0; i < codeLengthCount; ++i )
+      writeBits( codeLengthCode.lengths[ CODE_LENGTH_ORDER[ i ] ], 3 );
+
+   for( const auto& run: runs )
+   {
+      writeCode( codeLengthCode, run.symbol );
+      if( run.symbol == 16 )
+         writeBits( run.extra, 2 );
+      else if( run.symbol == 17 )
+         writeBits( run.extra, 3 );
+      else if( run.symbol == 18 )
+         writeBits( run.extra, 7 );
+   }
+}
+
+void DeflateStream::writeBits( uint32_t value, int count )
+{
+   bitBuffer |= static_cast<uint64_t>( value ) << bitCount;
+   bitCount += count;
+   while( bitCount >= 8 )
+   {
+      output.push_back( static_cast<unsigned char>( bitBuffer ) );
+      bitBuffer >>= 8;
+      bitCount -= 8;
+   }
+}
+
+void DeflateStream::writeCode( const HuffmanCode& code, int symbol )
+{
+   writeBits( code.codes[ symbol ], code.lengths[ symbol ] );
+}
+
+void DeflateStream::flushBits()
+{
+   if( bitCount > 0 )
+      output.push_back( static_cast<unsigned char>( bitBuffer ) );
+   bitBuffer = 0;
+   bitCount = 0;
+}
+
+DeflateStream::HuffmanCode DeflateStream::buildCode( const std::vector<uint32_t>& frequencies, int maxLength )
+{
+   size_t symbolCount = frequencies.size();
+   HuffmanCode code{ std::vector<uint16_t>( symbolCount, 0 ), std::vector<uint8_t>( symbolCount, 0 ) };
+   std::vector<uint32_t> weights = frequencies;
+
+   while( true )
+   {
+      // Leaves are the used symbols, the inner nodes are added after them
+      std::vector<size_t> leafSymbols;
+      for( size_t i = 0; i < symbolCount; ++i )
+      {
+         if( weights[ i ] > 0 )
+            leafSymbols.push_back( i );
+      }
+      if( leafSymbols.empty() )
+         return code;
+      if( leafSymbols.size() == 1 )
+      {
+         code.lengths[ leafSymbols[ 0 ] ] = 1;
+         break;
+      }
+
+      std::vector<size_t> parents( 2 * leafSymbols.size() - 1, 0 );
+      using Node = std::pair<uint64_t, size_t>;
+      std::priority_queue<Node, std::vector<Node>, std::greater<>> queue;
+      for( size_t leaf = 0; leaf < leafSymbols.size(); ++leaf )
+         queue.emplace( weights[ leafSymbols[ leaf ] ], leaf );
+
+      size_t nextNode = leafSymbols.size();
+      while( queue.size() > 1 )
+      {
+         auto [ firstWeight, first ] = queue.top();
+         queue.pop();
+         auto [ secondWeight, second ] = queue.top();
+         queue.pop();
+         parents[ first ] = nextNode;
+         parents[ second ] = nextNode;
+         queue.emplace( firstWeight + secondWeight, nextNode++ );
+      }
+
+      // The parents always have higher indices, so the depths can be calculated from the root down
+      size_t root = nextNode - 1;
+      std::vector<int> depths( nextNode, 0 );
+      for( size_t node = root; node-- > 0; )
+         depths[ node ] = depths[ parents[ node ] ] + 1;
+
+      int longest = 0;
+      for( size_t leaf = 0; leaf < leafSymbols.size(); ++leaf )
+      {
+         code.lengths[ leafSymbols[ leaf ] ] = static_cast<uint8_t>( depths[ leaf ] );
+         longest = std::max( longest, depths[ leaf ] );
+      }
+      if( longest <= maxLength )
+         break;
+
+      // Too deep, flatten the weights and try again. Ends with equal weights at worst, which give a balanced tree
+      for( auto& weight: weights )
+      {
+         if( weight > 0 )
+            weight = ( weight + 1 ) / 2;
+      }
+   }
+
+   // Canonical codes, stored bit-reversed since deflate writes the Huffman codes starting with the most significant bit
+   std::vector<uint16_t> lengthCounts( maxLength + 1, 0 );
+   for( auto length: code.lengths )
+   {
+      if( length > 0 )
+         ++lengthCounts[ length ];
+   }
+   std::vector<uint16_t> nextCode( maxLength + 1, 0 );
+   for( int length = 1; length <= maxLength; ++length )
+      nextCode[ length ] = static_cast<uint16_t>( ( nextCode[ length - 1 ] + lengthCounts[ length - 1 ] ) << 1 );
+   for( size_t i = 0; i < symbolCount; ++i )
+   {
+      if( code.lengths[ i ] > 0 )
+         code.codes[ i ] = reverseBits( nextCode[ code.lengths[ i ] ]++, code.lengths[ i ] );
+   }
+   return code;
+}
+
+void DeflateStream::updateAdler( const unsigned char* data, size_t size )
+{
+   constexpr uint32_t modulo = 65521;
+   // The largest number of bytes which can be summed before the 32-bit sums can overflow
+   constexpr size_t maxBlock = 5552;
+
+   while( size > 0 )
+   {
+      size_t count = std::min( size, maxBlock );
+      for( size_t i = 0; i < count; ++i )
+      {
+         adlerA += data[ i ];
+         adlerB += adlerA;
+      }
+      adlerA %= modulo;
+      adlerB %= modulo;
+      data += count;
+      size -= count;
+   }
+}
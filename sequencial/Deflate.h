@@ -0,0 +1,177 @@
+//
+// Created by dominik on 18.10.26.
+//
+
+#ifndef SEQUENCIAL_DEFLATE_H
+#define SEQUENCIAL_DEFLATE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Trade-off between the compression speed and the size of the compressed data
+enum class CompressionLevel
+{
+   FAST,
+   BALANCED,
+   MAX
+};
+
+/**
+ * @brief Incremental zlib (RFC 1950) or raw deflate (RFC 1951) compressor
+ *
+ * Unlike lodepng, which compresses a whole buffer at once, the input is passed in pieces of any size and the compressed data can be taken out as it's produced,
+ * so the memory doesn't depend on the size of the input. Only the 32 KB deflate window and one block of symbols are kept.
+ *
+ * The matches are found with hash chains (LZ77), and every block is encoded with its own dynamic Huffman codes.
+ *
+ * A large input can be compressed in parallel by splitting it into chunks compressed by separate raw streams (the same way pigz does it):
+ * every chunk uses the end of the previous chunk as its dictionary and ends with flush, except for the last one, which ends with finish.
+ * The outputs are then concatenated after a zlib header and followed by the combined Adler-32 checksum (see combineAdler)
+ */
+class DeflateStream
+{
+   public:
+      enum class Format
+      {
+         // With the zlib header and the Adler-32 checksum
+         ZLIB,
+         // Only the deflate blocks
+         RAW
+      };
+
+      explicit DeflateStream( CompressionLevel level = CompressionLevel::BALANCED, Format format = Format::ZLIB );
+
+      /**
+       * @brief Sets the data preceding the stream. The written data can refer to its last 32 KB, but it isn't part of the output.
+       * Has to be called before writing any data
+       */
+      void setDictionary( const unsigned char* data, size_t size );
+
+      /**
+       * @brief Compresses the data. A part of it may be kept in the window until more data comes or finish is called
+       */
+      void write( const unsigned char* data, size_t size );
+
+      /**
+       * @brief Compresses all the written data and ends the current block with an empty stored block, so the output ends on a byte boundary.
+       * More data (or the output of another stream) can follow
+       */
+      void flush();
+
+      /**
+       * @brief Compresses the rest of the data and ends the stream. Nothing can be written afterward
+       */
+      void finish();
+
+      /**
+       * @return The compressed data produced so far and not yet cleared
+       */
+      [[nodiscard]] const std::vector<unsigned char>& getOutput() const;
+
+      void clearOutput();
+
+      /**
+       * @return Adler-32 checksum of all the written data (without the dictionary)
+       */
+      [[nodiscard]] uint32_t getAdler() const;
+
+      /**
+       * @return Adler-32 checksum of two concatenated pieces of data
+       * @param first Checksum of the first piece
+       * @param second Checksum of the second piece
+       * @param secondSize Size of the second piece in bytes
+       */
+      static uint32_t combineAdler( uint32_t first, uint32_t second, size_t secondSize );
+
+   private:
+      // Search limits of a compression level
+      struct Settings
+      {
+         // Number of previous positions with the same hash checked for a match
+         int maxChain;
+         // A match this long is good enough, the chain isn't searched further
+         size_t niceMatch;
+         // Shorter matches are only used if the next position doesn't start a longer match
+         size_t maxLazyMatch;
+      };
+
+      static const Settings LEVEL_SETTINGS[];
+
+      static constexpr size_t WINDOW_SIZE = 32768;
+      static constexpr size_t MIN_MATCH = 3;
+      static constexpr size_t MAX_MATCH = 258;
+      static constexpr int HASH_BITS = 15;
+      static constexpr size_t HASH_SIZE = 1 << HASH_BITS;
+      // Number of symbols (literals or matches) encoded in one block
+      static constexpr size_t BLOCK_SYMBOLS = 16384;
+      static constexpr int LITERAL_LENGTH_CODES = 286;
+      static constexpr int DISTANCE_CODES = 30;
+      static constexpr int CODE_LENGTH_CODES = 19;
+      static constexpr int END_OF_BLOCK = 256;
+
+      // A literal (distance 0) or a match
+      struct Symbol
+      {
+         uint16_t literalLength;
+         uint16_t distance;
+      };
+
+      struct HuffmanCode
+      {
+         std::vector<uint16_t> codes;
+         std::vector<uint8_t> lengths;
+      };
+
+      // Compresses the window until only the lookahead needed for the longest match is left, or everything when finishing
+      void compress( bool finishing );
+
+      // Moves the second half of the window to the first half
+      void slideWindow();
+
+      [[nodiscard]] uint32_t hashAt( size_t position ) const;
+
+      void insertHash( size_t position );
+
+      [[nodiscard]] size_t findMatch( size_t position, size_t maxLength, size_t& matchDistance ) const;
+
+      void writeBlock( bool last );
+
+      void writeCodeLengths( const HuffmanCode& literalLengthCode, int literalLengthCount, const HuffmanCode& distanceCode,
+                             int distanceCount );
+
+      void writeBits( uint32_t value, int count );
+
+      void writeCode( const HuffmanCode& code, int symbol );
+
+      void flushBits();
+
+      /**
+       * @brief Builds a canonical Huffman code with code lengths limited to maxLength
+       * @param frequencies Frequency of every symbol. Symbols with zero frequency get no code
+       */
+      static HuffmanCode buildCode( const std::vector<uint32_t>& frequencies, int maxLength );
+
+      void updateAdler( const unsigned char* data, size_t size );
+
+      Settings settings;
+      Format format;
+      // Twice the window size. The matches are searched in the first half and the new data is added to the second half
+      std::vector<unsigned char> window;
+      size_t windowEnd = 0;
+      size_t position = 0;
+      // Last position of every hash and the previous position with the same hash for every window position. -1 if none
+      std::vector<int32_t> head;
+      std::vector<int32_t> previous;
+
+      std::vector<Symbol> symbols;
+      std::vector<unsigned char> output;
+      uint64_t bitBuffer = 0;
+      int bitCount = 0;
+      uint32_t adlerA = 1;
+      uint32_t adlerB = 0;
+      bool started = false;
+      bool finished = false;
+};
+
+#endif //SEQUENCIAL_DEFLATE_H
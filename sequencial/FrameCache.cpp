@@ -0,0 +1,281 @@
+//
+// Created by dominik on 18.10.26.
+//
+
+#include "FrameCache.h"
+#include "ContentHash.h"
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <unistd.h>
+
+namespace
+{
+   void addVector( ContentHash& hash, const Vector3f& vector )
+   {
+      for( size_t i = 0; i < 3; ++i )
+         hash.addValue( vector[ i ] );
+   }
+
+   // Field by field, the alpha is followed by padding
+   void addColor( ContentHash& hash, const Color& color )
+   {
+      hash.addValue( color.R );
+      hash.addValue( color.G );
+      hash.addValue( color.B );
+      hash.addValue( color.alpha );
+   }
+
+   // Frames are the files named by a key, the temporary files of the frames being stored start with a dot
+   bool isFrameName( const std::string& name )
+   {
+      static constexpr size_t HASH_LENGTH = 32;
+      return name.size() > HASH_LENGTH + 1 && name[ HASH_LENGTH ] == '.' &&
+             std::all_of( name.begin(), name.begin() + HASH_LENGTH, []( unsigned char c ) { return std::isxdigit( c ); } );
+   }
+}
+
+/**
+ * @brief Hashes a scene. The meshes and prototypes are shared by pointer, their contents are hashed once and then referred to by index
+ */
+class SceneHasher
+{
+   public:
+      explicit SceneHasher( ContentHash& hash ) : hash( hash )
+      {
+      }
+
+      void addScene( const Scene& scene )
+      {
+         const auto& materials = scene.getMaterials();
+         hash.addValue( materials.size() );
+         for( const auto& material: materials )
+         {
+            // diffuseColor is derived from the others
+            addColor( hash, material.baseColor );
+            hash.addValue( material.specular );
+            hash.addValue( material.diffuse );
+            hash.addValue( material.shininess );
+            hash.addValue( material.reflectivity );
+            hash.addValue( material.transparency );
+            hash.addValue( material.refractiveIndex );
+         }
+
+         auto addArray = [ this ]( const auto& array ) { hash.addArray( array ); };
+         SphereArrays::forEachArray( scene.getSpheres(), addArray );
+         BlockArrays::forEachArray( scene.getBlocks(), addArray );
+         PlaneArrays::forEachArray( scene.getPlanes(), addArray );
+         hash.addValue( scene.getBoundedPlaneCount() );
+         hash.addValue( scene.getAccelerator() );
+
+         hash.addValue( scene.getMeshes().size() );
+         for( const auto& mesh: scene.getMeshes() )
+         {
+            if( addReference( meshes, mesh.geometry.get() ) )
+               addMesh( *mesh.geometry );
+            hash.addValue( mesh.materialIndex );
+         }
+
+         hash.addValue( scene.getInstances().size() );
+         for( const auto& instance: scene.getInstances() )
+         {
+            if( addReference( prototypes, instance.prototype.get() ) )
+               addScene( *instance.prototype );
+            // The images of the origin and the axes define the whole affine transform
+            addVector( hash, instance.transform.transformPoint( Vector3f( 0.f, 0.f, 0.f ) ) );
+            addVector( hash, instance.transform.transformVector( Vector3f( 1.f, 0.f, 0.f ) ) );
+            addVector( hash, instance.transform.transformVector( Vector3f( 0.f, 1.f, 0.f ) ) );
+            addVector( hash, instance.transform.transformVector( Vector3f( 0.f, 0.f, 1.f ) ) );
+         }
+      }
+
+   private:
+      /**
+       * @brief Adds the index of a shared object, the objects are numbered in the order they are first seen
+       * @return True if the object is seen the first time and its contents have to be added
+       */
+      template<typename T>
+      bool addReference( std::unordered_map<const T*, uint32_t>& indices, const T* object )
+      {
+         auto [ position, inserted ] = indices.try_emplace( object, static_cast<uint32_t>( indices.size() ) );
+         hash.addValue( position->second );
+         return inserted;
+      }
+
+      void addMesh( const TriangleMesh& mesh )
+      {
+         hash.addArray( mesh.vertices );
+         hash.addArray( mesh.indices );
+         hash.addArray( mesh.normals );
+         hash.addArray( mesh.normalIndices );
+      }
+
+      ContentHash& hash;
+      std::unordered_map<const TriangleMesh*, uint32_t> meshes;
+      std::unordered_map<const Scene*, uint32_t> prototypes;
+};
+
+FrameCache::FrameCache( std::filesystem::path directory, uint64_t maxSize ) : directory( std::move( directory ) ), maxSize( maxSize )
+{
+   std::filesystem::create_directories( this->directory );
+
+   std::vector<std::pair<std::filesystem::file_time_type, Frame>> found;
+   for( const auto& entry: std::filesystem::directory_iterator( this->directory ) )
+   {
+      std::string name = entry.path().filename().string();
+      if( entry.is_regular_file() && isFrameName( name ) )
+         found.push_back( { entry.last_write_time(), { name, entry.file_size() } } );
+   }
+
+   // The least recently used first, so the most recently used one ends up at the front
+   std::sort( found.begin(), found.end(), []( const auto& a, const auto& b ) { return a.first < b.first; } );
+   for( const auto& [ time, frame ]: found )
+      touch( frame.key, frame.size );
+   evict();
+}
+
+std::string FrameCache::sceneKey( const Scene& scene, const std::vector<Light>& lights )
+{
+   ContentHash hash;
+   SceneHasher( hash ).addScene( scene );
+
+   hash.addValue( lights.size() );
+   for( const auto& light: lights )
+   {
+      addVector( hash, light.centerPosition );
+      addColor( hash, light.lightColor );
+      hash.addValue( light.intensity );
+   }
+   return hash.toString();
+}
+
+std::string FrameCache::frameKey( const std::string& sceneKey, const TracerOptions& options, const std::string& outputPath,
+                                  CompressionLevel level )
+{
+   ContentHash hash;
+   hash.addValue( RENDERER_VERSION );
+   hash.addString( sceneKey );
+
+   hash.addValue( options.cameraDistance );
+   hash.addValue( options.fieldOfView );
+   hash.addValue( options.maxRecursionDepth );
+   hash.addValue( options.imageWidth );
+   hash.addValue( options.imageHeight );
+   addColor( hash, options.backgroundColor );
+   addColor( hash, options.ambientLightColor );
+   hash.addValue( options.exposure );
+   hash.addValue( options.gamma );
+   hash.addValue( options.packetTracing );
+
+   std::string extension = std::filesystem::path( outputPath ).extension().string();
+   std::transform( extension.begin(), extension.end(), extension.begin(), []( unsigned char c ) { return std::tolower( c ); } );
+   hash.addString( extension );
+   // The PNG files don't depend on the thread count, only on the compression level
+   if( extension == ".png" )
+      hash.addValue( level );
+
+   return hash.toString() + extension;
+}
+
+bool FrameCache::fetch( const std::string& key, const std::string& outputPath )
+{
+   std::lock_guard lock( mutex );
+   auto path = directory / key;
+   std::error_code error;
+   // The file is checked even for the indexed frames, another process sharing the directory could have evicted it
+   uint64_t size = std::filesystem::file_size( path, error );
+   if( !error )
+      std::filesystem::copy_file( path, outputPath, std::filesystem::copy_options::overwrite_existing, error );
+   if( error )
+   {
+      if( frames.contains( key ) && !std::filesystem::exists( path ) )
+         remove( key );
+      ++statistics.misses;
+      return false;
+   }
+
+   std::filesystem::last_write_time( path, std::filesystem::file_time_type::clock::now(), error );
+   touch( key, size );
+   ++statistics.hits;
+   // A frame stored by another process can go over the size limit
+   evict();
+   return true;
+}
+
+bool FrameCache::store( const std::string& key, const std::string& path )
+{
+   std::error_code error;
+   uint64_t size = std::filesystem::file_size( path, error );
+   if( error || size > maxSize )
+      return false;
+
+   std::lock_guard lock( mutex );
+   auto temporary = directory / ( ".partial-" + std::to_string( getpid() ) + "-" + std::to_string( nextTemporary++ ) );
+   std::filesystem::copy_file( path, temporary, std::filesystem::copy_options::overwrite_existing, error );
+   if( !error )
+      std::filesystem::rename( temporary, directory / key, error );
+   if( error )
+   {
+      std::filesystem::remove( temporary, error );
+      return false;
+   }
+
+   touch( key, size );
+   ++statistics.stores;
+   evict();
+   return true;
+}
+
+FrameCache::Statistics FrameCache::getStatistics() const
+{
+   std::lock_guard lock( mutex );
+   return statistics;
+}
+
+std::optional<uint64_t> FrameCache::parseMegabytes( const std::string& text )
+{
+   uint64_t megabytes = 0;
+   auto result = std::from_chars( text.data(), text.data() + text.size(), megabytes );
+   if( result.ec != std::errc() || result.ptr != text.data() + text.size() || megabytes > UINT64_MAX >> 20 )
+      return std::nullopt;
+   return megabytes << 20;
+}
+
+void FrameCache::touch( const std::string& key, uint64_t size )
+{
+   auto found = frames.find( key );
+   if( found != frames.end() )
+   {
+      statistics.size -= found->second->size;
+      found->second->size = size;
+      recentlyUsed.splice( recentlyUsed.begin(), recentlyUsed, found->second );
+   }
+   else
+   {
+      recentlyUsed.push_front( { key, size } );
+      frames[ key ] = recentlyUsed.begin();
+      ++statistics.frameCount;
+   }
+   statistics.size += size;
+}
+
+void FrameCache::remove( const std::string& key )
+{
+   auto found = frames.find( key );
+   statistics.size -= found->second->size;
+   --statistics.frameCount;
+   recentlyUsed.erase( found->second );
+   frames.erase( found );
+}
+
+void FrameCache::evict()
+{
+   while( statistics.size > maxSize && !recentlyUsed.empty() )
+   {
+      std::string key = recentlyUsed.back().key;
+      std::error_code error;
+      std::filesystem::remove( directory / key, error );
+      remove( key );
+      ++statistics.evictions;
+   }
+}
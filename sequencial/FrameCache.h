@@ -0,0 +1,121 @@
+//
+// Created by dominik on 18.10.26.
+//
+
+#ifndef SEQUENCIAL_FRAMECACHE_H
+#define SEQUENCIAL_FRAMECACHE_H
+
+#include "Deflate.h"
+#include "Scene.h"
+#include "TracerOptions.h"
+#include <cstdint>
+#include <filesystem>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Content-addressed cache of encoded frames in a directory, so a frame requested again is copied instead of rendered
+ *
+ * A frame is stored in a file named by its key: a hash of everything which affects the image (see sceneKey and frameKey) and the file extension.
+ * The frames are evicted in the least recently used order once their total size exceeds the size limit. A hit updates the modification time
+ * of the file, which keeps the order between runs, since the cache is indexed again from the directory on construction.
+ * Several processes can share a directory: the frames are stored under a temporary name and renamed, and a frame another process stored
+ * (or evicted) is found (or missed) on the disk. Every process keeps the size limit of its own index only.
+ *
+ * All methods can be called from multiple threads at once
+ */
+class FrameCache
+{
+   public:
+      struct Statistics
+      {
+         uint64_t hits = 0;
+         uint64_t misses = 0;
+         uint64_t stores = 0;
+         uint64_t evictions = 0;
+         // Frames in the index and their total size in bytes
+         uint64_t frameCount = 0;
+         uint64_t size = 0;
+      };
+
+      static constexpr uint64_t DEFAULT_MAX_SIZE = uint64_t( 1 ) << 30;
+      // Part of every key. Has to be increased by every change of the renderer which changes the images, so the old frames aren't used anymore
+      static constexpr uint32_t RENDERER_VERSION = 1;
+
+      /**
+       * @brief Opens the cache directory, creates it if it doesn't exist, and indexes the frames in it
+       * @param maxSize Maximum total size of the frames in bytes. The least recently used frames over the limit are evicted right away
+       * @throws std::filesystem::filesystem_error If the directory can't be created or read
+       */
+      explicit FrameCache( std::filesystem::path directory, uint64_t maxSize = DEFAULT_MAX_SIZE );
+
+      /**
+       * @brief Hashes the contents of a built scene together with its lights: the materials, the primitive arrays, the mesh geometries,
+       * the instances with their prototypes, and the accelerator
+       *
+       * The arrays are hashed in their BVH order, which only depends on the primitives, so the key is the same in every run,
+       * and a scene file gives the same key as the level it was converted from. The BVHs aren't hashed, they are derived from the primitives.
+       * The whole scene is read, so the key should be computed once for a scene rendered several times
+       */
+      [[nodiscard]] static std::string sceneKey( const Scene& scene, const std::vector<Light>& lights );
+
+      /**
+       * @brief Key of a frame of the scene. The options which don't change the image (threadCount and tileSize) aren't included
+       * @param outputPath The output file. Its extension (the format) is a part of the key
+       * @param level Compression level of PNG files. Ignored by the other formats
+       * @return The file name of the frame in the cache: 32 hexadecimal digits and the extension
+       */
+      [[nodiscard]] static std::string frameKey( const std::string& sceneKey, const TracerOptions& options, const std::string& outputPath,
+                                                 CompressionLevel level );
+
+      /**
+       * @brief Copies a cached frame to the output path
+       * @return False on a miss, the output file isn't touched then
+       */
+      bool fetch( const std::string& key, const std::string& outputPath );
+
+      /**
+       * @brief Copies a rendered frame into the cache and evicts the least recently used frames over the size limit
+       * @return False if the frame is bigger than the size limit or couldn't be copied (e.g. the disk is full), the cache stays as it was then
+       */
+      bool store( const std::string& key, const std::string& path );
+
+      [[nodiscard]] Statistics getStatistics() const;
+
+      /**
+       * @brief Parses a size limit given in MB, e.g. by a command line option
+       * @return The size in bytes. Empty if the text isn't a whole number, or the size in bytes doesn't fit in 64 bits
+       */
+      [[nodiscard]] static std::optional<uint64_t> parseMegabytes( const std::string& text );
+
+   private:
+      struct Frame
+      {
+         std::string key;
+         uint64_t size;
+      };
+
+      // Adds the frame to the front of the recently used list, or moves it there
+      void touch( const std::string& key, uint64_t size );
+
+      void remove( const std::string& key );
+
+      void evict();
+
+      std::filesystem::path directory;
+      uint64_t maxSize;
+
+      mutable std::mutex mutex;
+      // The most recently used frame first
+      std::list<Frame> recentlyUsed;
+      std::unordered_map<std::string, std::list<Frame>::iterator> frames;
+      Statistics statistics;
+      // Makes the temporary names of the frames being stored unique
+      uint64_t nextTemporary = 0;
+};
+
+#endif //SEQUENCIAL_FRAMECACHE_H
@@ -0,0 +1,266 @@
+//
+// Created by dominik on 18.10.26.
+//
+
+#include "ImageWriter.h"
+#include "PngWriter.h"
+#include <algorithm>
+#include <bit>
+#include <cctype>
+#include <stdexcept>
+
+namespace
+{
+   std::string lowercaseExtension( const std::string& path )
+   {
+      auto dot = path.find_last_of( '.' );
+      if( dot == std::string::npos || path.find_first_of( "/\\", dot ) != std::string::npos )
+         return "";
+
+      std::string extension = path.substr( dot + 1 );
+      std::transform( extension.begin(), extension.end(), extension.begin(), []( unsigned char c ) { return std::tolower( c ); } );
+      return extension;
+   }
+
+   void appendBigEndian( std::vector<unsigned char>& data, uint32_t value )
+   {
+      for( int shift = 24; shift >= 0; shift -= 8 )
+         data.push_back( static_cast<unsigned char>( value >> shift ) );
+   }
+
+   std::runtime_error unsupportedFormat( const std::string& path )
+   {
+      return std::runtime_error( "Unsupported image format of " + path + ". Supported extensions: .png, .ppm, .pfm, .qoi" );
+   }
+
+   // The writers of the formats other than PNG, which don't need any threads
+   std::unique_ptr<ImageWriter> createSingleThreaded( const std::string& path, unsigned int width, unsigned int height )
+   {
+      auto extension = lowercaseExtension( path );
+      if( extension == "ppm" )
+         return std::make_unique<PpmWriter>( path, width, height );
+      if( extension == "pfm" )
+         return std::make_unique<PfmWriter>( path, width, height );
+      if( extension == "qoi" )
+         return std::make_unique<QoiWriter>( path, width, height );
+
+      throw unsupportedFormat( path );
+   }
+}
+
+std::unique_ptr<ImageWriter> ImageWriter::create( const std::string& path, unsigned int width, unsigned int height,
+                                                  CompressionLevel level, unsigned int threadCount )
+{
+   if( lowercaseExtension( path ) == "png" )
+      return std::make_unique<PngWriter>( path, width, height, level, threadCount );
+   return createSingleThreaded( path, width, height );
+}
+
+std::unique_ptr<ImageWriter> ImageWriter::create( const std::string& path, unsigned int width, unsigned int height, CompressionLevel level,
+                                                  ThreadPool& pool )
+{
+   if( lowercaseExtension( path ) == "png" )
+      return std::make_unique<PngWriter>( path, width, height, level, pool );
+   return createSingleThreaded( path, width, height );
+}
+
+void ImageWriter::checkFormat( const std::string& path )
+{
+   auto extension = lowercaseExtension( path );
+   if( extension != "png" && extension != "ppm" && extension != "pfm" && extension != "qoi" )
+      throw unsupportedFormat( path );
+}
+
+ImageWriter::ImageWriter( const std::string& path, unsigned int width, unsigned int height )
+   : file( path, std::ios::binary ), width( width ), height( height )
+{
+   if( !file )
+      throw std::runtime_error( "Can't open " + path );
+}
+
+bool ImageWriter::isHdr() const
+{
+   return false;
+}
+
+void ImageWriter::writeRow( const unsigned char* )
+{
+   throw std::logic_error( "This image format stores the colors before tone mapping, use writeColorRow" );
+}
+
+void ImageWriter::writeColorRow( const Color* )
+{
+   throw std::logic_error( "This image format stores 8-bit pixels, use writeRow" );
+}
+
+void ImageWriter::nextRow()
+{
+   if( rowsWritten == height )
+      throw std::runtime_error( "All the rows of the image are already written" );
+   ++rowsWritten;
+}
+
+void ImageWriter::checkAllRowsWritten() const
+{
+   if( rowsWritten != height )
+      throw std::runtime_error( "Only " + std::to_string( rowsWritten ) + " of " + std::to_string( height ) + " rows were written" );
+}
+
+void ImageWriter::closeFile()
+{
+   file.close();
+   if( !file )
+      throw std::runtime_error( "Writing the image file failed" );
+}
+
+PpmWriter::PpmWriter( const std::string& path, unsigned int width, unsigned int height )
+   : ImageWriter( path, width, height ), row( static_cast<size_t>( width ) * 3 )
+{
+   file << "P6\n" << width << " " << height << "\n255\n";
+}
+
+void PpmWriter::writeRow( const unsigned char* pixels )
+{
+   nextRow();
+
+   for( size_t x = 0; x < width; ++x )
+   {
+      row[ x * 3 ] = pixels[ x * 4 ];
+      row[ x * 3 + 1 ] = pixels[ x * 4 + 1 ];
+      row[ x * 3 + 2 ] = pixels[ x * 4 + 2 ];
+   }
+   file.write( reinterpret_cast<const char*>( row.data() ), static_cast<std::streamsize>( row.size() ) );
+}
+
+void PpmWriter::finish()
+{
+   checkAllRowsWritten();
+   closeFile();
+}
+
+PfmWriter::PfmWriter( const std::string& path, unsigned int width, unsigned int height )
+   : ImageWriter( path, width, height ), row( static_cast<size_t>( width ) * 3 )
+{
+   // A negative scale means little-endian floats
+   file << "PF\n" << width << " " << height << "\n" << ( std::endian::native == std::endian::little ? "-1.0" : "1.0" ) << "\n";
+   dataStart = file.tellp();
+}
+
+bool PfmWriter::isHdr() const
+{
+   return true;
+}
+
+void PfmWriter::writeColorRow( const Color* pixels )
+{
+   nextRow();
+
+   for( size_t x = 0; x < width; ++x )
+   {
+      row[ x * 3 ] = pixels[ x ].R;
+      row[ x * 3 + 1 ] = pixels[ x ].G;
+      row[ x * 3 + 2 ] = pixels[ x ].B;
+   }
+
+   // The rows are stored from the bottom
+   auto rowBytes = static_cast<std::streamoff>( row.size() * sizeof( float ) );
+   file.seekp( dataStart + static_cast<std::streamoff>( height - rowsWritten ) * rowBytes );
+   file.write( reinterpret_cast<const char*>( row.data() ), rowBytes );
+}
+
+void PfmWriter::finish()
+{
+   checkAllRowsWritten();
+   closeFile();
+}
+
+QoiWriter::QoiWriter( const std::string& path, unsigned int width, unsigned int height ) : ImageWriter( path, width, height )
+{
+   encoded.reserve( static_cast<size_t>( width ) * 5 );
+
+   std::vector<unsigned char> header = { 'q', 'o', 'i', 'f' };
+   appendBigEndian( header, width );
+   appendBigEndian( header, height );
+   // RGBA, sRGB with linear alpha
+   header.insert( header.end(), { 4, 0 } );
+   file.write( reinterpret_cast<const char*>( header.data() ), static_cast<std::streamsize>( header.size() ) );
+}
+
+void QoiWriter::writeRow( const unsigned char* pixels )
+{
+   nextRow();
+
+   encoded.clear();
+   for( size_t x = 0; x < width; ++x )
+   {
+      Pixel pixel{ pixels[ x * 4 ], pixels[ x * 4 + 1 ], pixels[ x * 4 + 2 ], pixels[ x * 4 + 3 ] };
+
+      if( pixel == previous )
+      {
+         if( ++run == MAX_RUN )
+            writeRun();
+         continue;
+      }
+      writeRun();
+
+      auto hash = ( pixel.r * 3 + pixel.g * 5 + pixel.b * 7 + pixel.a * 11 ) % 64;
+      if( seenPixels[ hash ] == pixel )
+         // QOI_OP_INDEX
+         encoded.push_back( static_cast<unsigned char>( hash ) );
+      else
+      {
+         seenPixels[ hash ] = pixel;
+
+         if( pixel.a == previous.a )
+         {
+            // The differences wrap around, so they are computed in 8 bits
+            auto differenceR = static_cast<signed char>( pixel.r - previous.r );
+            auto differenceG = static_cast<signed char>( pixel.g - previous.g );
+            auto differenceB = static_cast<signed char>( pixel.b - previous.b );
+            int differenceRG = differenceR - differenceG;
+            int differenceBG = differenceB - differenceG;
+
+            if( differenceR >= -2 && differenceR <= 1 && differenceG >= -2 && differenceG <= 1 && differenceB >= -2 && differenceB <= 1 )
+               // QOI_OP_DIFF
+               encoded.push_back( static_cast<unsigned char>( 0x40 | ( differenceR + 2 ) << 4 | ( differenceG + 2 ) << 2 | ( differenceB + 2 ) ) );
+            else if( differenceRG >= -8 && differenceRG <= 7 && differenceG >= -32 && differenceG <= 31 && differenceBG >= -8 &&
+                     differenceBG <= 7 )
+            {
+               // QOI_OP_LUMA
+               encoded.push_back( static_cast<unsigned char>( 0x80 | ( differenceG + 32 ) ) );
+               encoded.push_back( static_cast<unsigned char>( ( differenceRG + 8 ) << 4 | ( differenceBG + 8 ) ) );
+            }
+            else
+               // QOI_OP_RGB
+               encoded.insert( encoded.end(), { 0xFE, pixel.r, pixel.g, pixel.b } );
+         }
+         else
+            // QOI_OP_RGBA
+            encoded.insert( encoded.end(), { 0xFF, pixel.r, pixel.g, pixel.b, pixel.a } );
+      }
+      previous = pixel;
+   }
+   file.write( reinterpret_cast<const char*>( encoded.data() ), static_cast<std::streamsize>( encoded.size() ) );
+}
+
+void QoiWriter::finish()
+{
+   checkAllRowsWritten();
+
+   encoded.clear();
+   writeRun();
+   // End marker
+   encoded.insert( encoded.end(), { 0, 0, 0, 0, 0, 0, 0, 1 } );
+   file.write( reinterpret_cast<const char*>( encoded.data() ), static_cast<std::streamsize>( encoded.size() ) );
+   closeFile();
+}
+
+void QoiWriter::writeRun()
+{
+   if( run == 0 )
+      return;
+
+   // QOI_OP_RUN, the run length is stored with a bias of -1
+   encoded.push_back( static_cast<unsigned char>( 0xC0 | ( run - 1 ) ) );
+   run = 0;
+}
@@ -0,0 +1,160 @@
+//
+// Created by dominik on 18.10.26.
+//
+
+#ifndef SEQUENCIAL_IMAGEWRITER_H
+#define SEQUENCIAL_IMAGEWRITER_H
+
+#include "Color.h"
+#include "Deflate.h"
+#include "ThreadPool.h"
+#include <array>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Writes an image file row by row, from the top
+ *
+ * The 8-bit formats take the tone-mapped RGBA rows of RayTracer::generateRawRows, the HDR formats take the colors of RayTracer::generateRows
+ */
+class ImageWriter
+{
+   public:
+      virtual ~ImageWriter() = default;
+
+      /**
+       * @brief Creates the writer of the format given by the file extension: .png, .ppm, .pfm, or .qoi
+       * @param path Path of the file
+       * @param width Width of the image in pixels
+       * @param height Height of the image in pixels
+       * @param level Compression level of PNG files
+       * @param threadCount Number of threads compressing PNG files. 0 means one thread per hardware thread
+       * @throws std::runtime_error If the extension isn't supported or the file can't be opened
+       */
+      static std::unique_ptr<ImageWriter> create( const std::string& path, unsigned int width, unsigned int height,
+                                                  CompressionLevel level = CompressionLevel::BALANCED, unsigned int threadCount = 0 );
+
+      /**
+       * @brief Creates the writer of the format given by the file extension. PNG files are compressed on the given pool, which has to outlive the writer
+       * @throws std::runtime_error If the extension isn't supported or the file can't be opened
+       */
+      static std::unique_ptr<ImageWriter> create( const std::string& path, unsigned int width, unsigned int height, CompressionLevel level,
+                                                  ThreadPool& pool );
+
+      /**
+       * @brief Checks the format given by the file extension without opening the file, so an unsupported path is rejected before rendering
+       * @throws std::runtime_error If the extension isn't supported
+       */
+      static void checkFormat( const std::string& path );
+
+      /**
+       * @return True if the format stores the colors before tone mapping (writeColorRow), false if it stores 8-bit pixels (writeRow)
+       */
+      [[nodiscard]] virtual bool isHdr() const;
+
+      /**
+       * @brief Adds the next row of 8-bit RGBA pixels. Only supported by the formats which aren't HDR
+       */
+      virtual void writeRow( const unsigned char* pixels );
+
+      /**
+       * @brief Adds the next row of colors. Only supported by the HDR formats
+       */
+      virtual void writeColorRow( const Color* pixels );
+
+      /**
+       * @brief Writes the rest of the file and closes it. Has to be called after all the rows are written
+       * @throws std::runtime_error If not all the rows were written or the file couldn't be written
+       */
+      virtual void finish() = 0;
+
+   protected:
+      ImageWriter( const std::string& path, unsigned int width, unsigned int height );
+
+      // Counts the written rows and checks that there aren't too many
+      void nextRow();
+
+      void checkAllRowsWritten() const;
+
+      // Closes the file and checks that everything was written
+      void closeFile();
+
+      std::ofstream file;
+      unsigned int width;
+      unsigned int height;
+      unsigned int rowsWritten = 0;
+};
+
+/**
+ * @brief Binary PPM (P6), 8-bit RGB without any compression. The alpha is dropped
+ */
+class PpmWriter : public ImageWriter
+{
+   public:
+      PpmWriter( const std::string& path, unsigned int width, unsigned int height );
+
+      void writeRow( const unsigned char* pixels ) override;
+
+      void finish() override;
+
+   private:
+      std::vector<unsigned char> row;
+};
+
+/**
+ * @brief PFM, 32-bit float RGB in the native byte order. Keeps the full range of the colors before tone mapping
+ *
+ * @note PFM stores the rows from the bottom, so every row is written to its place in the file
+ */
+class PfmWriter : public ImageWriter
+{
+   public:
+      PfmWriter( const std::string& path, unsigned int width, unsigned int height );
+
+      [[nodiscard]] bool isHdr() const override;
+
+      void writeColorRow( const Color* pixels ) override;
+
+      void finish() override;
+
+   private:
+      std::streamoff dataStart;
+      std::vector<float> row;
+};
+
+/**
+ * @brief QOI (https://qoiformat.org), fast lossless compression of 8-bit RGBA images
+ *
+ * Every pixel is encoded as a run of the previous pixel, an index into the recently seen pixels, a small difference to the previous pixel, or the full value
+ */
+class QoiWriter : public ImageWriter
+{
+   public:
+      QoiWriter( const std::string& path, unsigned int width, unsigned int height );
+
+      void writeRow( const unsigned char* pixels ) override;
+
+      void finish() override;
+
+   private:
+      struct Pixel
+      {
+         unsigned char r, g, b, a;
+
+         bool operator==( const Pixel& other ) const = default;
+      };
+
+      static constexpr int MAX_RUN = 62;
+
+      // Writes the pending run of the previous pixel
+      void writeRun();
+
+      std::array<Pixel, 64> seenPixels{};
+      Pixel previous{ 0, 0, 0, 255 };
+      int run = 0;
+      std::vector<unsigned char> encoded;
+};
+
+#endif //SEQUENCIAL_IMAGEWRITER_H
@@ -0,0 +1,50 @@
+//
+// Created by dominik on 18.10.26.
+//
+
+#include "Instance.h"
+#include <stdexcept>
+
+Instance::Instance( std::shared_ptr<const Scene> prototype, const Transform& transform )
+   : SceneObject( transform.transformBounds( prototype->getBounds() ).centroid(), Material() ), prototype( std::move( prototype ) ),
+     transform( transform )
+{
+   if( !this->prototype->getInstances().empty() )
+      throw std::runtime_error( "A prototype can't contain instances" );
+   if( !this->prototype->getBounds().isFinite() )
+      throw std::runtime_error( "A prototype can't contain infinite planes" );
+}
+
+bool Instance::intersects( const Ray& ray, RayHitResult& result ) const
+{
+   float distanceScale;
+   Ray objectRay = transform.toObjectSpace( ray, distanceScale );
+   const Material* hitMaterial;
+   if( !prototype->intersect( objectRay, result, hitMaterial ) )
+      return false;
+
+   transform.toWorldSpace( ray, result.distance / distanceScale, result );
+   return true;
+}
+
+bool Instance::occludes( const Ray& ray, float maxDistance ) const
+{
+   float distanceScale;
+   Ray objectRay = transform.toObjectSpace( ray, distanceScale );
+   return prototype->isOccluded( objectRay, maxDistance * distanceScale );
+}
+
+AABB Instance::getBounds() const
+{
+   return transform.transformBounds( prototype->getBounds() );
+}
+
+uint32_t Instance::addToScene( Scene& scene ) const
+{
+   return scene.addInstance( prototype, transform );
+}
+
+void Instance::updateInScene( Scene& scene, uint32_t index ) const
+{
+   scene.setInstanceTransform( index, transform );
+}
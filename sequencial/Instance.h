@@ -0,0 +1,41 @@
+//
+// Created by dominik on 18.10.26.
+//
+
+#ifndef SEQUENCIAL_INSTANCE_H
+#define SEQUENCIAL_INSTANCE_H
+
+#include "Objects.h"
+#include "Scene.h"
+#include "Transform.h"
+#include <memory>
+
+/**
+ * @brief Scene object placing a shared prototype scene by a transform. Copies of the object only copy the pointer and the transform.
+ * The primitives keep the materials of the prototype, the material of the object itself is unused
+ */
+class Instance : public SceneObject
+{
+   public:
+      Instance() = delete;
+
+      /**
+       * @throws std::runtime_error If the prototype contains instances or infinite planes
+       */
+      Instance( std::shared_ptr<const Scene> prototype, const Transform& transform );
+
+      bool intersects( const Ray& ray, RayHitResult& result ) const override;
+
+      [[nodiscard]] bool occludes( const Ray& ray, float maxDistance ) const override;
+
+      [[nodiscard]] AABB getBounds() const override;
+
+      uint32_t addToScene( Scene& scene ) const override;
+
+      void updateInScene( Scene& scene, uint32_t index ) const override;
+
+      std::shared_ptr<const Scene> prototype;
+      Transform transform;
+};
+
+#endif //SEQUENCIAL_INSTANCE_H
@@ -0,0 +1,208 @@
+//
+// Created by dominik on 17.10.26.
+//
+
+#ifndef SEQUENCIAL_INTERSECTIONS_H
+#define SEQUENCIAL_INTERSECTIONS_H
+
+#include "Objects.h"
+
+/**
+ * @brief Ray-primitive intersection math shared by the scene objects and the Scene arrays
+ *
+ * The distance functions only compute the distance to the closest intersection in front of the ray start.
+ * The hit point and normal are computed separately, so the ray tracer can compute them only for the closest hit
+ */
+namespace Intersection
+{
+   inline constexpr float EPSILON = SceneObject::EPSILON;
+
+   // Math behind ray-sphere intersection: https://www.scratchapixel.com/lessons/3d-basic-rendering/minimal-ray-tracer-rendering-simple-shapes/ray-sphere-intersection.html
+   inline bool sphereDistance( const Ray& ray, const Vector3f& center, float radius, float& distance )
+   {
+      auto offsetCenter = ray.startPoint - center;
+      // Optional check. However, branching costs something so we ignore it and only construct normalized rays in the Ray-Tracer class
+      /*
+      if( std::hypot( ray.direction.x, ray.direction.y, ray.direction.z ) != 1.f )
+         throw std::runtime_error( "Ray direction is not normalized" );
+      */
+
+      // We can ignore a since it is equal to Direction^2, which is a dot product of Direction vector.
+      // However, the direction vector is normalized, so the result is 1, and it won't play a part in the quadratic formula solutions
+      float b = VectorOps::dotProduct( ray.direction, offsetCenter );
+      float c = VectorOps::dotProduct( offsetCenter, offsetCenter ) - ( radius * radius );
+      float discriminant = ( b * b ) - c;
+
+      // No real solution
+      if( discriminant < std::numeric_limits<float>::epsilon() )
+         return false;
+
+      float discriminantSqrt = std::sqrt( discriminant );
+      float root = -b - discriminantSqrt;
+
+      if( root < EPSILON )
+      {
+         root = -b + discriminantSqrt;
+         if( root < EPSILON )
+            return false;
+      }
+
+      distance = root;
+      return true;
+   }
+
+   inline void sphereSurface( const Ray& ray, const Vector3f& center, float distance, RayHitResult& result )
+   {
+      result.distance = distance;
+      result.hitPoint = ray.startPoint + ( distance * ray.direction );
+      result.normal = result.hitPoint - center;
+      result.normal.normalize();
+   }
+
+   // Math behind plane intersection: https://www.scratchapixel.com/lessons/3d-basic-rendering/minimal-ray-tracer-rendering-simple-shapes/ray-plane-and-ray-disk-intersection.html
+   // The plane is a rectangle spanned by the tangent (width) and bitangent (depth) directions around the center
+   inline bool planeDistance( const Ray& ray, const Vector3f& center, const Vector3f& normal, const Vector3f& tangent,
+                              const Vector3f& bitangent, float halfWidth, float halfDepth, float& distance )
+   {
+      auto denominator = VectorOps::dotProduct( normal, ray.direction );
+
+      // Check if we don't divide by 0. If the denominator is 0 the plane and the ray are parallel and never intersect
+      if( std::abs( denominator ) < std::numeric_limits<float>::epsilon() )
+         return false;
+
+      distance = VectorOps::dotProduct( center - ray.startPoint, normal ) / denominator;
+      if( !( distance >= EPSILON ) )
+         return false;
+
+      // Reject hits outside the rectangle
+      Vector3f offset = ray.startPoint + ( distance * ray.direction ) - center;
+      return std::abs( VectorOps::dotProduct( offset, tangent ) ) <= halfWidth &&
+             std::abs( VectorOps::dotProduct( offset, bitangent ) ) <= halfDepth;
+   }
+
+   // Bounds of the plane rectangle. Padded, so the box of an axis-aligned plane isn't flat. Infinite for infinite planes
+   inline AABB planeBounds( const Vector3f& center, const Vector3f& tangent, const Vector3f& bitangent, float halfWidth,
+                            float halfDepth )
+   {
+      if( !std::isfinite( halfWidth ) || !std::isfinite( halfDepth ) )
+         return AABB::infinite();
+
+      Vector3f extents;
+      for( size_t i = 0; i < 3; ++i )
+         extents[ i ] = std::abs( tangent[ i ] ) * halfWidth + std::abs( bitangent[ i ] ) * halfDepth + EPSILON;
+
+      return { center - extents, center + extents };
+   }
+
+   inline void planeSurface( const Ray& ray, const Vector3f& normal, float distance, RayHitResult& result )
+   {
+      result.normal = normal;
+      result.distance = distance;
+      result.hitPoint = ray.startPoint + ( distance * ray.direction );
+   }
+
+   // Math for AABB intersection
+   // https://tavianator.com/2022/ray_box_boundary.html
+   // https://www.scratchapixel.com/lessons/3d-basic-rendering/minimal-ray-tracer-rendering-simple-shapes/ray-box-intersection.html
+   inline bool blockDistance( const Ray& ray, const Vector3f& minPoint, const Vector3f& maxPoint, float& distance )
+   {
+      Vector3f t1 = VectorOps::hadamardProduct( minPoint - ray.startPoint, ray.inverseDirection );
+      Vector3f t2 = VectorOps::hadamardProduct( maxPoint - ray.startPoint, ray.inverseDirection );
+
+      Vector3f tSmaller = VectorOps::min( t1, t2 );
+      Vector3f tBigger = VectorOps::max( t1, t2 );
+
+      float tMin = std::max( std::max( tSmaller.x(), tSmaller.y() ), tSmaller.z() );
+      float tMax = std::min( std::min( tBigger.x(), tBigger.y() ), tBigger.z() );
+
+      if( tMax < std::max( tMin, 0.f ) )
+         return false;
+
+      // If we are inside the block, the exit point is the intersection
+      distance = tMin < 0.f ? tMax : tMin;
+      return true;
+   }
+
+   inline void blockSurface( const Ray& ray, const Vector3f& minPoint, const Vector3f& maxPoint, float distance,
+                             RayHitResult& result )
+   {
+      Vector3f t1 = VectorOps::hadamardProduct( minPoint - ray.startPoint, ray.inverseDirection );
+      Vector3f t2 = VectorOps::hadamardProduct( maxPoint - ray.startPoint, ray.inverseDirection );
+      Vector3f tSmaller = VectorOps::min( t1, t2 );
+      Vector3f tBigger = VectorOps::max( t1, t2 );
+
+      float tMin = std::max( std::max( tSmaller.x(), tSmaller.y() ), tSmaller.z() );
+      bool isInside = tMin < 0.f;
+
+      result.distance = distance;
+      result.hitPoint = ray.startPoint + ( distance * ray.direction );
+
+      // The normal is on the axis where the ray entered the box last, or where it leaves the box first if it starts inside
+      int axis = 0;
+      if( isInside )
+      {
+         axis = ( tBigger.y() < tBigger.x() ) ? 1 : axis;
+         axis = ( tBigger.z() < tBigger[ axis ] ) ? 2 : axis;
+      }
+      else
+      {
+         axis = ( tSmaller.y() > tSmaller.x() ) ? 1 : axis;
+         axis = ( tSmaller.z() > tSmaller[ axis ] ) ? 2 : axis;
+      }
+
+      result.normal = Vector3f( 0.f, 0.f, 0.f );
+      result.normal[ axis ] = std::copysign( 1.0f, -ray.direction[ axis ] );
+
+      if( isInside )
+         result.normal = -result.normal;
+   }
+
+   // Möller-Trumbore ray-triangle intersection: https://www.scratchapixel.com/lessons/3d-basic-rendering/ray-tracing-rendering-a-triangle/moller-trumbore-ray-triangle-intersection.html
+   // u and v are the barycentric coordinates of the hit point, the weights of vertex1 and vertex2. Both sides of the triangle are hit
+   inline bool triangleDistance( const Ray& ray, const Vector3f& vertex0, const Vector3f& vertex1, const Vector3f& vertex2,
+                                 float& distance, float& u, float& v )
+   {
+      Vector3f edge1 = vertex1 - vertex0;
+      Vector3f edge2 = vertex2 - vertex0;
+      Vector3f p = VectorOps::crossProduct( ray.direction, edge2 );
+      float determinant = VectorOps::dotProduct( edge1, p );
+
+      // The ray is parallel to the triangle. Tiny triangles have tiny determinants too, so only exact 0 is rejected
+      if( determinant == 0.f )
+         return false;
+
+      float inverseDeterminant = 1.f / determinant;
+      Vector3f toStart = ray.startPoint - vertex0;
+      u = VectorOps::dotProduct( toStart, p ) * inverseDeterminant;
+      if( u < 0.f || u > 1.f )
+         return false;
+
+      Vector3f q = VectorOps::crossProduct( toStart, edge1 );
+      v = VectorOps::dotProduct( ray.direction, q ) * inverseDeterminant;
+      if( v < 0.f || u + v > 1.f )
+         return false;
+
+      distance = VectorOps::dotProduct( edge2, q ) * inverseDeterminant;
+      return distance >= EPSILON;
+   }
+
+   /**
+    * @brief Hit point and normal of a triangle. The normal is the geometric normal (counter-clockwise winding faces outward),
+    * or the vertex normals interpolated by the barycentric coordinates if they are given
+    */
+   inline void triangleSurface( const Ray& ray, const Vector3f& vertex0, const Vector3f& vertex1, const Vector3f& vertex2, float distance,
+                                RayHitResult& result, const Vector3f* vertexNormals = nullptr )
+   {
+      result.distance = distance;
+      result.hitPoint = ray.startPoint + ( distance * ray.direction );
+
+      float hitDistance, u, v;
+      if( vertexNormals && triangleDistance( ray, vertex0, vertex1, vertex2, hitDistance, u, v ) )
+         result.normal = vertexNormals[ 0 ] * ( 1.f - u - v ) + vertexNormals[ 1 ] * u + vertexNormals[ 2 ] * v;
+      else
+         result.normal = VectorOps::crossProduct( vertex1 - vertex0, vertex2 - vertex0 );
+      result.normal.normalize();
+   }
+}
+
+#endif //SEQUENCIAL_INTERSECTIONS_H
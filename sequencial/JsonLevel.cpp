@@ -0,0 +1,745 @@
+//
+// Created by dominik on 18.10.26.
+//
+
+#include "JsonLevel.h"
+#include "Instance.h"
+#include "ObjLoader.h"
+#include "ThreadPool.h"
+#include <charconv>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <stdexcept>
+
+namespace
+{
+   /**
+    * @brief Recursive descent parser of the scene JSON. The values are converted right away as the members are found
+    */
+   class SceneParser
+   {
+      public:
+         SceneParser( std::string_view text, const std::string& sourceName ) : text( text ), sourceName( sourceName )
+         {
+         }
+
+         void parse( TracerOptions& options, std::vector<std::shared_ptr<SceneObject>>& objects, std::vector<Light>& lights )
+         {
+            // A UTF-8 byte order mark is allowed
+            if( text.starts_with( "\xEF\xBB\xBF" ) )
+               position = 3;
+
+            bool hasOptions = false;
+            parseObject( [ & ]( std::string_view key, size_t keyOffset )
+            {
+               if( key == "options" )
+               {
+                  parseOptions( options );
+                  hasOptions = true;
+               }
+               else if( key == "materials" )
+                  parseMaterials();
+               else if( key == "prototypes" )
+                  parsePrototypes();
+               else if( key == "objects" )
+                  parseArray( [ & ]
+                  {
+                     objects.push_back( parseSceneObject() );
+                  } );
+               else if( key == "lights" )
+                  parseArray( [ & ]
+                  {
+                     lights.push_back( parseLight() );
+                  } );
+               else
+                  failAt( keyOffset, "Unknown member \"" + std::string( key ) + "\"" );
+            } );
+
+            skipWhitespace();
+            if( position != text.size() )
+               fail( "Unexpected data after the scene" );
+            if( !hasOptions )
+               failAt( 0, "Missing \"options\"" );
+         }
+
+      private:
+         [[noreturn]] void fail( const std::string& message ) const
+         {
+            failAt( position, message );
+         }
+
+         // The line and column are only counted when an error is reported, so they cost nothing while parsing
+         [[noreturn]] void failAt( size_t offset, const std::string& message ) const
+         {
+            offset = std::min( offset, text.size() );
+            size_t line = 1, lineStart = 0;
+            for( size_t i = 0; i < offset; ++i )
+            {
+               if( text[ i ] == '\n' )
+               {
+                  ++line;
+                  lineStart = i + 1;
+               }
+            }
+            throw std::runtime_error(
+               sourceName + ":" + std::to_string( line ) + ":" + std::to_string( offset - lineStart + 1 ) + ": " + message );
+         }
+
+         void skipWhitespace()
+         {
+            while( position < text.size() &&
+                   ( text[ position ] == ' ' || text[ position ] == '\n' || text[ position ] == '\t' || text[ position ] == '\r' ) )
+               ++position;
+         }
+
+         // Skips the whitespace and the character if it's next
+         bool consume( char character )
+         {
+            skipWhitespace();
+            if( position < text.size() && text[ position ] == character )
+            {
+               ++position;
+               return true;
+            }
+            return false;
+         }
+
+         void expect( char character )
+         {
+            if( !consume( character ) )
+               fail( position < text.size() ? std::string( "Expected '" ) + character + "'" : "Unexpected end of the file" );
+         }
+
+         [[nodiscard]] char peek()
+         {
+            skipWhitespace();
+            return position < text.size() ? text[ position ] : '\0';
+         }
+
+         /**
+          * @brief Parses "{ "key": value, ... }". Calls member( key, keyOffset ) for every key, it has to parse the value
+          */
+         template<typename MemberFunction>
+         void parseObject( MemberFunction&& member )
+         {
+            expect( '{' );
+            if( consume( '}' ) )
+               return;
+            do
+            {
+               skipWhitespace();
+               size_t keyOffset = position;
+               std::string_view key = parseString();
+               expect( ':' );
+               member( key, keyOffset );
+            } while( consume( ',' ) );
+            expect( '}' );
+         }
+
+         /**
+          * @brief Parses "[ value, ... ]". Calls element() for every value, it has to parse the value
+          */
+         template<typename ElementFunction>
+         void parseArray( ElementFunction&& element )
+         {
+            expect( '[' );
+            if( consume( ']' ) )
+               return;
+            do
+               element();
+            while( consume( ',' ) );
+            expect( ']' );
+         }
+
+         /**
+          * @return The string without the quotes. Points into the text unless the string contains escape sequences.
+          * Valid only until the next string is parsed
+          */
+         std::string_view parseString()
+         {
+            expect( '"' );
+            size_t start = position;
+            while( position < text.size() && text[ position ] != '"' && text[ position ] != '\\' )
+            {
+               if( static_cast<unsigned char>( text[ position ] ) < 0x20 )
+                  fail( "Control character in a string" );
+               ++position;
+            }
+            if( position == text.size() )
+               failAt( start - 1, "Unterminated string" );
+            if( text[ position ] == '"' )
+               return text.substr( start, position++ - start );
+
+            // Slow path, the string has to be unescaped
+            unescaped.assign( text.substr( start, position - start ) );
+            while( true )
+            {
+               if( position == text.size() )
+                  failAt( start - 1, "Unterminated string" );
+               char character = text[ position++ ];
+               if( character == '"' )
+                  return unescaped;
+               if( static_cast<unsigned char>( character ) < 0x20 )
+                  failAt( position - 1, "Control character in a string" );
+               if( character != '\\' )
+               {
+                  unescaped.push_back( character );
+                  continue;
+               }
+
+               if( position == text.size() )
+                  failAt( start - 1, "Unterminated string" );
+               switch( text[ position++ ] )
+               {
+                  case '"': unescaped.push_back( '"' ); break;
+                  case '\\': unescaped.push_back( '\\' ); break;
+                  case '/': unescaped.push_back( '/' ); break;
+                  case 'b': unescaped.push_back( '\b' ); break;
+                  case 'f': unescaped.push_back( '\f' ); break;
+                  case 'n': unescaped.push_back( '\n' ); break;
+                  case 'r': unescaped.push_back( '\r' ); break;
+                  case 't': unescaped.push_back( '\t' ); break;
+                  case 'u': appendUtf8( parseCodePoint() ); break;
+                  default: failAt( position - 2, "Invalid escape sequence" );
+               }
+            }
+         }
+
+         // Parses the hex digits of \uXXXX (joining surrogate pairs)
+         uint32_t parseCodePoint()
+         {
+            auto hex = [ & ]
+            {
+               uint32_t value = 0;
+               auto result = std::from_chars( text.data() + position, text.data() + std::min( position + 4, text.size() ), value, 16 );
+               if( result.ptr != text.data() + position + 4 )
+                  fail( "Expected 4 hex digits" );
+               position += 4;
+               return value;
+            };
+
+            uint32_t codePoint = hex();
+            if( codePoint >= 0xD800 && codePoint < 0xDC00 )
+            {
+               if( !text.substr( position ).starts_with( "\\u" ) )
+                  fail( "Unpaired surrogate" );
+               position += 2;
+               uint32_t low = hex();
+               if( low < 0xDC00 || low >= 0xE000 )
+                  fail( "Unpaired surrogate" );
+               codePoint = 0x10000 + ( ( codePoint - 0xD800 ) << 10 ) + ( low - 0xDC00 );
+            }
+            return codePoint;
+         }
+
+         void appendUtf8( uint32_t codePoint )
+         {
+            if( codePoint < 0x80 )
+               unescaped.push_back( static_cast<char>( codePoint ) );
+            else if( codePoint < 0x800 )
+            {
+               unescaped.push_back( static_cast<char>( 0xC0 | ( codePoint >> 6 ) ) );
+               unescaped.push_back( static_cast<char>( 0x80 | ( codePoint & 0x3F ) ) );
+            }
+            else if( codePoint < 0x10000 )
+            {
+               unescaped.push_back( static_cast<char>( 0xE0 | ( codePoint >> 12 ) ) );
+               unescaped.push_back( static_cast<char>( 0x80 | ( ( codePoint >> 6 ) & 0x3F ) ) );
+               unescaped.push_back( static_cast<char>( 0x80 | ( codePoint & 0x3F ) ) );
+            }
+            else
+            {
+               unescaped.push_back( static_cast<char>( 0xF0 | ( codePoint >> 18 ) ) );
+               unescaped.push_back( static_cast<char>( 0x80 | ( ( codePoint >> 12 ) & 0x3F ) ) );
+               unescaped.push_back( static_cast<char>( 0x80 | ( ( codePoint >> 6 ) & 0x3F ) ) );
+               unescaped.push_back( static_cast<char>( 0x80 | ( codePoint & 0x3F ) ) );
+            }
+         }
+
+         float parseFloat()
+         {
+            skipWhitespace();
+            // from_chars also accepts "inf" and "nan", which aren't JSON numbers
+            if( position == text.size() || ( text[ position ] != '-' && ( text[ position ] < '0' || text[ position ] > '9' ) ) )
+               fail( "Expected a number" );
+
+            float value;
+            auto result = std::from_chars( text.data() + position, text.data() + text.size(), value );
+            if( result.ec == std::errc::result_out_of_range )
+               fail( "Number out of range" );
+            if( result.ec != std::errc() )
+               fail( "Expected a number" );
+            position = result.ptr - text.data();
+            return value;
+         }
+
+         unsigned int parseUnsigned()
+         {
+            skipWhitespace();
+            unsigned int value = 0;
+            auto result = std::from_chars( text.data() + position, text.data() + text.size(), value );
+            if( result.ec == std::errc::result_out_of_range )
+               fail( "Number out of range" );
+            if( result.ec != std::errc() )
+               fail( "Expected a non-negative integer" );
+            position = result.ptr - text.data();
+            if( position < text.size() && ( text[ position ] == '.' || text[ position ] == 'e' || text[ position ] == 'E' ) )
+               fail( "Expected a non-negative integer" );
+            return value;
+         }
+
+         bool parseBool()
+         {
+            skipWhitespace();
+            std::string_view rest = text.substr( position );
+            if( rest.starts_with( "true" ) )
+            {
+               position += 4;
+               return true;
+            }
+            if( rest.starts_with( "false" ) )
+            {
+               position += 5;
+               return false;
+            }
+            fail( "Expected true or false" );
+         }
+
+         Vector3f parseVector()
+         {
+            float values[ 3 ];
+            parseTriple( values );
+            return { values[ 0 ], values[ 1 ], values[ 2 ] };
+         }
+
+         Color parseColor()
+         {
+            float values[ 3 ];
+            parseTriple( values );
+            return { values[ 0 ], values[ 1 ], values[ 2 ] };
+         }
+
+         void parseTriple( float( &values )[ 3 ] )
+         {
+            expect( '[' );
+            values[ 0 ] = parseFloat();
+            expect( ',' );
+            values[ 1 ] = parseFloat();
+            expect( ',' );
+            values[ 2 ] = parseFloat();
+            expect( ']' );
+         }
+
+         void parseOptions( TracerOptions& options )
+         {
+            size_t start = position;
+            enum Required
+            {
+               FIELD_OF_VIEW = 1, CAMERA_DISTANCE = 2, IMAGE_WIDTH = 4, IMAGE_HEIGHT = 8, ALL = 15
+            };
+            int found = 0;
+
+            parseObject( [ & ]( std::string_view key, size_t keyOffset )
+            {
+               if( key == "fieldOfView" )
+               {
+                  options.fieldOfView = parseFloat();
+                  found |= FIELD_OF_VIEW;
+               }
+               else if( key == "cameraDistance" )
+               {
+                  options.cameraDistance = parseFloat();
+                  found |= CAMERA_DISTANCE;
+               }
+               else if( key == "imageWidth" )
+               {
+                  options.imageWidth = parseUnsigned();
+                  found |= IMAGE_WIDTH;
+               }
+               else if( key == "imageHeight" )
+               {
+                  options.imageHeight = parseUnsigned();
+                  found |= IMAGE_HEIGHT;
+               }
+               else if( key == "maxRecursionDepth" )
+                  options.maxRecursionDepth = parseUnsigned();
+               else if( key == "backgroundColor" )
+                  options.backgroundColor = parseColor();
+               else if( key == "ambientLightColor" )
+                  options.ambientLightColor = parseColor();
+               else if( key == "exposure" )
+               {
+                  options.exposure = parseFloat();
+                  if( !( options.exposure > 0.f ) )
+                     failAt( keyOffset, "The exposure has to be positive" );
+               }
+               else if( key == "gamma" )
+               {
+                  options.gamma = parseFloat();
+                  if( !( options.gamma > 0.f ) )
+                     failAt( keyOffset, "The gamma has to be positive" );
+               }
+               else if( key == "threadCount" )
+               {
+                  options.threadCount = parseUnsigned();
+                  if( options.threadCount > ThreadPool::MAX_THREAD_COUNT )
+                     failAt( keyOffset, "The thread count can't be over " + std::to_string( ThreadPool::MAX_THREAD_COUNT ) );
+               }
+               else if( key == "tileSize" )
+                  options.tileSize = parseUnsigned();
+               else if( key == "packetTracing" )
+                  options.packetTracing = parseBool();
+               else
+                  failAt( keyOffset, "Unknown option \"" + std::string( key ) + "\"" );
+            } );
+
+            if( found != ALL )
+               failAt( start, "The options need fieldOfView, cameraDistance, imageWidth and imageHeight" );
+            if( options.imageWidth == 0 || options.imageHeight == 0 )
+               failAt( start, "The image size can't be 0" );
+         }
+
+         void parseMaterials()
+         {
+            parseObject( [ & ]( std::string_view key, size_t keyOffset )
+            {
+               std::string name( key );
+               Material material = parseMaterial();
+               if( !materials.emplace( std::move( name ), material ).second )
+                  failAt( keyOffset, "Material \"" + std::string( key ) + "\" is already defined" );
+            } );
+         }
+
+         // Every prototype is a list of objects built into its own scene, shared by all its instances
+         void parsePrototypes()
+         {
+            parseObject( [ & ]( std::string_view key, size_t keyOffset )
+            {
+               std::string name( key );
+               std::vector<std::shared_ptr<SceneObject>> objects;
+               parseArray( [ & ]
+               {
+                  objects.push_back( parseSceneObject() );
+               } );
+               if( !prototypes.emplace( std::move( name ), std::make_shared<const Scene>( objects ) ).second )
+                  failAt( keyOffset, "Prototype \"" + std::string( key ) + "\" is already defined" );
+            } );
+         }
+
+         Material parseMaterial()
+         {
+            size_t start = position;
+            Color color;
+            float specular = 0.f, diffuse = 0.f, shininess = 0.f, reflectivity = 0.f, transparency = 0.f, refractiveIndex = 1.f;
+            bool hasColor = false, hasSpecular = false, hasDiffuse = false, hasShininess = false;
+
+            parseObject( [ & ]( std::string_view key, size_t keyOffset )
+            {
+               if( key == "color" )
+               {
+                  color = parseColor();
+                  hasColor = true;
+               }
+               else if( key == "specular" )
+               {
+                  specular = parseFloat();
+                  hasSpecular = true;
+               }
+               else if( key == "diffuse" )
+               {
+                  diffuse = parseFloat();
+                  hasDiffuse = true;
+               }
+               else if( key == "shininess" )
+               {
+                  shininess = parseFloat();
+                  hasShininess = true;
+               }
+               else if( key == "reflectivity" )
+                  reflectivity = parseFloat();
+               else if( key == "transparency" )
+                  transparency = parseFloat();
+               else if( key == "refractiveIndex" )
+                  refractiveIndex = parseFloat();
+               else
+                  failAt( keyOffset, "Unknown material property \"" + std::string( key ) + "\"" );
+            } );
+
+            if( !hasColor || !hasSpecular || !hasDiffuse || !hasShininess )
+               failAt( start, "A material needs color, specular, diffuse and shininess" );
+            return { color, specular, diffuse, shininess, reflectivity, transparency, refractiveIndex };
+         }
+
+         // A material name or an inline material
+         Material parseMaterialReference()
+         {
+            if( peek() == '{' )
+               return parseMaterial();
+
+            size_t start = position;
+            std::string_view name = parseString();
+            auto material = materials.find( name );
+            if( material == materials.end() )
+               failAt( start, "Unknown material \"" + std::string( name ) + "\"" );
+            return material->second;
+         }
+
+         std::shared_ptr<SceneObject> parseSceneObject()
+         {
+            skipWhitespace();
+            size_t start = position;
+
+            enum Type
+            {
+               UNKNOWN, SPHERE, PLANE, BLOCK, MESH, INSTANCE
+            };
+            enum Property
+            {
+               CENTER = 1, RADIUS = 2, NORMAL = 4, HALF_WIDTH = 8, HALF_DEPTH = 16, EXTENTS = 32, MATERIAL = 64, FILE = 128,
+               PROTOTYPE = 256, TRANSLATION = 512, ROTATION = 1024, SCALE = 2048
+            };
+            Type type = UNKNOWN;
+            int found = 0;
+            Vector3f center, normal, extents;
+            float radius = 0.f, halfWidth = Plane::UNBOUNDED, halfDepth = Plane::UNBOUNDED;
+            Material material;
+            std::shared_ptr<const TriangleMesh> mesh;
+            std::shared_ptr<const Scene> prototype;
+            Vector3f translation, rotation, scale( 1.f, 1.f, 1.f );
+
+            parseObject( [ & ]( std::string_view key, size_t keyOffset )
+            {
+               if( key == "type" )
+               {
+                  skipWhitespace();
+                  size_t valueOffset = position;
+                  std::string_view name = parseString();
+                  if( name == "sphere" )
+                     type = SPHERE;
+                  else if( name == "plane" )
+                     type = PLANE;
+                  else if( name == "block" )
+                     type = BLOCK;
+                  else if( name == "mesh" )
+                     type = MESH;
+                  else if( name == "instance" )
+                     type = INSTANCE;
+                  else
+                     failAt( valueOffset, "Unknown object type \"" + std::string( name ) + "\"" );
+               }
+               else if( key == "center" )
+               {
+                  center = parseVector();
+                  found |= CENTER;
+               }
+               else if( key == "radius" )
+               {
+                  radius = parseFloat();
+                  if( !( radius > 0.f ) )
+                     failAt( keyOffset, "The radius has to be positive" );
+                  found |= RADIUS;
+               }
+               else if( key == "normal" )
+               {
+                  normal = parseVector();
+                  // The plane normalizes it, and a vector this short is normalized to 0
+                  if( std::sqrt( VectorOps::dotProduct( normal, normal ) ) <= std::numeric_limits<float>::epsilon() )
+                     failAt( keyOffset, "The normal can't be 0" );
+                  found |= NORMAL;
+               }
+               else if( key == "halfWidth" )
+               {
+                  halfWidth = parseFloat();
+                  found |= HALF_WIDTH;
+               }
+               else if( key == "halfDepth" )
+               {
+                  halfDepth = parseFloat();
+                  found |= HALF_DEPTH;
+               }
+               else if( key == "extents" )
+               {
+                  extents = parseVector();
+                  found |= EXTENTS;
+               }
+               else if( key == "material" )
+               {
+                  material = parseMaterialReference();
+                  found |= MATERIAL;
+               }
+               else if( key == "file" )
+               {
+                  mesh = parseMeshFile();
+                  found |= FILE;
+               }
+               else if( key == "prototype" )
+               {
+                  skipWhitespace();
+                  size_t valueOffset = position;
+                  std::string_view name = parseString();
+                  auto entry = prototypes.find( name );
+                  if( entry == prototypes.end() )
+                     failAt( valueOffset, "Unknown prototype \"" + std::string( name ) + "\"" );
+                  prototype = entry->second;
+                  found |= PROTOTYPE;
+               }
+               else if( key == "translation" )
+               {
+                  translation = parseVector();
+                  found |= TRANSLATION;
+               }
+               else if( key == "rotation" )
+               {
+                  rotation = parseVector();
+                  found |= ROTATION;
+               }
+               else if( key == "scale" )
+               {
+                  // A uniform scale or a factor per axis
+                  if( peek() == '[' )
+                     scale = parseVector();
+                  else
+                  {
+                     float factor = parseFloat();
+                     scale = Vector3f( factor, factor, factor );
+                  }
+                  found |= SCALE;
+               }
+               else
+                  failAt( keyOffset, "Unknown object property \"" + std::string( key ) + "\"" );
+            } );
+
+            // Checks that the object has all the required properties and nothing else
+            auto check = [ & ]( const char* typeName, int required, int optional )
+            {
+               if( ( found & required ) != required )
+                  failAt( start, std::string( "Missing a required property of the " ) + typeName );
+               if( found & ~( required | optional ) )
+                  failAt( start, std::string( "Property not allowed for the " ) + typeName );
+            };
+
+            switch( type )
+            {
+               case SPHERE:
+                  check( "sphere", CENTER | RADIUS | MATERIAL, 0 );
+                  return std::make_shared<Sphere>( center, material, radius );
+               case PLANE:
+                  check( "plane", CENTER | NORMAL | MATERIAL, HALF_WIDTH | HALF_DEPTH );
+                  return std::make_shared<Plane>( center, material, normal, halfWidth, halfDepth );
+               case BLOCK:
+                  check( "block", CENTER | EXTENTS | MATERIAL, 0 );
+                  return std::make_shared<Block>( center, material, extents );
+               case MESH:
+                  check( "mesh", FILE | MATERIAL, 0 );
+                  return std::make_shared<Mesh>( mesh, material );
+               case INSTANCE:
+                  check( "instance", PROTOTYPE, TRANSLATION | ROTATION | SCALE );
+                  try
+                  {
+                     Transform transform = Transform::translation( translation ) * Transform::rotation( rotation ) * Transform::scale( scale );
+                     return std::make_shared<Instance>( prototype, transform );
+                  }
+                  catch( const std::runtime_error& error )
+                  {
+                     failAt( start, error.what() );
+                  }
+               default:
+                  failAt( start, "Missing the object type" );
+            }
+         }
+
+         // OBJ file path relative to the scene file. Every file is loaded once, the objects using it share the geometry
+         std::shared_ptr<const TriangleMesh> parseMeshFile()
+         {
+            skipWhitespace();
+            size_t start = position;
+            std::string path = ( std::filesystem::path( sourceName ).parent_path() / parseString() ).lexically_normal().string();
+
+            auto cached = meshes.find( path );
+            if( cached != meshes.end() )
+               return cached->second;
+
+            try
+            {
+               return meshes.emplace( path, ObjLoader::load( path ) ).first->second;
+            }
+            catch( const std::runtime_error& error )
+            {
+               failAt( start, error.what() );
+            }
+         }
+
+         Light parseLight()
+         {
+            skipWhitespace();
+            size_t start = position;
+            Vector3f lightPosition;
+            Color color;
+            float intensity = 0.f;
+            int found = 0;
+
+            parseObject( [ & ]( std::string_view key, size_t keyOffset )
+            {
+               if( key == "position" )
+               {
+                  lightPosition = parseVector();
+                  found |= 1;
+               }
+               else if( key == "color" )
+               {
+                  color = parseColor();
+                  found |= 2;
+               }
+               else if( key == "intensity" )
+               {
+                  intensity = parseFloat();
+                  found |= 4;
+               }
+               else
+                  failAt( keyOffset, "Unknown light property \"" + std::string( key ) + "\"" );
+            } );
+
+            if( found != 7 )
+               failAt( start, "A light needs position, color and intensity" );
+            return { lightPosition, color, intensity };
+         }
+
+         std::string_view text;
+         const std::string& sourceName;
+         size_t position = 0;
+         // Buffer of the last string with escape sequences
+         std::string unescaped;
+         // std::less<> allows finding a name by a string_view without a copy
+         std::map<std::string, Material, std::less<>> materials;
+         std::map<std::string, std::shared_ptr<const TriangleMesh>> meshes;
+         std::map<std::string, std::shared_ptr<const Scene>, std::less<>> prototypes;
+   };
+}
+
+JsonLevel::JsonLevel( std::string path ) : path( std::move( path ) )
+{
+}
+
+void JsonLevel::loadLevel( TracerOptions& options, std::vector<std::shared_ptr<SceneObject>>& objects, std::vector<Light>& lights )
+{
+   std::ifstream file( path, std::ios::binary | std::ios::ate );
+   if( !file )
+      throw std::runtime_error( "Couldn't open " + path );
+
+   // The whole file is read at once, the strings and numbers are parsed right from this buffer
+   std::string text( static_cast<size_t>( file.tellg() ), '\0' );
+   file.seekg( 0 );
+   if( !file.read( text.data(), static_cast<std::streamsize>( text.size() ) ) )
+      throw std::runtime_error( "Couldn't read " + path );
+
+   parse( text, path, options, objects, lights );
+}
+
+void JsonLevel::parse( std::string_view text, const std::string& sourceName, TracerOptions& options,
+                       std::vector<std::shared_ptr<SceneObject>>& objects, std::vector<Light>& lights )
+{
+   SceneParser( text, sourceName ).parse( options, objects, lights );
+}
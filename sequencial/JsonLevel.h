@@ -0,0 +1,66 @@
+//
+// Created by dominik on 18.10.26.
+//
+
+#ifndef SEQUENCIAL_JSONLEVEL_H
+#define SEQUENCIAL_JSONLEVEL_H
+
+#include "Levels.h"
+#include <string>
+#include <string_view>
+
+/**
+ * @brief Level loaded from a JSON file, so a new scene doesn't need a rebuild
+ *
+ * The file is one object with these members (the order of the members doesn't matter, except that materials and prototypes referenced by name
+ * have to be defined before the objects using them):
+ * @code
+ * {
+ *    "options": { "fieldOfView": 90, "cameraDistance": 50, "imageWidth": 1280, "imageHeight": 720,
+ *                 "backgroundColor": [ 0.01, 0.01, 0.01 ], "ambientLightColor": [ 0.1, 0.1, 0.1 ] },
+ *    "materials": { "floor": { "color": [ 0.95, 0.05, 0.05 ], "specular": 0.1, "diffuse": 0.9, "shininess": 16 } },
+ *    "prototypes": { "pillar": [ { "type": "block", "center": [ 0, 0, 0 ], "extents": [ 2, 20, 2 ], "material": "floor" } ] },
+ *    "objects": [
+ *       { "type": "sphere", "center": [ -10, -10, 100 ], "radius": 22, "material": "floor" },
+ *       { "type": "block", "center": [ 50, -30, 110 ], "extents": [ 12, 10, 15 ], "material": "floor" },
+ *       { "type": "plane", "center": [ 0, -50, 100 ], "normal": [ 0, 1, 0 ], "material": "floor" },
+ *       { "type": "mesh", "file": "models/bunny.obj", "material": "floor" },
+ *       { "type": "instance", "prototype": "pillar", "translation": [ 30, -30, 120 ], "rotation": [ 0, 45, 0 ], "scale": 1.5 }
+ *    ],
+ *    "lights": [ { "position": [ 30, 20, 10 ], "color": [ 0.98, 0.95, 0.9 ], "intensity": 4 } ]
+ * }
+ * @endcode
+ * - options: fieldOfView, cameraDistance, imageWidth and imageHeight are required, any other TracerOptions member can be set too
+ * - materials: reflectivity, transparency (0 by default) and refractiveIndex (1 by default) are optional
+ * - objects: the material is either a name or an inline material object. The halfWidth and halfDepth of a plane are optional,
+ *   the plane is unbounded in the missing direction. A mesh is a Wavefront OBJ file (see ObjLoader) with a path relative to the JSON file,
+ *   the objects using the same file share one copy of the geometry
+ * - prototypes: named lists of objects, each built once into its own scene. An instance object places a prototype scaled, rotated
+ *   (in degrees around the x, y, then z-axis), and translated, in this order. Prototypes can't contain instances or infinite planes
+ *
+ * The text is parsed in a single pass straight into the objects, there is no document tree in between.
+ * Only the strings with escape sequences and the material names are copied
+ */
+class JsonLevel : public Level
+{
+   public:
+      explicit JsonLevel( std::string path );
+
+      /**
+       * @throws std::runtime_error If the file can't be read or isn't a valid scene. The message contains the line and column of the error
+       */
+      void loadLevel( TracerOptions& options, std::vector<std::shared_ptr<SceneObject>>& objects, std::vector<Light>& lights ) override;
+
+      /**
+       * @brief Parses a scene from JSON text
+       * @param sourceName Name of the source (e.g. the file path) used in the error messages
+       * @throws std::runtime_error "sourceName:line:column: message" if the text isn't a valid scene
+       */
+      static void parse( std::string_view text, const std::string& sourceName, TracerOptions& options,
+                         std::vector<std::shared_ptr<SceneObject>>& objects, std::vector<Light>& lights );
+
+   private:
+      std::string path;
+};
+
+#endif //SEQUENCIAL_JSONLEVEL_H
@@ -0,0 +1,327 @@
+//
+// Created by dominik on 17.10.26.
+//
+
+#include "Levels.h"
+#include "ProceduralLevel.h"
+#include "RayTracer.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <sys/resource.h>
+
+/**
+ * @brief End-to-end benchmark of the built-in levels, or of the levels given by --level (e.g. procedural levels of increasing size)
+ *
+ * Every level is loaded and built once, then rendered warmUp times without measuring and then iterations times measured, the same way as main renders it.
+ * The report contains the scene build time, the number of primitives, the median and 95th percentile frame time,
+ * the primary and shadow rays per second (at the median frame time), and the peak RSS while benchmarking the level.
+ *
+ * --accelerator compares the acceleration structures: every level is benchmarked with each of the given ones (bvh, wide, grid, hashed, or all).
+ * The accelerator build time is measured separately from the level loading, by building the BVHs again, or by building the wide BVHs or the grids.
+ *
+ * Usage: levelbench [--level L]... [--accelerator bvh|wide|grid|hashed|all]... [--warmup N] [--iterations M] [--threads T] [--output report.json|report.csv]
+ */
+namespace
+{
+   struct Settings
+   {
+      unsigned int warmUp = 1;
+      unsigned int iterations = 5;
+      unsigned int threadCount = 0;
+      std::string outputPath = "levelbench.json";
+      // Arguments accepted by createLevel. All built-in levels if empty
+      std::vector<std::string> levels;
+      // BVH only if empty
+      std::vector<Scene::Accelerator> accelerators;
+   };
+
+   struct LevelReport
+   {
+      std::string level;
+      std::string name;
+      std::string accelerator;
+      unsigned int width;
+      unsigned int height;
+      size_t primitives;
+      double buildMs;
+      double acceleratorBuildMs;
+      double medianMs;
+      double p95Ms;
+      RenderStats stats;
+      double primaryRaysPerSecond;
+      double shadowRaysPerSecond;
+      long peakRssKb;
+   };
+
+   const char* acceleratorName( Scene::Accelerator accelerator )
+   {
+      switch( accelerator )
+      {
+         case Scene::Accelerator::WIDE_BVH:
+            return "wide";
+         case Scene::Accelerator::GRID:
+            return "grid";
+         case Scene::Accelerator::HASHED_GRID:
+            return "hashed";
+         default:
+            return "bvh";
+      }
+   }
+
+   void parseAccelerator( const std::string& value, std::vector<Scene::Accelerator>& accelerators )
+   {
+      bool matched = false;
+      for( auto accelerator: { Scene::Accelerator::BVH, Scene::Accelerator::WIDE_BVH, Scene::Accelerator::GRID, Scene::Accelerator::HASHED_GRID } )
+      {
+         if( value == acceleratorName( accelerator ) || value == "all" )
+         {
+            accelerators.push_back( accelerator );
+            matched = true;
+         }
+      }
+      if( !matched )
+         throw std::runtime_error( "Unknown accelerator " + value + ", use bvh, wide, grid, hashed, or all" );
+   }
+
+   unsigned int parseCount( const std::string& argument, const std::string& value )
+   {
+      try
+      {
+         size_t end = 0;
+         unsigned long count = std::stoul( value, &end );
+         if( end == value.size() && value[ 0 ] != '-' && count <= UINT32_MAX )
+            return static_cast<unsigned int>( count );
+      }
+      catch( const std::logic_error& )
+      {
+      }
+      throw std::runtime_error( argument + " needs a number, got " + value );
+   }
+
+   Settings parseSettings( int argc, char** argv )
+   {
+      Settings settings;
+      for( int i = 1; i < argc; ++i )
+      {
+         std::string argument = argv[ i ];
+         if( i + 1 >= argc )
+            throw std::runtime_error( "Missing value of " + argument );
+
+         std::string value = argv[ ++i ];
+         if( argument == "--warmup" )
+            settings.warmUp = parseCount( argument, value );
+         else if( argument == "--iterations" )
+            settings.iterations = std::max( 1u, parseCount( argument, value ) );
+         else if( argument == "--threads" )
+            settings.threadCount = parseCount( argument, value );
+         else if( argument == "--output" )
+            settings.outputPath = value;
+         else if( argument == "--level" )
+            settings.levels.push_back( value );
+         else if( argument == "--accelerator" )
+            parseAccelerator( value, settings.accelerators );
+         else
+            throw std::runtime_error( "Unknown argument " + argument );
+      }
+      return settings;
+   }
+
+   // Nearest-rank percentile of sorted values
+   double percentile( const std::vector<double>& sortedValues, double fraction )
+   {
+      auto rank = static_cast<size_t>( std::ceil( fraction * static_cast<double>( sortedValues.size() ) ) );
+      return sortedValues[ std::clamp<size_t>( rank, 1, sortedValues.size() ) - 1 ];
+   }
+
+   constexpr const char* USAGE = "[--level L]... [--accelerator bvh|wide|grid|hashed|all]... [--warmup N] [--iterations M] [--threads T] "
+                                 "[--output report.json|report.csv]";
+
+   // Resets the peak RSS of the process to the current RSS, so every level reports its own peak. Linux only, a no-op elsewhere
+   void resetPeakRss()
+   {
+      std::ofstream( "/proc/self/clear_refs" ) << "5";
+   }
+
+   // Peak RSS since the last resetPeakRss. Falls back to the peak of the whole process without /proc
+   long peakRssKb()
+   {
+      std::ifstream status( "/proc/self/status" );
+      std::string line;
+      while( std::getline( status, line ) )
+      {
+         if( line.starts_with( "VmHWM:" ) )
+            return std::stol( line.substr( 6 ) );
+      }
+
+      rusage usage{};
+      getrusage( RUSAGE_SELF, &usage );
+      // Kilobytes on Linux
+      return usage.ru_maxrss;
+   }
+
+   LevelReport benchmarkLevel( const std::string& level, Scene::Accelerator accelerator, const Settings& settings )
+   {
+      resetPeakRss();
+      TracerOptions options;
+      std::vector<Light> lights;
+      auto buildStart = std::chrono::steady_clock::now();
+      Scene scene = createLevel( level )->loadScene( options, lights );
+      auto buildEnd = std::chrono::steady_clock::now();
+      options.threadCount = settings.threadCount;
+
+      // The BVHs were already built by the level, building them again measures them alone
+      auto acceleratorStart = std::chrono::steady_clock::now();
+      if( accelerator == Scene::Accelerator::BVH )
+         scene.build();
+      else
+         scene.setAccelerator( accelerator );
+      auto acceleratorEnd = std::chrono::steady_clock::now();
+
+      for( unsigned int i = 0; i < settings.warmUp; ++i )
+         RayTracer::generateRawImage( options, scene, lights );
+
+      std::vector<double> frameTimes;
+      RenderStats stats;
+      for( unsigned int i = 0; i < settings.iterations; ++i )
+      {
+         // The rendering is deterministic, so every frame traces the same rays
+         stats = {};
+         auto start = std::chrono::steady_clock::now();
+         RayTracer::generateRawImage( options, scene, lights, &stats );
+         auto end = std::chrono::steady_clock::now();
+         frameTimes.push_back( std::chrono::duration<double, std::milli>( end - start ).count() );
+      }
+      std::sort( frameTimes.begin(), frameTimes.end() );
+
+      double medianMs = percentile( frameTimes, 0.5 );
+      double medianSeconds = medianMs / 1000.0;
+      auto levelID = parseLevelID( level );
+      std::string name = levelID ? getLevelName( *levelID ) :
+                         ProceduralLevel::isSpecification( level ) ? "ProceduralLevel" : "JsonLevel";
+      return {
+         level,
+         name,
+         acceleratorName( accelerator ),
+         options.imageWidth,
+         options.imageHeight,
+         scene.getPrimitiveCount(),
+         std::chrono::duration<double, std::milli>( buildEnd - buildStart ).count(),
+         std::chrono::duration<double, std::milli>( acceleratorEnd - acceleratorStart ).count(),
+         medianMs,
+         percentile( frameTimes, 0.95 ),
+         stats,
+         static_cast<double>( stats.primary ) / medianSeconds,
+         static_cast<double>( stats.shadow ) / medianSeconds,
+         peakRssKb()
+      };
+   }
+
+   void writeCsv( const std::string& path, const std::vector<LevelReport>& reports )
+   {
+      std::ofstream file( path );
+      if( !file )
+         throw std::runtime_error( "Can't open " + path );
+
+      file << "level,name,accelerator,width,height,primitives,build_ms,accelerator_build_ms,median_ms,p95_ms,primary_rays,secondary_rays,shadow_rays,primary_rays_per_second,"
+            "shadow_rays_per_second,peak_rss_kb\n";
+      for( const auto& report: reports )
+      {
+         file << report.level << "," << report.name << "," << report.accelerator << "," << report.width << "," << report.height << "," <<
+               report.primitives << "," << report.buildMs << "," << report.acceleratorBuildMs << "," << report.medianMs << "," <<
+               report.p95Ms << "," << report.stats.primary << "," << report.stats.secondary << "," << report.stats.shadow << "," <<
+               report.primaryRaysPerSecond << "," << report.shadowRaysPerSecond << "," << report.peakRssKb << "\n";
+      }
+   }
+
+   void writeJson( const std::string& path, const std::vector<LevelReport>& reports, const Settings& settings )
+   {
+      std::ofstream file( path );
+      if( !file )
+         throw std::runtime_error( "Can't open " + path );
+
+      file << "{\n  \"warmup\": " << settings.warmUp << ",\n  \"iterations\": " << settings.iterations << ",\n  \"threads\": " <<
+            settings.threadCount << ",\n  \"levels\": [\n";
+      for( size_t i = 0; i < reports.size(); ++i )
+      {
+         const auto& report = reports[ i ];
+         file << "    {\"level\": \"" << report.level << "\", \"name\": \"" << report.name << "\", \"accelerator\": \"" <<
+               report.accelerator << "\", \"width\": " << report.width << ", \"height\": " << report.height << ", \"primitives\": " <<
+               report.primitives << ", \"build_ms\": " << report.buildMs << ", \"accelerator_build_ms\": " << report.acceleratorBuildMs <<
+               ", \"median_ms\": " << report.medianMs << ", \"p95_ms\": " << report.p95Ms <<
+               ", \"primary_rays\": " << report.stats.primary << ", \"secondary_rays\": " << report.stats.secondary <<
+               ", \"shadow_rays\": " << report.stats.shadow << ", \"primary_rays_per_second\": " << report.primaryRaysPerSecond <<
+               ", \"shadow_rays_per_second\": " << report.shadowRaysPerSecond << ", \"peak_rss_kb\": " << report.peakRssKb << "}" <<
+               ( i + 1 < reports.size() ? "," : "" ) << "\n";
+      }
+      file << "  ]\n}\n";
+   }
+}
+
+int main( int argc, char** argv )
+{
+   Settings settings;
+   try
+   {
+      settings = parseSettings( argc, argv );
+   }
+   catch( const std::exception& error )
+   {
+      std::cerr << error.what() << std::endl;
+      std::cout << "Usage: " << argv[ 0 ] << " " << USAGE << std::endl;
+      return -1;
+   }
+
+   if( settings.levels.empty() )
+   {
+      for( int levelID = 1; levelID <= LEVEL_COUNT; ++levelID )
+         settings.levels.push_back( std::to_string( levelID ) );
+   }
+
+   if( settings.accelerators.empty() )
+      settings.accelerators.push_back( Scene::Accelerator::BVH );
+
+   std::vector<LevelReport> reports;
+   for( const auto& level: settings.levels )
+   {
+      for( auto accelerator: settings.accelerators )
+      {
+         try
+         {
+            reports.push_back( benchmarkLevel( level, accelerator, settings ) );
+         }
+         catch( const std::exception& error )
+         {
+            // An invalid level, e.g. a built-in level ID out of range
+            std::cerr << "Level " << level << ": " << error.what() << std::endl;
+            std::cout << "Usage: " << argv[ 0 ] << " " << USAGE << std::endl;
+            return -1;
+         }
+         const auto& report = reports.back();
+         std::cout << report.level << " " << report.name << " (" << report.accelerator << "): " << report.primitives << " primitives built in " <<
+               report.buildMs << " ms, accelerator " << report.acceleratorBuildMs << " ms, median " << report.medianMs << " ms, p95 " <<
+               report.p95Ms << " ms, " << report.primaryRaysPerSecond / 1e6 << " M primary rays/s, " << report.shadowRaysPerSecond / 1e6 <<
+               " M shadow rays/s, peak RSS " << report.peakRssKb / 1024 << " MB" << std::endl;
+      }
+   }
+
+   const auto& path = settings.outputPath;
+   try
+   {
+      if( path.size() >= 4 && path.compare( path.size() - 4, 4, ".csv" ) == 0 )
+         writeCsv( path, reports );
+      else
+         writeJson( path, reports, settings );
+   }
+   catch( const std::runtime_error& error )
+   {
+      std::cerr << error.what() << std::endl;
+      return -1;
+   }
+   std::cout << "Report written to " << path << std::endl;
+}
@@ -3,6 +3,73 @@
 //
 
 #include "Levels.h"
+#include "JsonLevel.h"
+#include "ProceduralLevel.h"
+#include <algorithm>
+#include <charconv>
+#include <stdexcept>
+
+std::unique_ptr<Level> createLevel( int levelID )
+{
+   switch( levelID )
+   {
+      case 1:
+         return std::make_unique<BasicLevel>();
+      case 2:
+         return std::make_unique<LightColors>();
+      case 3:
+         return std::make_unique<HighResLights>();
+      case 4:
+         return std::make_unique<LightCombination>();
+      case 5:
+         return std::make_unique<Space>();
+      case 6:
+         return std::make_unique<Reflections>();
+      default:
+         throw std::runtime_error( "Invalid level ID" );
+   }
+}
+
+std::optional<int> parseLevelID( const std::string& level )
+{
+   if( level.empty() || !std::all_of( level.begin(), level.end(), []( char character ) { return character >= '0' && character <= '9'; } ) )
+      return std::nullopt;
+
+   int levelID = 0;
+   auto result = std::from_chars( level.data(), level.data() + level.size(), levelID );
+   if( result.ec != std::errc() )
+      throw std::runtime_error( "Invalid level ID" );
+   return levelID;
+}
+
+std::unique_ptr<Level> createLevel( const std::string& level )
+{
+   if( auto levelID = parseLevelID( level ) )
+      return createLevel( *levelID );
+   if( level.ends_with( ".json" ) )
+      return std::make_unique<JsonLevel>( level );
+   if( ProceduralLevel::isSpecification( level ) )
+      return std::make_unique<ProceduralLevel>( ProceduralLevel::parseSettings( level ) );
+   throw std::runtime_error( "Unknown level " + level );
+}
+
+Scene Level::loadScene( TracerOptions& options, std::vector<Light>& lights )
+{
+   std::vector<std::shared_ptr<SceneObject>> objects;
+   loadLevel( options, objects, lights );
+   return Scene( objects );
+}
+
+const char* getLevelName( int levelID )
+{
+   static constexpr const char* names[ LEVEL_COUNT ] = {
+      "BasicLevel", "LightColors", "HighResLights", "LightCombination", "Space", "Reflections"
+   };
+
+   if( levelID < 1 || levelID > LEVEL_COUNT )
+      throw std::runtime_error( "Invalid level ID" );
+   return names[ levelID - 1 ];
+}
 
 void BasicLevel::loadLevel( TracerOptions& options, std::vector<std::shared_ptr<SceneObject>>&objects, std::vector<Light>& lights )
 {
@@ -21,10 +88,10 @@ void BasicLevel::loadLevel( TracerOptions& options, std::vector<std::shared_ptr<
       std::make_shared<Block>( Vector3f( 50.f, -30.f, 110.f ), greenMaterial, Vector3f( 12.f, 10.f, 15.f ) ) );
 
    objects.emplace_back(
-      std::make_shared<Plane>( Vector3f( 0.f, -50.f, 100.f ), floor, Vector3f( 0.f, 1.f, 0.f ), 100.f, 100.f ) );
+      std::make_shared<Plane>( Vector3f( 0.f, -50.f, 100.f ), floor, Vector3f( 0.f, 1.f, 0.f ), Plane::UNBOUNDED, Plane::UNBOUNDED ) );
 
    objects.emplace_back(
-      std::make_shared<Plane>( Vector3f( -120.f, 10.f, 100.f ), floor, Vector3f( 1.f, 0.f, 0.f ), 100.f, 100.f ) );
+      std::make_shared<Plane>( Vector3f( -120.f, 10.f, 100.f ), floor, Vector3f( 1.f, 0.f, 0.f ), Plane::UNBOUNDED, Plane::UNBOUNDED ) );
 
    lights.emplace_back( Vector3f( 30.f, 20.f, 10.f ), Color( 0.98f, 0.95f, 0.90f ), 4.f );
 }
@@ -43,14 +110,14 @@ void LightColors::loadLevel( TracerOptions& options, std::vector<std::shared_ptr
    Material object( Color( 0.75f, 0.75f, 0.75f ), 0.5f, 0.25f, 64.f );
 
    objects.emplace_back(
-      std::make_shared<Plane>( Vector3f( 0.f, -70.f, 110.f ), floor, Vector3f( 0.f, 1.f, 0.f ), 100.f, 100.f ) );
+      std::make_shared<Plane>( Vector3f( 0.f, -70.f, 110.f ), floor, Vector3f( 0.f, 1.f, 0.f ), Plane::UNBOUNDED, Plane::UNBOUNDED ) );
 
    objects.emplace_back(
-      std::make_shared<Plane>( Vector3f( -200.f, 10.f, 100.f ), walls, Vector3f( 1.f, 0.f, 0.f ), 100.f, 100.f ) );
+      std::make_shared<Plane>( Vector3f( -200.f, 10.f, 100.f ), walls, Vector3f( 1.f, 0.f, 0.f ), Plane::UNBOUNDED, Plane::UNBOUNDED ) );
    objects.emplace_back(
-      std::make_shared<Plane>( Vector3f( 200.f, 10.f, 100.f ), walls, Vector3f( -1.f, 0.f, 0.f ), 100.f, 100.f ) );
+      std::make_shared<Plane>( Vector3f( 200.f, 10.f, 100.f ), walls, Vector3f( -1.f, 0.f, 0.f ), Plane::UNBOUNDED, Plane::UNBOUNDED ) );
    objects.emplace_back(
-      std::make_shared<Plane>( Vector3f( 0.f, 10.f, 200.f ), walls, Vector3f( 0.f, 0.f, -1.f ), 100.f, 100.f ) );
+      std::make_shared<Plane>( Vector3f( 0.f, 10.f, 200.f ), walls, Vector3f( 0.f, 0.f, -1.f ), Plane::UNBOUNDED, Plane::UNBOUNDED ) );
 
    objects.emplace_back(
       std::make_shared<Block>( Vector3f( -80.f, -30.f, 110.f ), object, Vector3f( 15.f, 10.f, 15.f ) ) );
@@ -83,9 +150,9 @@ void HighResLights::loadLevel( TracerOptions& options, std::vector<std::shared_p
       std::make_shared<Sphere>( Vector3f( 80.f, 15.f, 110.f ), white, 22.f ) );
 
    objects.emplace_back(
-      std::make_shared<Plane>( Vector3f( 0.f, -60.f, 0.f ), walls, Vector3f( 0.f, 1.f, 0.f ), 100.f, 100.f ) );
+      std::make_shared<Plane>( Vector3f( 0.f, -60.f, 0.f ), walls, Vector3f( 0.f, 1.f, 0.f ), Plane::UNBOUNDED, Plane::UNBOUNDED ) );
    objects.emplace_back(
-      std::make_shared<Plane>( Vector3f( 0.f, 10.f, 400.f ), walls, Vector3f( 0.f, 0.f, -1.f ), 100.f, 100.f ) );
+      std::make_shared<Plane>( Vector3f( 0.f, 10.f, 400.f ), walls, Vector3f( 0.f, 0.f, -1.f ), Plane::UNBOUNDED, Plane::UNBOUNDED ) );
 }
 
 void LightCombination::loadLevel( TracerOptions& options, std::vector<std::shared_ptr<SceneObject>>&objects, std::vector<Light>& lights )
@@ -110,9 +177,9 @@ void LightCombination::loadLevel( TracerOptions& options, std::vector<std::share
       std::make_shared<Sphere>( Vector3f( 50.f, 10.f, 130.f ), white, 20.f ) );
 
    objects.emplace_back(
-      std::make_shared<Plane>( Vector3f( 0.f, -60.f, 0.f ), walls, Vector3f( 0.f, 1.f, 0.f ), 100.f, 100.f ) );
+      std::make_shared<Plane>( Vector3f( 0.f, -60.f, 0.f ), walls, Vector3f( 0.f, 1.f, 0.f ), Plane::UNBOUNDED, Plane::UNBOUNDED ) );
    objects.emplace_back(
-      std::make_shared<Plane>( Vector3f( 0.f, 10.f, 400.f ), walls, Vector3f( 0.f, 0.f, -1.f ), 100.f, 100.f ) );
+      std::make_shared<Plane>( Vector3f( 0.f, 10.f, 400.f ), walls, Vector3f( 0.f, 0.f, -1.f ), Plane::UNBOUNDED, Plane::UNBOUNDED ) );
 }
 
 void Space::loadLevel( TracerOptions& options, std::vector<std::shared_ptr<SceneObject>>& objects, std::vector<Light>& lights )
@@ -135,3 +202,38 @@ void Space::loadLevel( TracerOptions& options, std::vector<std::shared_ptr<Scene
    objects.emplace_back( std::make_shared<Sphere>( Vector3f( -120.f, 0.f, 85.f ), orange, 24.f ) );
    objects.emplace_back( std::make_shared<Sphere>( Vector3f( 0.f, 20.f, 124.f ), orange, 2.f ) );
 }
+
+void Reflections::loadLevel( TracerOptions& options, std::vector<std::shared_ptr<SceneObject>>& objects, std::vector<Light>& lights )
+{
+   options.fieldOfView = 90;
+   options.cameraDistance = 50;
+   options.maxRecursionDepth = 6;
+   options.imageWidth = 1920;
+   options.imageHeight = 1080;
+   options.backgroundColor = Color( 0.01f, 0.01f, 0.01f );
+   options.ambientLightColor = Color( 0.1f, 0.1f, 0.1f );
+
+   Material floor( Color( 0.8f, 0.8f, 0.8f ), 0.2f, 0.7f, 32.f, 0.25f, 0.f );
+   Material walls( Color( 0.2f, 0.3f, 0.75f ), 0.1f, 0.8f, 16.f );
+   Material mirror( Color( 0.9f, 0.9f, 0.9f ), 0.8f, 0.1f, 256.f, 0.9f, 0.f );
+   Material glass( Color( 0.9f, 0.95f, 1.f ), 0.9f, 0.05f, 256.f, 0.1f, 0.85f, 1.5f );
+   Material red( Color( 0.85f, 0.05f, 0.15f ), 0.4f, 0.5f, 32.f );
+   Material orange( Color( 1.f, 0.5f, 0.05f ), 0.45f, 0.3f, 64.f, 0.3f, 0.f );
+
+   objects.emplace_back( std::make_shared<Sphere>( Vector3f( -45.f, -20.f, 140.f ), mirror, 30.f ) );
+   objects.emplace_back( std::make_shared<Sphere>( Vector3f( 15.f, -32.f, 95.f ), glass, 18.f ) );
+   objects.emplace_back( std::make_shared<Sphere>( Vector3f( 60.f, -25.f, 150.f ), orange, 25.f ) );
+   objects.emplace_back( std::make_shared<Block>( Vector3f( 10.f, -35.f, 190.f ), red, Vector3f( 15.f, 15.f, 15.f ) ) );
+
+   objects.emplace_back(
+      std::make_shared<Plane>( Vector3f( 0.f, -50.f, 100.f ), floor, Vector3f( 0.f, 1.f, 0.f ), Plane::UNBOUNDED, Plane::UNBOUNDED ) );
+   objects.emplace_back(
+      std::make_shared<Plane>( Vector3f( 0.f, 10.f, 260.f ), walls, Vector3f( 0.f, 0.f, -1.f ), Plane::UNBOUNDED, Plane::UNBOUNDED ) );
+
+   // A finite mirror panel standing on the floor
+   Vector3f panelNormal( -0.6f, 0.f, -0.8f );
+   objects.emplace_back( std::make_shared<Plane>( Vector3f( 110.f, -10.f, 210.f ), mirror, panelNormal, 35.f, 40.f ) );
+
+   lights.emplace_back( Vector3f( 40.f, 60.f, 40.f ), Color( 0.98f, 0.95f, 0.90f ), 5.f );
+   lights.emplace_back( Vector3f( -80.f, 40.f, 120.f ), Color( 0.6f, 0.7f, 1.f ), 3.f );
+}
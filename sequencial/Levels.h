@@ -6,17 +6,25 @@
 #define GPURAYTRACER_LEVELS_H
 
 #include "Objects.h"
+#include "Scene.h"
 #include "TracerOptions.h"
 #include <memory>
+#include <optional>
+#include <string>
 #include <vector>
 
-// TODO add level loading from a JSON
+// Scenes can also be loaded from a JSON file without a rebuild, see JsonLevel
 class Level
 {
    public:
       virtual ~Level() = default;
 
       virtual void loadLevel( TracerOptions& options, std::vector<std::shared_ptr<SceneObject>>& objects, std::vector<Light>& lights ) = 0;
+
+      /**
+       * @brief Loads the level into a built scene. By default the scene is built from the objects of loadLevel
+       */
+      virtual Scene loadScene( TracerOptions& options, std::vector<Light>& lights );
 };
 
 class BasicLevel : public Level
@@ -49,4 +57,40 @@ class Space : public Level
       void loadLevel( TracerOptions& options, std::vector<std::shared_ptr<SceneObject>>& objects, std::vector<Light>& lights ) override;
 };
 
+class Reflections : public Level
+{
+   public:
+      void loadLevel( TracerOptions& options, std::vector<std::shared_ptr<SceneObject>>& objects, std::vector<Light>& lights ) override;
+};
+
+// The built-in levels have IDs from 1 to LEVEL_COUNT
+inline constexpr int LEVEL_COUNT = 6;
+
+/**
+ * @brief Creates a built-in level
+ * @param levelID ID of the level from 1 to LEVEL_COUNT
+ * @throws std::runtime_error If the level ID is invalid
+ */
+std::unique_ptr<Level> createLevel( int levelID );
+
+/**
+ * @brief Parses the ID of a built-in level from a command line argument
+ * @return The ID, or nothing if the argument isn't a number (e.g. a JSON scene). The ID isn't checked against LEVEL_COUNT
+ * @throws std::runtime_error If the argument is a number too large for an ID
+ */
+std::optional<int> parseLevelID( const std::string& level );
+
+/**
+ * @brief Creates a level selected by a command line argument
+ * @param level A built-in level ID, a path to a JSON scene (see JsonLevel), or a procedural level specification (see ProceduralLevel)
+ * @throws std::runtime_error If the level is invalid
+ */
+std::unique_ptr<Level> createLevel( const std::string& level );
+
+/**
+ * @return Name of a built-in level (the class name), e.g. "BasicLevel"
+ * @throws std::runtime_error If the level ID is invalid
+ */
+const char* getLevelName( int levelID );
+
 #endif //GPURAYTRACER_LEVELS_H
@@ -0,0 +1,150 @@
+//
+// Created by dominik on 18.10.26.
+//
+
+#ifndef SEQUENCIAL_MAPPEDARRAY_H
+#define SEQUENCIAL_MAPPEDARRAY_H
+
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+/**
+ * @brief Contiguous array which either owns its elements or views memory owned by someone else (e.g. a memory-mapped scene file)
+ *
+ * The element access is the same in both cases, a pointer and a size, so the hot loops don't branch on the ownership.
+ * A view is never reallocated. Growing a view (push_back, reserve) first copies its elements into owned storage.
+ * Copying a view copies only the pointer, the viewed memory has to outlive all the copies
+ */
+template<typename T>
+class MappedArray
+{
+      static_assert( std::is_trivially_copyable_v<T>, "The elements are stored as raw bytes in the scene files" );
+
+   public:
+      using value_type = T;
+
+      MappedArray() = default;
+
+      MappedArray( std::vector<T> values ) : storage( std::move( values ) )
+      {
+         update();
+      }
+
+      MappedArray( const MappedArray& other ) : storage( other.storage ), elements( other.elements ), count( other.count ),
+                                                viewing( other.viewing )
+      {
+         update();
+      }
+
+      MappedArray( MappedArray&& other ) noexcept : storage( std::move( other.storage ) ), elements( other.elements ),
+                                                    count( other.count ), viewing( other.viewing )
+      {
+         update();
+         other.clear();
+      }
+
+      MappedArray& operator=( MappedArray other ) noexcept
+      {
+         storage.swap( other.storage );
+         elements = other.elements;
+         count = other.count;
+         viewing = other.viewing;
+         update();
+         return *this;
+      }
+
+      /**
+       * @brief Creates a view of count elements. The memory isn't copied
+       */
+      static MappedArray view( T* elements, size_t count )
+      {
+         MappedArray array;
+         array.elements = elements;
+         array.count = count;
+         array.viewing = true;
+         return array;
+      }
+
+      void push_back( const T& value )
+      {
+         makeOwned();
+         storage.push_back( value );
+         update();
+      }
+
+      void reserve( size_t capacity )
+      {
+         makeOwned();
+         storage.reserve( capacity );
+         update();
+      }
+
+      void shrink_to_fit()
+      {
+         if( !viewing )
+         {
+            storage.shrink_to_fit();
+            update();
+         }
+      }
+
+      void clear()
+      {
+         storage.clear();
+         viewing = false;
+         update();
+      }
+
+      [[nodiscard]] T& operator[]( size_t i ) { return elements[ i ]; }
+
+      [[nodiscard]] const T& operator[]( size_t i ) const { return elements[ i ]; }
+
+      [[nodiscard]] T* data() { return elements; }
+
+      [[nodiscard]] const T* data() const { return elements; }
+
+      [[nodiscard]] size_t size() const { return count; }
+
+      [[nodiscard]] bool empty() const { return count == 0; }
+
+      [[nodiscard]] T* begin() { return elements; }
+
+      [[nodiscard]] T* end() { return elements + count; }
+
+      [[nodiscard]] const T* begin() const { return elements; }
+
+      [[nodiscard]] const T* end() const { return elements + count; }
+
+      /**
+       * @return True if the elements are owned by someone else
+       */
+      [[nodiscard]] bool isView() const { return viewing; }
+
+   private:
+      // Points the elements to the owned storage unless this is a view
+      void update()
+      {
+         if( !viewing )
+         {
+            elements = storage.data();
+            count = storage.size();
+         }
+      }
+
+      void makeOwned()
+      {
+         if( viewing )
+         {
+            storage.assign( elements, elements + count );
+            viewing = false;
+         }
+      }
+
+      std::vector<T> storage;
+      T* elements = nullptr;
+      size_t count = 0;
+      bool viewing = false;
+};
+
+#endif //SEQUENCIAL_MAPPEDARRAY_H
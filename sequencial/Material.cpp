@@ -15,3 +15,12 @@ Material::Material( const Color& baseColor, float specular, float diffuse, float
 {
    diffuseColor = baseColor * diffuse;
 }
+
+Material::Material( const Color& baseColor, float specular, float diffuse, float shininess, float reflectivity,
+                    float transparency, float refractiveIndex )
+   : Material( baseColor, specular, diffuse, shininess )
+{
+   this->reflectivity = reflectivity;
+   this->transparency = transparency;
+   this->refractiveIndex = refractiveIndex;
+}
@@ -14,6 +14,15 @@ class Material
 
       Material( const Color& baseColor, float specular, float diffuse, float shininess );
 
+      /**
+       * @param reflectivity Fraction of the light reflected by the surface in [0,1]
+       * @param transparency Fraction of the light refracted through the surface in [0,1]. reflectivity + transparency shouldn't be more than 1,
+       * the rest of the light is the surface color itself
+       * @param refractiveIndex Refractive index of the object, e.g. 1.5 for glass
+       */
+      Material( const Color& baseColor, float specular, float diffuse, float shininess, float reflectivity, float transparency,
+                float refractiveIndex = 1.f );
+
       Material( const Material& material ) = default;
 
       // All vars public for easier access. Make private
@@ -23,5 +32,8 @@ class Material
       float specular;
       float diffuse;
       float shininess;
+      float reflectivity = 0.f;
+      float transparency = 0.f;
+      float refractiveIndex = 1.f;
 };
 #endif //SEQUENCIAL_MATERIAL_H
@@ -0,0 +1,394 @@
+//
+// Created by dominik on 17.10.26.
+//
+
+#include "Objects.h"
+#include "PacketTracer.h"
+#include "RayTracer.h"
+#include "Scene.h"
+#include "SphereBatch.h"
+#include "ToneMapper.h"
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+
+/**
+ * @brief Micro-benchmarks of the intersection, shading, and tone mapping kernels
+ *
+ * Every benchmark runs over a fixed set of randomized rays and objects (the seed is fixed, so the runs are comparable).
+ * A benchmark is repeated several times and the fastest repetition is reported, to filter out the noise of other processes.
+ * The results are printed and written to a JSON file, so they can be tracked across releases
+ */
+class MicroBench
+{
+   public:
+      struct Result
+      {
+         std::string name;
+         size_t operations;
+         double nanosecondsPerOperation;
+         double operationsPerSecond;
+         // Fraction of the operations which hit something. Negative if it doesn't apply to the benchmark
+         double hitRate;
+      };
+
+      MicroBench();
+
+      void runAll();
+
+      void writeJson( const std::string& path ) const;
+
+      void printResults() const;
+
+   private:
+      static constexpr size_t RAY_COUNT = 1 << 16;
+      static constexpr size_t OBJECT_COUNT = 64;
+      static constexpr size_t SCENE_OBJECT_COUNT = 10000;
+      static constexpr int REPETITIONS = 5;
+
+      /**
+       * Runs the function REPETITIONS times and records the fastest run
+       * @param name Name of the benchmark in the results
+       * @param operations Number of operations (e.g. ray-object tests) done by one call of the function
+       * @param function The benchmark. Returns the number of hits, or -1 if the hit rate doesn't apply
+       */
+      void run( const std::string& name, size_t operations, const std::function<long long()>& function );
+
+      void intersectionBenchmark( const std::string& name, const std::vector<std::shared_ptr<SceneObject>>& objects );
+
+      void shadingBenchmark();
+
+      // Moves a few of the scene objects every frame and compares refitting the scene with rebuilding it
+      void animationBenchmark();
+
+      std::mt19937 random;
+      std::vector<Ray> rays;
+      std::vector<std::shared_ptr<SceneObject>> spheres;
+      std::vector<std::shared_ptr<SceneObject>> planes;
+      std::vector<std::shared_ptr<SceneObject>> blocks;
+      std::vector<std::shared_ptr<SceneObject>> sceneObjects;
+      Scene scene;
+      std::vector<Result> results;
+};
+
+MicroBench::MicroBench() : random( 42 )
+{
+   std::uniform_real_distribution<float> position( -100.f, 100.f );
+   std::uniform_real_distribution<float> size( 1.f, 10.f );
+   Material material( Color( 0.5f, 0.5f, 0.5f ), 0.5f, 0.5f, 32.f );
+
+   // Rays from around the origin into the +Z half-space, where the objects are
+   rays.reserve( RAY_COUNT );
+   for( size_t i = 0; i < RAY_COUNT; ++i )
+   {
+      Vector3f direction( position( random ), position( random ), 150.f );
+      direction.normalize();
+      rays.emplace_back( Vector3f( position( random ) * 0.1f, position( random ) * 0.1f, 0.f ), direction );
+   }
+
+   auto randomCenter = [ & ]()
+   {
+      return Vector3f( position( random ), position( random ), position( random ) + 200.f );
+   };
+
+   for( size_t i = 0; i < OBJECT_COUNT; ++i )
+   {
+      spheres.push_back( std::make_shared<Sphere>( randomCenter(), material, size( random ) ) );
+      Vector3f normal( position( random ), position( random ), position( random ) );
+      normal.normalize();
+      planes.push_back( std::make_shared<Plane>( randomCenter(), material, normal, size( random ), size( random ) ) );
+      blocks.push_back( std::make_shared<Block>( randomCenter(), material, Vector3f( size( random ), size( random ), size( random ) ) ) );
+   }
+
+   // A sparser scene of smaller objects, so the rays go through several BVH levels and the shadow rays can reach the light
+   std::uniform_real_distribution<float> smallSize( 0.2f, 1.5f );
+   size = smallSize;
+   for( size_t i = 0; i < SCENE_OBJECT_COUNT; ++i )
+   {
+      switch( i % 3 )
+      {
+         case 0:
+            sceneObjects.push_back( std::make_shared<Sphere>( randomCenter(), material, size( random ) ) );
+            break;
+         case 1:
+            sceneObjects.push_back( std::make_shared<Block>( randomCenter(), material, Vector3f( size( random ), size( random ), size( random ) ) ) );
+            break;
+         default:
+            sceneObjects.push_back( std::make_shared<Plane>( randomCenter(), material, Vector3f( 0.f, 0.f, -1.f ), size( random ), size( random ) ) );
+            break;
+      }
+   }
+   scene = Scene( sceneObjects );
+}
+
+void MicroBench::run( const std::string& name, size_t operations, const std::function<long long()>& function )
+{
+   double bestSeconds = std::numeric_limits<double>::infinity();
+   long long hits = 0;
+   for( int i = 0; i < REPETITIONS; ++i )
+   {
+      auto start = std::chrono::steady_clock::now();
+      hits = function();
+      auto end = std::chrono::steady_clock::now();
+      bestSeconds = std::min( bestSeconds, std::chrono::duration<double>( end - start ).count() );
+   }
+
+   double operationCount = static_cast<double>( operations );
+   results.push_back( {
+      name,
+      operations,
+      bestSeconds * 1e9 / operationCount,
+      operationCount / bestSeconds,
+      hits < 0 ? -1.0 : static_cast<double>( hits ) / operationCount
+   } );
+}
+
+void MicroBench::intersectionBenchmark( const std::string& name, const std::vector<std::shared_ptr<SceneObject>>& objects )
+{
+   // Through the base class pointer, the same as the objects were used by the ray tracer
+   run( name, rays.size() * objects.size(), [ & ]()
+   {
+      long long hits = 0;
+      for( const auto& ray: rays )
+      {
+         for( const auto& object: objects )
+         {
+            RayHitResult result;
+            hits += object->intersects( ray, result );
+         }
+      }
+      return hits;
+   } );
+}
+
+void MicroBench::runAll()
+{
+   intersectionBenchmark( "sphere_intersects", spheres );
+   intersectionBenchmark( "plane_intersects", planes );
+   intersectionBenchmark( "block_intersects", blocks );
+
+   Scene sphereScene( spheres );
+   run( "sphere_batch", rays.size() * spheres.size(), [ & ]()
+   {
+      long long hits = 0;
+      const auto& arrays = sphereScene.getSpheres();
+      for( const auto& ray: rays )
+      {
+         float distance = std::numeric_limits<float>::infinity();
+         uint32_t index;
+         hits += SphereBatch::findClosest( arrays, 0, static_cast<uint32_t>( arrays.size() ), ray, distance, index );
+      }
+      // One closest hit per ray, not per sphere, so the hit rate isn't comparable with sphere_intersects
+      volatile long long sink = hits;
+      (void)sink;
+      return -1ll;
+   } );
+
+   run( "scene_find_closest", rays.size(), [ & ]()
+   {
+      long long hits = 0;
+      for( const auto& ray: rays )
+      {
+         Scene::PrimitiveHit hit;
+         scene.findClosest( ray, hit );
+         hits += hit.isHit();
+      }
+      return hits;
+   } );
+
+   run( "scene_is_occluded", rays.size(), [ & ]()
+   {
+      long long hits = 0;
+      for( const auto& ray: rays )
+         hits += scene.isOccluded( ray, 250.f );
+      return hits;
+   } );
+
+   unsigned int packetWidth = PacketTracer::supportedPacketWidth();
+   run( "packet_find_closest_x" + std::to_string( packetWidth ), rays.size(), [ & ]()
+   {
+      long long hits = 0;
+      Scene::PrimitiveHit packetHits[ PacketTracer::MAX_PACKET_WIDTH ];
+      for( size_t i = 0; i + packetWidth <= rays.size(); i += packetWidth )
+      {
+         PacketTracer::findClosest( scene, packetWidth, &rays[ i ], packetHits );
+         for( unsigned int lane = 0; lane < packetWidth; ++lane )
+            hits += packetHits[ lane ].isHit();
+      }
+      return hits;
+   } );
+
+   scene.setAccelerator( Scene::Accelerator::WIDE_BVH );
+   run( "scene_find_closest_wide_x" + std::to_string( scene.getSphereWideBVH().getWidth() ), rays.size(), [ & ]()
+   {
+      long long hits = 0;
+      for( const auto& ray: rays )
+      {
+         Scene::PrimitiveHit hit;
+         scene.findClosest( ray, hit );
+         hits += hit.isHit();
+      }
+      return hits;
+   } );
+   scene.setAccelerator( Scene::Accelerator::BVH );
+
+   shadingBenchmark();
+
+   std::vector<float> values( RAY_COUNT );
+   std::uniform_real_distribution<float> channel( 0.f, 2.f );
+   for( auto& value: values )
+      value = channel( random );
+
+   ToneMapper toneMapper( 1.1f, 1.6f );
+   run( "tone_map_lut", values.size(), [ & ]()
+   {
+      long long sum = 0;
+      for( float value: values )
+         sum += toneMapper.map( value );
+      volatile long long sink = sum;
+      (void)sink;
+      return -1ll;
+   } );
+
+   run( "tone_map_exact", values.size(), [ & ]()
+   {
+      long long sum = 0;
+      for( float value: values )
+         sum += ToneMapper::mapExact( value, 1.1f, 1.6f );
+      volatile long long sink = sum;
+      (void)sink;
+      return -1ll;
+   } );
+
+   animationBenchmark();
+}
+
+void MicroBench::animationBenchmark()
+{
+   // Every hundredth sphere or block moves back and forth, the rest of the scene is static
+   std::vector<size_t> moving;
+   for( size_t i = 0; i < sceneObjects.size(); i += 100 )
+   {
+      if( !dynamic_cast<Plane*>( sceneObjects[ i ].get() ) )
+         moving.push_back( i );
+   }
+
+   Vector3f offset( 0.5f, 0.f, 0.f );
+   auto moveObjects = [ & ]()
+   {
+      offset = -offset;
+      for( auto i: moving )
+      {
+         SceneObject& object = *sceneObjects[ i ];
+         object.centerPosition = object.centerPosition + offset;
+         if( auto* block = dynamic_cast<Block*>( &object ) )
+         {
+            block->minPoint = block->minPoint + offset;
+            block->maxPoint = block->maxPoint + offset;
+         }
+      }
+   };
+
+   Scene animated( sceneObjects );
+   run( "scene_refit", moving.size(), [ & ]()
+   {
+      moveObjects();
+      animated.update( sceneObjects, moving );
+      return -1ll;
+   } );
+
+   run( "scene_rebuild", moving.size(), [ & ]()
+   {
+      moveObjects();
+      animated = Scene( sceneObjects );
+      return -1ll;
+   } );
+}
+
+void MicroBench::printResults() const
+{
+   for( const auto& result: results )
+   {
+      std::cout << result.name << ": " << result.nanosecondsPerOperation << " ns/op, " << result.operationsPerSecond / 1e6 << " Mops/s";
+      if( result.hitRate >= 0.0 )
+         std::cout << ", hit rate " << result.hitRate * 100.0 << " %";
+      std::cout << std::endl;
+   }
+}
+
+void MicroBench::writeJson( const std::string& path ) const
+{
+   std::ofstream file( path );
+   if( !file )
+      throw std::runtime_error( "Can't open " + path );
+
+   file << "{\n  \"benchmarks\": [\n";
+   for( size_t i = 0; i < results.size(); ++i )
+   {
+      const auto& result = results[ i ];
+      file << "    {\"name\": \"" << result.name << "\", \"operations\": " << result.operations << ", \"ns_per_op\": " <<
+            result.nanosecondsPerOperation << ", \"ops_per_second\": " << result.operationsPerSecond << ", \"hit_rate\": ";
+      if( result.hitRate >= 0.0 )
+         file << result.hitRate;
+      else
+         file << "null";
+      file << "}" << ( i + 1 < results.size() ? "," : "" ) << "\n";
+   }
+   file << "  ]\n}\n";
+}
+
+void MicroBench::shadingBenchmark()
+{
+   TracerOptions options;
+   options.ambientLightColor = Color( 0.1f, 0.1f, 0.1f );
+   // Next to the camera, so most of the visible points are lit
+   Light light( Vector3f( 0.f, 10.f, 0.f ), Color( 1.f, 1.f, 1.f ), 4.f );
+
+   // Shade the closest hits of the rays, so the shading works with real hit points
+   std::vector<std::pair<Ray, RayTracer::RayTraceResult>> hits;
+   for( const auto& ray: rays )
+   {
+      auto result = RayTracer::traceRay( ray, scene );
+      if( result.material )
+         hits.emplace_back( ray, result );
+   }
+   if( hits.empty() )
+      return;
+
+   run( "blinn_phong_reflexion", hits.size(), [ & ]()
+   {
+      long long lit = 0;
+      for( const auto& [ ray, result ]: hits )
+         lit += RayTracer::blinnPhongReflexion( light, result, ray, scene ).R > 0.f;
+      // The hit rate is the fraction of the points which aren't in a shadow
+      return lit;
+   } );
+}
+
+int main( int argc, char** argv )
+{
+   // Checked before the benchmarks run, so e.g. --help doesn't run them and then write a file named "--help"
+   if( argc > 2 || ( argc == 2 && argv[ 1 ][ 0 ] == '-' ) )
+   {
+      std::cout << "Usage: " << argv[ 0 ] << " [output.json]" << std::endl;
+      return -1;
+   }
+   std::string outputPath = argc > 1 ? argv[ 1 ] : "bench.json";
+
+   try
+   {
+      MicroBench bench;
+      bench.runAll();
+      bench.printResults();
+      bench.writeJson( outputPath );
+   }
+   catch( const std::exception& error )
+   {
+      std::cerr << error.what() << std::endl;
+      return -1;
+   }
+   std::cout << "Results written to " << outputPath << std::endl;
+}
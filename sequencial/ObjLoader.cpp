@@ -0,0 +1,198 @@
+//
+// Created by dominik on 18.10.26.
+//
+
+#include "ObjLoader.h"
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+namespace
+{
+   /**
+    * @brief Parses the statements of one OBJ file into the mesh buffers
+    */
+   class ObjParser
+   {
+      public:
+         explicit ObjParser( const std::string& path ) : path( path )
+         {
+         }
+
+         void parseLine( std::string_view line )
+         {
+            ++lineNumber;
+            std::string_view keyword = nextToken( line );
+            if( keyword == "v" )
+               vertices.push_back( parseVector( line ) );
+            else if( keyword == "vn" )
+               normals.push_back( parseVector( line ) );
+            else if( keyword == "f" )
+               parseFace( line );
+         }
+
+         std::shared_ptr<TriangleMesh> createMesh()
+         {
+            if( hasFaceWithoutNormals )
+            {
+               normals.clear();
+               normalIndices.clear();
+            }
+            return std::make_shared<TriangleMesh>( std::move( vertices ), std::move( indices ), std::move( normals ),
+                                                   std::move( normalIndices ) );
+         }
+
+         [[noreturn]] void fail( const std::string& message ) const
+         {
+            throw std::runtime_error( path + ":" + std::to_string( lineNumber ) + ": " + message );
+         }
+
+      private:
+         // Removes and returns the next whitespace separated token
+         static std::string_view nextToken( std::string_view& line )
+         {
+            size_t start = line.find_first_not_of( " \t\r" );
+            if( start == std::string_view::npos )
+            {
+               line = {};
+               return {};
+            }
+            size_t end = line.find_first_of( " \t\r", start );
+            std::string_view token = line.substr( start, end - start );
+            line.remove_prefix( end == std::string_view::npos ? line.size() : end );
+            return token;
+         }
+
+         float parseFloat( std::string_view token ) const
+         {
+            float value = 0.f;
+            auto result = std::from_chars( token.data(), token.data() + token.size(), value );
+            if( result.ec != std::errc() || result.ptr != token.data() + token.size() )
+               fail( "Invalid number " + std::string( token ) );
+            return value;
+         }
+
+         Vector3f parseVector( std::string_view& line ) const
+         {
+            Vector3f vector;
+            for( size_t i = 0; i < 3; ++i )
+            {
+               std::string_view token = nextToken( line );
+               if( token.empty() )
+                  fail( "Expected 3 coordinates" );
+               vector[ i ] = parseFloat( token );
+            }
+            // An optional w coordinate of positions is ignored
+            return vector;
+         }
+
+         // Converts a 1-based (or negative, relative to the end) OBJ index into a 0-based index
+         uint32_t parseIndex( std::string_view token, size_t count ) const
+         {
+            long long index = 0;
+            auto result = std::from_chars( token.data(), token.data() + token.size(), index );
+            if( result.ec != std::errc() || result.ptr != token.data() + token.size() )
+               fail( "Invalid index " + std::string( token ) );
+
+            long long resolved = index < 0 ? static_cast<long long>( count ) + index : index - 1;
+            if( index == 0 || resolved < 0 || resolved >= static_cast<long long>( count ) )
+               fail( "Index " + std::string( token ) + " out of range" );
+            return static_cast<uint32_t>( resolved );
+         }
+
+         void parseFace( std::string_view& line )
+         {
+            corners.clear();
+            cornerNormals.clear();
+            bool withNormals = true;
+            for( std::string_view token = nextToken( line ); !token.empty() && token[ 0 ] != '#'; token = nextToken( line ) )
+            {
+               // position[/texture[/normal]]
+               size_t slash = token.find( '/' );
+               corners.push_back( parseIndex( token.substr( 0, slash ), vertices.size() ) );
+
+               size_t normalSlash = slash == std::string_view::npos ? slash : token.find( '/', slash + 1 );
+               if( normalSlash == std::string_view::npos )
+                  withNormals = false;
+               else
+                  cornerNormals.push_back( parseIndex( token.substr( normalSlash + 1 ), normals.size() ) );
+            }
+
+            if( corners.size() < 3 )
+               fail( "A face needs at least 3 vertices" );
+            hasFaceWithoutNormals = hasFaceWithoutNormals || !withNormals;
+
+            // Triangle fan around the first corner
+            for( size_t i = 1; i + 1 < corners.size(); ++i )
+            {
+               indices.insert( indices.end(), { corners[ 0 ], corners[ i ], corners[ i + 1 ] } );
+               if( !hasFaceWithoutNormals )
+                  normalIndices.insert( normalIndices.end(), { cornerNormals[ 0 ], cornerNormals[ i ], cornerNormals[ i + 1 ] } );
+            }
+         }
+
+         const std::string& path;
+         size_t lineNumber = 0;
+         std::vector<Vector3f> vertices;
+         std::vector<Vector3f> normals;
+         std::vector<uint32_t> indices;
+         std::vector<uint32_t> normalIndices;
+         bool hasFaceWithoutNormals = false;
+         // Indices of the current face, kept to reuse the memory
+         std::vector<uint32_t> corners;
+         std::vector<uint32_t> cornerNormals;
+   };
+}
+
+std::shared_ptr<TriangleMesh> ObjLoader::load( const std::string& path )
+{
+   std::ifstream file( path, std::ios::binary );
+   if( !file )
+      throw std::runtime_error( "Can't open " + path );
+
+   ObjParser parser( path );
+   // The unfinished last line of a chunk is moved to the front of the buffer and completed by the next chunk
+   std::vector<char> buffer( CHUNK_SIZE );
+   size_t pending = 0;
+   while( true )
+   {
+      if( pending == buffer.size() )
+         buffer.resize( buffer.size() * 2 );
+
+      file.read( buffer.data() + pending, static_cast<std::streamsize>( buffer.size() - pending ) );
+      size_t end = pending + static_cast<size_t>( file.gcount() );
+      bool isLast = end < buffer.size();
+      if( file.bad() )
+         parser.fail( "Read error" );
+
+      std::string_view text( buffer.data(), end );
+      size_t lineStart = 0;
+      for( size_t newline = text.find( '\n' ); newline != std::string_view::npos; newline = text.find( '\n', lineStart ) )
+      {
+         parser.parseLine( text.substr( lineStart, newline - lineStart ) );
+         lineStart = newline + 1;
+      }
+
+      if( isLast )
+      {
+         if( lineStart < end )
+            parser.parseLine( text.substr( lineStart ) );
+         break;
+      }
+
+      pending = end - lineStart;
+      std::memmove( buffer.data(), buffer.data() + lineStart, pending );
+   }
+
+   try
+   {
+      return parser.createMesh();
+   }
+   catch( const std::runtime_error& error )
+   {
+      throw std::runtime_error( path + ": " + error.what() );
+   }
+}
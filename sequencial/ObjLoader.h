@@ -0,0 +1,33 @@
+//
+// Created by dominik on 18.10.26.
+//
+
+#ifndef SEQUENCIAL_OBJLOADER_H
+#define SEQUENCIAL_OBJLOADER_H
+
+#include "TriangleMesh.h"
+#include <memory>
+#include <string>
+
+/**
+ * @brief Loads triangle meshes from Wavefront OBJ files
+ *
+ * The file is read in fixed-size chunks and parsed line by line, so only the vertex and index buffers of the mesh are kept in memory, never the whole file.
+ * Supported statements are v (positions), vn (normals), and f (faces with the v, v/vt, v//vn, and v/vt/vn forms, including negative relative indices).
+ * Polygons are split into triangle fans. Everything else (texture coordinates, groups, materials, smoothing groups, ...) is skipped.
+ * The normals are only used if every face references them, otherwise the mesh is flat shaded
+ */
+class ObjLoader
+{
+   public:
+      /**
+       * @brief Loads the file and builds the mesh BVH
+       * @throws std::runtime_error With the path and line number if the file can't be read or is invalid
+       */
+      static std::shared_ptr<TriangleMesh> load( const std::string& path );
+
+   private:
+      static constexpr size_t CHUNK_SIZE = 1 << 16;
+};
+
+#endif //SEQUENCIAL_OBJLOADER_H
@@ -3,7 +3,10 @@
 //
 
 #include "Objects.h"
+#include "Intersections.h"
 #include "Math.h"
+#include "Scene.h"
+#include <stdexcept>
 
 Light::Light( const Vector3f& center, const Color& color, float intensity )
 {
@@ -16,79 +19,91 @@ SceneObject::SceneObject( const Vector3f& center, const Material& material ) : c
 {
 }
 
+void SceneObject::updateInScene( Scene&, uint32_t ) const
+{
+   throw std::runtime_error( "Only spheres, blocks, and instances can be moved in a built scene" );
+}
+
 Sphere::Sphere( const Vector3f& center, const Material& material, float radius ) : SceneObject( center, material ),
                                                                                    radius( radius )
 {
 }
 
-// Math behind ray-sphere intersection: https://www.scratchapixel.com/lessons/3d-basic-rendering/minimal-ray-tracer-rendering-simple-shapes/ray-sphere-intersection.html
 bool Sphere::intersects( const Ray& ray, RayHitResult& result ) const
 {
-   auto offsetCenter = ray.startPoint - centerPosition;
-   // Optional check. However, branching costs something so we ignore it and only construct normalized rays in the Ray-Tracer class
-   /*
-   if( std::hypot( ray.direction.x, ray.direction.y, ray.direction.z ) != 1.f )
-      throw std::runtime_error( "Ray direction is not normalized" );
-   */
-
-   // We can ignore a since it is equal to Direction^2, which is a dot product of Direction vector.
-   // However, the direction vector is normalized, so the result is 1, and it won't play a part in the quadratic formula solutions
-   float b = VectorOps::dotProduct( ray.direction, offsetCenter );
-   float c = VectorOps::dotProduct( offsetCenter, offsetCenter ) - ( radius * radius );
-   float discriminant = ( b * b ) - c;
-
-   // No real solution
-   if( discriminant < std::numeric_limits<float>::epsilon() )
+   float distance;
+   if( !Intersection::sphereDistance( ray, centerPosition, radius, distance ) )
       return false;
 
-   float discriminantSqrt = std::sqrt( discriminant );
-   float root = -b - discriminantSqrt;
-
-   if( root < EPSILON )
-   {
-      root = -b + discriminantSqrt;
-      if( root < EPSILON )
-         return false;
-   }
-
-   result.distance = root;
-   // This math is moved into a ray tracer to optimize instruction count. Normals can be moved to if we switch to enum objects
-   result.hitPoint = ray.startPoint + ( result.distance * ray.direction );
-   result.normal = result.hitPoint - centerPosition;
-   result.normal.normalize();
+   Intersection::sphereSurface( ray, centerPosition, distance, result );
    return true;
 }
 
+bool Sphere::occludes( const Ray& ray, float maxDistance ) const
+{
+   float distance;
+   return Intersection::sphereDistance( ray, centerPosition, radius, distance ) && distance < maxDistance;
+}
+
+AABB Sphere::getBounds() const
+{
+   Vector3f extents( radius, radius, radius );
+   return { centerPosition - extents, centerPosition + extents };
+}
+
+uint32_t Sphere::addToScene( Scene& scene ) const
+{
+   return scene.addSphere( centerPosition, radius, scene.addMaterial( material ) );
+}
+
+void Sphere::updateInScene( Scene& scene, uint32_t index ) const
+{
+   scene.moveSphere( index, centerPosition, radius );
+}
+
 Plane::Plane( const Vector3f& center, const Material& material, const Vector3f& normal, float halfWidth, float halfDepth )
    : SceneObject( center, material ), normal( normal ), halfWidth( halfWidth ), halfDepth( halfDepth )
 {
+   tangentFrame( normal, tangent, bitangent );
 }
 
-// Math behind plane intersection: https://www.scratchapixel.com/lessons/3d-basic-rendering/minimal-ray-tracer-rendering-simple-shapes/ray-plane-and-ray-disk-intersection.html
-bool Plane::intersects( const Ray& ray, RayHitResult& result ) const
+void Plane::tangentFrame( const Vector3f& normal, Vector3f& tangent, Vector3f& bitangent )
 {
-   auto denominator = VectorOps::dotProduct( normal, ray.direction );
+   // Any direction not parallel with the normal works, this one keeps the width horizontal
+   Vector3f reference = std::abs( normal.y() ) > 0.999f ? Vector3f( 0.f, 0.f, 1.f ) : Vector3f( 0.f, 1.f, 0.f );
+   tangent = VectorOps::crossProduct( normal, reference );
+   tangent.normalize();
+   bitangent = VectorOps::crossProduct( tangent, normal );
+   bitangent.normalize();
+}
 
-   // Check if we don't divide by 0. If the denominator is 0 the plane and the ray are parallel and never intersect
-   if( std::abs( denominator ) < std::numeric_limits<float>::epsilon() )
+bool Plane::intersects( const Ray& ray, RayHitResult& result ) const
+{
+   float distance;
+   if( !Intersection::planeDistance( ray, centerPosition, normal, tangent, bitangent, halfWidth, halfDepth, distance ) )
       return false;
 
-   float distance = VectorOps::dotProduct( centerPosition - ray.startPoint, normal ) / denominator;
+   Intersection::planeSurface( ray, normal, distance, result );
+   return true;
+}
 
-   if( distance < EPSILON )
-      return false;
+bool Plane::occludes( const Ray& ray, float maxDistance ) const
+{
+   float distance;
+   return Intersection::planeDistance( ray, centerPosition, normal, tangent, bitangent, halfWidth, halfDepth, distance ) &&
+          distance < maxDistance;
+}
 
-   // TODO add a check for planes dimensions to make the intersection work with finite planes
+AABB Plane::getBounds() const
+{
+   return Intersection::planeBounds( centerPosition, tangent, bitangent, halfWidth, halfDepth );
+}
 
-   result.normal = normal;
-   result.distance = distance;
-   result.hitPoint = ray.startPoint + ( result.distance * ray.direction );
-   return true;
+uint32_t Plane::addToScene( Scene& scene ) const
+{
+   return scene.addPlane( centerPosition, normal, tangent, bitangent, halfWidth, halfDepth, scene.addMaterial( material ) );
 }
 
-// Math for AABB intersection
-// https://tavianator.com/2022/ray_box_boundary.html
-// https://www.scratchapixel.com/lessons/3d-basic-rendering/minimal-ray-tracer-rendering-simple-shapes/ray-box-intersection.html
 Block::Block( const Vector3f& center, const Material& material, const Vector3f& extents ) : SceneObject( center, material )
 {
    minPoint = center - extents;
@@ -97,31 +112,31 @@ Block::Block( const Vector3f& center, const Material& material, const Vector3f&
 
 bool Block::intersects( const Ray& ray, RayHitResult& result ) const
 {
-   Vector3f t1 = VectorOps::hadamardProduct( minPoint - ray.startPoint, ray.inverseDirection );
-   Vector3f t2 = VectorOps::hadamardProduct( maxPoint - ray.startPoint, ray.inverseDirection );
-
-   Vector3f tSmaller = VectorOps::min( t1, t2 );
-   Vector3f tBigger = VectorOps::max( t1, t2 );
-
-   float tMin = std::max( std::max( tSmaller.x(), tSmaller.y() ), tSmaller.z() );
-   float tMax = std::min( std::min( tBigger.x(), tBigger.y() ), tBigger.z() );
-
-   if( tMax < std::max( tMin, 0.f ) )
+   float distance;
+   if( !Intersection::blockDistance( ray, minPoint, maxPoint, distance ) )
       return false;
 
-   bool isInside = tMin < 0.f;
-   result.distance = isInside ? tMax : tMin;
-   result.hitPoint = ray.startPoint + ( result.distance * ray.direction );
+   Intersection::blockSurface( ray, minPoint, maxPoint, distance, result );
+   return true;
+}
 
-   int axis = 0;
-   axis = (tSmaller.y() > tSmaller.x()) ? 1 : axis;
-   axis = (tSmaller.z() > tSmaller[axis]) ? 2 : axis;
+bool Block::occludes( const Ray& ray, float maxDistance ) const
+{
+   float distance;
+   return Intersection::blockDistance( ray, minPoint, maxPoint, distance ) && distance < maxDistance;
+}
 
-   result.normal = Vector3f( 0.f, 0.f, 0.f );
-   result.normal[ axis ] = std::copysign( 1.0f, -ray.direction[ axis ] );
+AABB Block::getBounds() const
+{
+   return { minPoint, maxPoint };
+}
 
-   if( isInside )
-      result.normal = -result.normal;
+uint32_t Block::addToScene( Scene& scene ) const
+{
+   return scene.addBlock( minPoint, maxPoint, scene.addMaterial( material ) );
+}
 
-   return true;
+void Block::updateInScene( Scene& scene, uint32_t index ) const
+{
+   scene.moveBlock( index, minPoint, maxPoint );
 }
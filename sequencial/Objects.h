@@ -5,6 +5,7 @@
 #ifndef SEQUENCIAL_OBJECTS_H
 #define SEQUENCIAL_OBJECTS_H
 
+#include "AABB.h"
 #include "Color.h"
 #include "Material.h"
 #include "Vector.h"
@@ -13,6 +14,8 @@
 
 struct Ray
 {
+   Ray() = default;
+
    Ray( const Vector3f& startPoint, const Vector3f& direction )
       : startPoint( startPoint ), direction( direction ),
         inverseDirection( Vector3f( 1.f / direction.x(), 1.f / direction.y(), 1.f / direction.z() ) )
@@ -38,6 +41,8 @@ class Light
       float intensity;
 };
 
+class Scene;
+
 // TODO For CUDA use an enum instead of virtual method
 
 struct RayHitResult
@@ -67,6 +72,38 @@ class SceneObject
        */
       virtual bool intersects( const Ray& ray, RayHitResult& result ) const = 0;
 
+      /**
+       * @brief Determines if an object blocks a ray before it reaches the given distance. Used for shadow rays
+       *
+       * Cheaper than intersects since only the intersection distance is computed. The hit point and the normal are skipped
+       *
+       * @param ray
+       * @param maxDistance Intersections at this distance or further don't count (e.g. distance to the light)
+       * @return True if the ray intersects the object closer than maxDistance
+       */
+      [[nodiscard]] virtual bool occludes( const Ray& ray, float maxDistance ) const = 0;
+
+      /**
+       * @brief Returns the axis-aligned bounding box of the object, used for building the acceleration structure
+       * @return The bounds of the object. Objects without finite bounds return AABB::infinite() and are tested separately
+       */
+      [[nodiscard]] virtual AABB getBounds() const = 0;
+
+      /**
+       * @brief Adds the object into the structure-of-arrays scene used by the ray tracer
+       * @param scene The scene to add the object to
+       * @return Index of the object among the scene primitives of its type, see Scene::addSphere and the other add methods
+       */
+      virtual uint32_t addToScene( Scene& scene ) const = 0;
+
+      /**
+       * @brief Moves the scene primitive of the object to the current position of the object. The material isn't updated
+       * @param scene The scene the object was added to
+       * @param index The index returned by addToScene
+       * @throws std::runtime_error If the object type can't be moved (planes and meshes)
+       */
+      virtual void updateInScene( Scene& scene, uint32_t index ) const;
+
       Vector3f centerPosition;
       Material material{};
       static constexpr float EPSILON = 0.0001f;
@@ -81,6 +118,14 @@ class Sphere : public SceneObject
 
       bool intersects( const Ray& ray, RayHitResult& result ) const override;
 
+      [[nodiscard]] bool occludes( const Ray& ray, float maxDistance ) const override;
+
+      [[nodiscard]] AABB getBounds() const override;
+
+      uint32_t addToScene( Scene& scene ) const override;
+
+      void updateInScene( Scene& scene, uint32_t index ) const override;
+
       float radius{};
 };
 
@@ -89,13 +134,35 @@ class Plane : public SceneObject
    public:
       Plane() = delete;
 
+      // Half size of an infinite plane, e.g. a floor reaching the horizon
+      static constexpr float UNBOUNDED = std::numeric_limits<float>::infinity();
+
       Plane( const Vector3f& center, const Material& material, const Vector3f& normal, float halfWidth, float halfDepth );
 
       bool intersects( const Ray& ray, RayHitResult& result ) const override;
 
+      [[nodiscard]] bool occludes( const Ray& ray, float maxDistance ) const override;
+
+      [[nodiscard]] AABB getBounds() const override;
+
+      uint32_t addToScene( Scene& scene ) const override;
+
+      /**
+       * @brief Calculates the directions of the plane width and depth from its normal
+       *
+       * The width is along the X axis and the depth is along the Z axis for horizontal planes. For other planes the width is horizontal
+       * @param normal Normalized plane normal
+       * @param tangent Out parameter with the direction of the plane width
+       * @param bitangent Out parameter with the direction of the plane depth
+       */
+      static void tangentFrame( const Vector3f& normal, Vector3f& tangent, Vector3f& bitangent );
+
       Vector3f normal;
+      // Directions of the plane width and depth. Precomputed from the normal
+      Vector3f tangent;
+      Vector3f bitangent;
       // These values represent the plane dimensions so that we don't have infinite planes.
-      // From the center point we define half-width and half-depth to limit the plane
+      // From the center point we define half-width and half-depth to limit the plane. Use infinity for an infinite plane
       float halfWidth{};
       float halfDepth{};
 };
@@ -110,6 +177,14 @@ class Block : public SceneObject
 
       bool intersects( const Ray& ray, RayHitResult& result ) const override;
 
+      [[nodiscard]] bool occludes( const Ray& ray, float maxDistance ) const override;
+
+      [[nodiscard]] AABB getBounds() const override;
+
+      uint32_t addToScene( Scene& scene ) const override;
+
+      void updateInScene( Scene& scene, uint32_t index ) const override;
+
       Vector3f minPoint;
       Vector3f maxPoint;
 };
@@ -0,0 +1,283 @@
+//
+// Created by dominik on 17.10.26.
+//
+
+// No include guard. This file is included by PacketTracer.cpp once per instruction set, inside a namespace which defines
+// the Float register type (Simd::Float4 or Simd::Float8). See Simd.h
+
+constexpr int WIDTH = Float::WIDTH;
+
+struct RayPacket
+{
+   Float originX, originY, originZ;
+   Float directionX, directionY, directionZ;
+   Float inverseX, inverseY, inverseZ;
+};
+
+struct PacketResult
+{
+   Float distance;
+   ObjectType type[ WIDTH ];
+   uint32_t index[ WIDTH ];
+};
+
+inline RayPacket loadRays( const Ray* rays )
+{
+   alignas( 32 ) float components[ 9 ][ WIDTH ];
+   for( int lane = 0; lane < WIDTH; ++lane )
+   {
+      for( int axis = 0; axis < 3; ++axis )
+      {
+         components[ axis ][ lane ] = rays[ lane ].startPoint[ axis ];
+         components[ 3 + axis ][ lane ] = rays[ lane ].direction[ axis ];
+         components[ 6 + axis ][ lane ] = rays[ lane ].inverseDirection[ axis ];
+      }
+   }
+
+   return {
+      Float::load( components[ 0 ] ), Float::load( components[ 1 ] ), Float::load( components[ 2 ] ),
+      Float::load( components[ 3 ] ), Float::load( components[ 4 ] ), Float::load( components[ 5 ] ),
+      Float::load( components[ 6 ] ), Float::load( components[ 7 ] ), Float::load( components[ 8 ] )
+   };
+}
+
+// Updates the lanes of the hit mask with a closer hit
+inline void recordHits( PacketResult& result, Float hitMask, Float distance, ObjectType type, uint32_t index )
+{
+   int lanes = moveMask( hitMask );
+   if( lanes == 0 )
+      return;
+
+   result.distance = select( hitMask, distance, result.distance );
+   while( lanes != 0 )
+   {
+      int lane = __builtin_ctz( static_cast<unsigned int>( lanes ) );
+      result.type[ lane ] = type;
+      result.index[ lane ] = index;
+      lanes &= lanes - 1;
+   }
+}
+
+// Packet version of Intersection::planeDistance for a contiguous range of planes
+inline void intersectPlanes( const PlaneArrays& planes, uint32_t first, uint32_t count, const RayPacket& rays,
+                             PacketResult& result )
+{
+   const Float parallelEpsilon = Float::broadcast( std::numeric_limits<float>::epsilon() );
+   const Float minDistance = Float::broadcast( Intersection::EPSILON );
+
+   for( auto i = first; i < first + count; ++i )
+   {
+      Float normalX = Float::broadcast( planes.normalX[ i ] );
+      Float normalY = Float::broadcast( planes.normalY[ i ] );
+      Float normalZ = Float::broadcast( planes.normalZ[ i ] );
+
+      Float denominator = ( normalX * rays.directionX + normalY * rays.directionY ) + normalZ * rays.directionZ;
+      Float valid = notLessThan( abs( denominator ), parallelEpsilon );
+
+      Float centerX = Float::broadcast( planes.centerX[ i ] );
+      Float centerY = Float::broadcast( planes.centerY[ i ] );
+      Float centerZ = Float::broadcast( planes.centerZ[ i ] );
+      Float toCenterX = centerX - rays.originX;
+      Float toCenterY = centerY - rays.originY;
+      Float toCenterZ = centerZ - rays.originZ;
+      Float distance = ( ( toCenterX * normalX + toCenterY * normalY ) + toCenterZ * normalZ ) / denominator;
+
+      valid = valid & greaterOrEqual( distance, minDistance ) & lessThan( distance, result.distance );
+      if( moveMask( valid ) == 0 )
+         continue;
+
+      // Reject hits outside the rectangle
+      Float offsetX = ( rays.originX + distance * rays.directionX ) - centerX;
+      Float offsetY = ( rays.originY + distance * rays.directionY ) - centerY;
+      Float offsetZ = ( rays.originZ + distance * rays.directionZ ) - centerZ;
+      Float width = ( offsetX * Float::broadcast( planes.tangentX[ i ] ) + offsetY * Float::broadcast( planes.tangentY[ i ] ) ) +
+                    offsetZ * Float::broadcast( planes.tangentZ[ i ] );
+      Float depth = ( offsetX * Float::broadcast( planes.bitangentX[ i ] ) + offsetY * Float::broadcast( planes.bitangentY[ i ] ) ) +
+                    offsetZ * Float::broadcast( planes.bitangentZ[ i ] );
+
+      valid = valid & greaterOrEqual( Float::broadcast( planes.halfWidth[ i ] ), abs( width ) ) &
+              greaterOrEqual( Float::broadcast( planes.halfDepth[ i ] ), abs( depth ) );
+      recordHits( result, valid, distance, PLANE, i );
+   }
+}
+
+// Packet version of Intersection::sphereDistance for a contiguous range of spheres
+inline void intersectSpheres( const SphereArrays& spheres, uint32_t first, uint32_t count, const RayPacket& rays,
+                              PacketResult& result )
+{
+   const Float discriminantEpsilon = Float::broadcast( std::numeric_limits<float>::epsilon() );
+   const Float minDistance = Float::broadcast( Intersection::EPSILON );
+
+   for( auto i = first; i < first + count; ++i )
+   {
+      Float offsetX = rays.originX - Float::broadcast( spheres.centerX[ i ] );
+      Float offsetY = rays.originY - Float::broadcast( spheres.centerY[ i ] );
+      Float offsetZ = rays.originZ - Float::broadcast( spheres.centerZ[ i ] );
+
+      Float b = ( rays.directionX * offsetX + rays.directionY * offsetY ) + rays.directionZ * offsetZ;
+      Float c = ( ( offsetX * offsetX + offsetY * offsetY ) + offsetZ * offsetZ ) -
+                Float::broadcast( spheres.radius[ i ] * spheres.radius[ i ] );
+      Float discriminant = b * b - c;
+
+      Float valid = notLessThan( discriminant, discriminantEpsilon );
+      if( moveMask( valid ) == 0 )
+         continue;
+
+      Float discriminantSqrt = sqrt( discriminant );
+      Float nearRoot = -b - discriminantSqrt;
+      Float farRoot = -b + discriminantSqrt;
+      Float root = select( lessThan( nearRoot, minDistance ), farRoot, nearRoot );
+
+      valid = valid & notLessThan( root, minDistance );
+      recordHits( result, valid & lessThan( root, result.distance ), root, SPHERE, i );
+   }
+}
+
+// Packet version of the slab test in Intersection::blockDistance
+inline void intersectBlocks( const BlockArrays& blocks, uint32_t first, uint32_t count, const RayPacket& rays,
+                             PacketResult& result )
+{
+   const Float zero = Float::broadcast( 0.f );
+
+   for( auto i = first; i < first + count; ++i )
+   {
+      Float t1x = ( Float::broadcast( blocks.minX[ i ] ) - rays.originX ) * rays.inverseX;
+      Float t1y = ( Float::broadcast( blocks.minY[ i ] ) - rays.originY ) * rays.inverseY;
+      Float t1z = ( Float::broadcast( blocks.minZ[ i ] ) - rays.originZ ) * rays.inverseZ;
+      Float t2x = ( Float::broadcast( blocks.maxX[ i ] ) - rays.originX ) * rays.inverseX;
+      Float t2y = ( Float::broadcast( blocks.maxY[ i ] ) - rays.originY ) * rays.inverseY;
+      Float t2z = ( Float::broadcast( blocks.maxZ[ i ] ) - rays.originZ ) * rays.inverseZ;
+
+      Float tMin = max( max( min( t1x, t2x ), min( t1y, t2y ) ), min( t1z, t2z ) );
+      Float tMax = min( min( max( t1x, t2x ), max( t1y, t2y ) ), max( t1z, t2z ) );
+
+      Float valid = notLessThan( tMax, max( tMin, zero ) );
+      Float distance = select( lessThan( tMin, zero ), tMax, tMin );
+      recordHits( result, valid & lessThan( distance, result.distance ), distance, BLOCK, i );
+   }
+}
+
+// Packet version of AABB::intersects. Returns the mask of rays which hit the box closer than their current closest hit
+inline Float intersectBounds( const AABB& bounds, const RayPacket& rays, Float closest, Float& entry )
+{
+   Float tx1 = ( Float::broadcast( bounds.minPoint.x() ) - rays.originX ) * rays.inverseX;
+   Float tx2 = ( Float::broadcast( bounds.maxPoint.x() ) - rays.originX ) * rays.inverseX;
+   Float ty1 = ( Float::broadcast( bounds.minPoint.y() ) - rays.originY ) * rays.inverseY;
+   Float ty2 = ( Float::broadcast( bounds.maxPoint.y() ) - rays.originY ) * rays.inverseY;
+   Float tz1 = ( Float::broadcast( bounds.minPoint.z() ) - rays.originZ ) * rays.inverseZ;
+   Float tz2 = ( Float::broadcast( bounds.maxPoint.z() ) - rays.originZ ) * rays.inverseZ;
+
+   Float tMin = max( max( min( tx1, tx2 ), min( ty1, ty2 ) ), min( tz1, tz2 ) );
+   Float tMax = min( min( max( tx1, tx2 ), max( ty1, ty2 ) ), max( tz1, tz2 ) );
+
+   entry = tMin;
+   return greaterOrEqual( tMax, max( tMin, Float::broadcast( 0.f ) ) ) & lessThan( tMin, closest );
+}
+
+// The smallest entry distance of the rays in the mask
+inline float closestEntry( Float entry, Float mask )
+{
+   alignas( 32 ) float entries[ WIDTH ];
+   select( mask, entry, Float::broadcast( std::numeric_limits<float>::infinity() ) ).store( entries );
+
+   float closest = entries[ 0 ];
+   for( int lane = 1; lane < WIDTH; ++lane )
+      closest = std::min( closest, entries[ lane ] );
+   return closest;
+}
+
+/**
+ * Traverses the BVH with the whole packet. A node is visited if any of the rays hits it, and the children are visited in the order of the closest entry distance
+ */
+template<typename LeafFunction>
+void traverse( const BVH& bvh, const RayPacket& rays, PacketResult& result, LeafFunction&& leafFunction )
+{
+   const auto& nodes = bvh.getNodes();
+   if( nodes.empty() )
+      return;
+
+   Float entry;
+   if( moveMask( intersectBounds( nodes[ 0 ].bounds, rays, result.distance, entry ) ) == 0 )
+      return;
+
+   uint32_t stack[ BVH::MAX_DEPTH ];
+   int stackSize = 0;
+   uint32_t current = 0;
+
+   while( true )
+   {
+      const BVH::Node& node = nodes[ current ];
+
+      if( node.isLeaf() )
+         leafFunction( node.leftFirst, node.primitiveCount );
+      else
+      {
+         Float leftEntry, rightEntry;
+         Float leftMask = intersectBounds( nodes[ node.leftFirst ].bounds, rays, result.distance, leftEntry );
+         Float rightMask = intersectBounds( nodes[ node.leftFirst + 1 ].bounds, rays, result.distance, rightEntry );
+         bool hitLeft = moveMask( leftMask ) != 0;
+         bool hitRight = moveMask( rightMask ) != 0;
+
+         if( hitLeft && hitRight )
+         {
+            bool leftFirst = closestEntry( leftEntry, leftMask ) <= closestEntry( rightEntry, rightMask );
+            current = leftFirst ? node.leftFirst : node.leftFirst + 1;
+            stack[ stackSize++ ] = leftFirst ? node.leftFirst + 1 : node.leftFirst;
+            continue;
+         }
+         if( hitLeft || hitRight )
+         {
+            current = hitLeft ? node.leftFirst : node.leftFirst + 1;
+            continue;
+         }
+      }
+
+      if( stackSize == 0 )
+         return;
+      current = stack[ --stackSize ];
+   }
+}
+
+inline void findClosest( const Scene& scene, const Ray* rays, Scene::PrimitiveHit* hits )
+{
+   RayPacket packet = loadRays( rays );
+
+   PacketResult result{};
+   result.distance = Float::broadcast( std::numeric_limits<float>::infinity() );
+
+   // Same order as Scene::findClosest
+   const PlaneArrays& planes = scene.getPlanes();
+   uint32_t boundedPlanes = scene.getBoundedPlaneCount();
+   intersectPlanes( planes, boundedPlanes, static_cast<uint32_t>( planes.size() ) - boundedPlanes, packet, result );
+   RAYTRACER_STAT( planeTests, ( planes.size() - boundedPlanes ) * WIDTH );
+
+   traverse( scene.getPlaneBVH(), packet, result, [ & ]( uint32_t first, uint32_t count )
+   {
+      RAYTRACER_STAT( planeTests, count * WIDTH );
+      intersectPlanes( planes, first, count, packet, result );
+   } );
+
+   traverse( scene.getSphereBVH(), packet, result, [ & ]( uint32_t first, uint32_t count )
+   {
+      RAYTRACER_STAT( sphereTests, count * WIDTH );
+      intersectSpheres( scene.getSpheres(), first, count, packet, result );
+   } );
+
+   traverse( scene.getBlockBVH(), packet, result, [ & ]( uint32_t first, uint32_t count )
+   {
+      RAYTRACER_STAT( blockTests, count * WIDTH );
+      intersectBlocks( scene.getBlocks(), first, count, packet, result );
+   } );
+
+   alignas( 32 ) float distances[ WIDTH ];
+   result.distance.store( distances );
+   for( int lane = 0; lane < WIDTH; ++lane )
+   {
+      hits[ lane ] = { distances[ lane ], result.type[ lane ], result.index[ lane ], 0 };
+      // The meshes and instances are traversed ray by ray, the packet only shortens the search
+      if( !scene.getMeshes().empty() )
+         scene.findClosestMesh( rays[ lane ], hits[ lane ] );
+      if( !scene.getInstances().empty() )
+         scene.findClosestInstance( rays[ lane ], hits[ lane ] );
+   }
+}
@@ -0,0 +1,61 @@
+//
+// Created by dominik on 17.10.26.
+//
+
+#include "PacketTracer.h"
+#include "Intersections.h"
+#include "RenderStats.h"
+#include "Simd.h"
+#include <limits>
+
+#if SIMD_X86
+namespace
+{
+   namespace SSE
+   {
+      using Float = Simd::Float4;
+#include "PacketKernels.inl"
+   }
+}
+
+SIMD_AVX2_BEGIN
+namespace
+{
+   namespace AVX2
+   {
+      using Float = Simd::Float8;
+#include "PacketKernels.inl"
+   }
+}
+SIMD_AVX2_END
+#endif
+
+unsigned int PacketTracer::supportedPacketWidth()
+{
+   return Simd::detectWidth();
+}
+
+void PacketTracer::findClosest( const Scene& scene, unsigned int packetWidth, const Ray* rays, Scene::PrimitiveHit* hits )
+{
+#if SIMD_X86
+   // The packet kernels traverse the binary BVHs, the wide BVHs and the grids are traced ray by ray
+   bool usesBVH = scene.getAccelerator() == Scene::Accelerator::BVH;
+   if( usesBVH && packetWidth == 8 && Simd::hasAVX2() )
+   {
+      AVX2::findClosest( scene, rays, hits );
+      return;
+   }
+   if( usesBVH && packetWidth == 4 )
+   {
+      SSE::findClosest( scene, rays, hits );
+      return;
+   }
+#endif
+
+   // No SIMD support or no BVHs, trace the rays one by one
+   for( unsigned int i = 0; i < packetWidth; ++i )
+   {
+      hits[ i ] = {};
+      scene.findClosest( rays[ i ], hits[ i ] );
+   }
+}
@@ -0,0 +1,41 @@
+//
+// Created by dominik on 17.10.26.
+//
+
+#ifndef SEQUENCIAL_PACKETTRACER_H
+#define SEQUENCIAL_PACKETTRACER_H
+
+#include "Objects.h"
+#include "Scene.h"
+
+/**
+ * @brief Packet tracing of coherent rays using SIMD instructions
+ *
+ * A packet is a group of 4 (SSE) or 8 (AVX2) rays which are traced through the scene together. The BVH nodes are visited when any ray of the packet hits them,
+ * and every primitive is tested against all the rays of the packet at once.
+ * This pays off for primary rays, since neighbouring pixels go through the same nodes and hit the same primitives.
+ *
+ * The intersection math is the same as in the scalar Intersection functions, so the packets find the same closest hits as Scene::findClosest
+ */
+class PacketTracer
+{
+   public:
+      static constexpr unsigned int MAX_PACKET_WIDTH = 8;
+
+      /**
+       * @return The widest packet supported by the CPU, detected at runtime using CPUID. 8 with AVX2, 4 with SSE, and 1 if packets aren't supported
+       */
+      static unsigned int supportedPacketWidth();
+
+      /**
+       * @brief Finds the closest primitive for every ray of a packet
+       * @param scene The scene to trace
+       * @param packetWidth 4 or 8. Has to be supported by the CPU
+       * @param rays Array of packetWidth rays
+       * @param hits Out array of packetWidth hits. Use Scene::resolveHit to get the hit points and normals
+       * @note The packets traverse the binary BVHs. The rays of scenes accelerated by wide BVHs or grids are traced one by one
+       */
+      static void findClosest( const Scene& scene, unsigned int packetWidth, const Ray* rays, Scene::PrimitiveHit* hits );
+};
+
+#endif //SEQUENCIAL_PACKETTRACER_H
@@ -0,0 +1,215 @@
+//
+// Created by dominik on 18.10.26.
+//
+
+#include "PngWriter.h"
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <stdexcept>
+
+namespace
+{
+   constexpr auto CRC_TABLE = []()
+   {
+      std::array<uint32_t, 256> table{};
+      for( uint32_t i = 0; i < table.size(); ++i )
+      {
+         uint32_t crc = i;
+         for( int bit = 0; bit < 8; ++bit )
+            crc = ( crc & 1u ) ? 0xEDB88320u ^ ( crc >> 1 ) : crc >> 1;
+         table[ i ] = crc;
+      }
+      return table;
+   }();
+
+   uint32_t updateCrc( uint32_t crc, const unsigned char* data, size_t size )
+   {
+      for( size_t i = 0; i < size; ++i )
+         crc = CRC_TABLE[ ( crc ^ data[ i ] ) & 0xFFu ] ^ ( crc >> 8 );
+      return crc;
+   }
+
+   void appendBigEndian( std::vector<unsigned char>& data, uint32_t value )
+   {
+      for( int shift = 24; shift >= 0; shift -= 8 )
+         data.push_back( static_cast<unsigned char>( value >> shift ) );
+   }
+
+   unsigned char paethPredictor( int a, int b, int c )
+   {
+      int p = a + b - c;
+      int pa = std::abs( p - a );
+      int pb = std::abs( p - b );
+      int pc = std::abs( p - c );
+      if( pa <= pb && pa <= pc )
+         return static_cast<unsigned char>( a );
+      return static_cast<unsigned char>( pb <= pc ? b : c );
+   }
+}
+
+PngWriter::PngWriter( const std::string& path, unsigned int width, unsigned int height, CompressionLevel level, unsigned int threadCount )
+   : PngWriter( path, width, height, level, std::make_unique<ThreadPool>( threadCount ), nullptr )
+{
+}
+
+PngWriter::PngWriter( const std::string& path, unsigned int width, unsigned int height, CompressionLevel level, ThreadPool& pool )
+   : PngWriter( path, width, height, level, nullptr, &pool )
+{
+}
+
+PngWriter::PngWriter( const std::string& path, unsigned int width, unsigned int height, CompressionLevel level,
+                      std::unique_ptr<ThreadPool> ownPool, ThreadPool* pool )
+   : ImageWriter( path, width, height ), level( level ), previousRow( static_cast<size_t>( width ) * RGBABytes, 0 ),
+     filteredRow( previousRow.size() + 1 ), bestRow( previousRow.size() + 1 ), ownPool( std::move( ownPool ) ),
+     pool( pool != nullptr ? pool : this->ownPool.get() ), chunks( this->pool->getThreadCount() ),
+     compressedChunks( chunks.size() ), chunkAdlers( chunks.size() )
+{
+   static constexpr unsigned char signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+   file.write( reinterpret_cast<const char*>( signature ), sizeof( signature ) );
+
+   std::vector<unsigned char> header;
+   appendBigEndian( header, width );
+   appendBigEndian( header, height );
+   // 8 bits per channel, RGBA, deflate, adaptive filtering, no interlacing
+   header.insert( header.end(), { 8, 6, 0, 0, 0 } );
+   writeChunk( "IHDR", header.data(), header.size() );
+}
+
+void PngWriter::writeRow( const unsigned char* pixels )
+{
+   nextRow();
+
+   size_t rowBytes = previousRow.size();
+   const unsigned char* above = previousRow.data();
+   uint64_t bestSum = UINT64_MAX;
+
+   for( unsigned char filter = 0; filter < 5; ++filter )
+   {
+      filteredRow[ 0 ] = filter;
+      unsigned char* filtered = filteredRow.data() + 1;
+      for( size_t i = 0; i < rowBytes; ++i )
+      {
+         // The bytes of the pixel to the left, above, and above-left
+         int left = i >= RGBABytes ? pixels[ i - RGBABytes ] : 0;
+         int up = above[ i ];
+         int upLeft = i >= RGBABytes ? above[ i - RGBABytes ] : 0;
+
+         unsigned char prediction = 0;
+         switch( filter )
+         {
+            case 1:
+               prediction = static_cast<unsigned char>( left );
+               break;
+            case 2:
+               prediction = static_cast<unsigned char>( up );
+               break;
+            case 3:
+               prediction = static_cast<unsigned char>( ( left + up ) / 2 );
+               break;
+            case 4:
+               prediction = paethPredictor( left, up, upLeft );
+               break;
+            default:
+               break;
+         }
+         filtered[ i ] = static_cast<unsigned char>( pixels[ i ] - prediction );
+      }
+
+      // Small differences in both directions compress the best. Unfiltered bytes aren't differences, so they are summed as they are
+      uint64_t sum = 0;
+      for( size_t i = 0; i < rowBytes; ++i )
+         sum += filter == 0 ? filtered[ i ] : static_cast<uint64_t>( std::abs( static_cast<signed char>( filtered[ i ] ) ) );
+      if( sum < bestSum )
+      {
+         bestSum = sum;
+         std::swap( bestRow, filteredRow );
+      }
+   }
+
+   // A row isn't split between chunks, so a chunk is full once it reaches CHUNK_SIZE
+   auto& chunk = chunks[ filledChunks ];
+   chunk.insert( chunk.end(), bestRow.begin(), bestRow.end() );
+   if( chunk.size() >= CHUNK_SIZE && ++filledChunks == chunks.size() )
+      compressChunks( false );
+
+   std::copy( pixels, pixels + rowBytes, previousRow.begin() );
+}
+
+void PngWriter::finish()
+{
+   checkAllRowsWritten();
+
+   compressChunks( true );
+   writeChunk( "IEND", nullptr, 0 );
+   closeFile();
+}
+
+void PngWriter::writeChunk( const char* type, const unsigned char* data, size_t size )
+{
+   std::vector<unsigned char> length;
+   appendBigEndian( length, static_cast<uint32_t>( size ) );
+   file.write( reinterpret_cast<const char*>( length.data() ), 4 );
+   file.write( type, 4 );
+   if( size > 0 )
+      file.write( reinterpret_cast<const char*>( data ), static_cast<std::streamsize>( size ) );
+
+   // The CRC covers the chunk type and data
+   uint32_t crc = updateCrc( 0xFFFFFFFFu, reinterpret_cast<const unsigned char*>( type ), 4 );
+   crc = updateCrc( crc, data, size ) ^ 0xFFFFFFFFu;
+   std::vector<unsigned char> crcBytes;
+   appendBigEndian( crcBytes, crc );
+   file.write( reinterpret_cast<const char*>( crcBytes.data() ), 4 );
+}
+
+void PngWriter::compressChunks( bool last )
+{
+   // The chunk being filled is compressed too when it's the last one. The stream is ended by the last chunk, even an empty one
+   size_t chunkCount = filledChunks;
+   if( last && ( filledChunks == 0 || !chunks[ filledChunks ].empty() ) )
+      ++chunkCount;
+
+   pool->parallelFor( chunkCount, [ & ]( size_t i )
+   {
+      DeflateStream stream( level, DeflateStream::Format::RAW );
+      if( i == 0 )
+         stream.setDictionary( dictionary.data(), dictionary.size() );
+      else
+         stream.setDictionary( chunks[ i - 1 ].data(), chunks[ i - 1 ].size() );
+
+      stream.write( chunks[ i ].data(), chunks[ i ].size() );
+      if( last && i + 1 == chunkCount )
+         stream.finish();
+      else
+         stream.flush();
+
+      compressedChunks[ i ] = stream.getOutput();
+      chunkAdlers[ i ] = stream.getAdler();
+   } );
+
+   // One IDAT chunk per compressed chunk, so the file doesn't depend on how many chunks are compressed at once
+   for( size_t i = 0; i < chunkCount; ++i )
+   {
+      std::vector<unsigned char> data;
+      if( !headerWritten )
+      {
+         // zlib header: deflate with a 32 KB window, default compression
+         data.insert( data.end(), { 0x78, 0x9C } );
+         headerWritten = true;
+      }
+      data.insert( data.end(), compressedChunks[ i ].begin(), compressedChunks[ i ].end() );
+      adler = DeflateStream::combineAdler( adler, chunkAdlers[ i ], chunks[ i ].size() );
+      if( last && i + 1 == chunkCount )
+         appendBigEndian( data, adler );
+      writeChunk( "IDAT", data.data(), data.size() );
+   }
+
+   if( chunkCount > 0 )
+   {
+      const auto& lastChunk = chunks[ chunkCount - 1 ];
+      dictionary.assign( lastChunk.end() - static_cast<std::ptrdiff_t>( std::min( lastChunk.size(), DICTIONARY_SIZE ) ), lastChunk.end() );
+   }
+   for( size_t i = 0; i < chunkCount; ++i )
+      chunks[ i ].clear();
+   filledChunks = 0;
+}
@@ -0,0 +1,93 @@
+//
+// Created by dominik on 18.10.26.
+//
+
+#ifndef SEQUENCIAL_PNGWRITER_H
+#define SEQUENCIAL_PNGWRITER_H
+
+#include "Deflate.h"
+#include "ImageWriter.h"
+#include "ThreadPool.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Writes an 8-bit RGBA PNG file row by row
+ *
+ * The rows are filtered as they come, so only the previous row and a few chunks of filtered data are kept in memory instead of the whole image.
+ * Every row uses the filter with the minimum sum of absolute differences, the same heuristic as the default of lodepng.
+ *
+ * The filtered data is compressed in parallel the same way pigz does it: it's split into chunks of CHUNK_SIZE bytes, and once there is a chunk for every thread,
+ * they are compressed as independent raw deflate streams (see DeflateStream). The compressed chunks are joined into one zlib stream and written to the file in IDAT chunks.
+ * The chunks are split by size, so the file doesn't depend on the thread count
+ */
+class PngWriter : public ImageWriter
+{
+   public:
+      /**
+       * @brief Opens the file and writes the PNG header
+       * @param path Path of the file
+       * @param width Width of the image in pixels
+       * @param height Height of the image in pixels
+       * @param level Compression level of the image data
+       * @param threadCount Number of threads compressing the data. 0 means one thread per hardware thread
+       * @throws std::runtime_error If the file can't be opened
+       */
+      PngWriter( const std::string& path, unsigned int width, unsigned int height, CompressionLevel level = CompressionLevel::BALANCED,
+                 unsigned int threadCount = 0 );
+
+      /**
+       * @brief Opens the file and writes the PNG header. The data is compressed on a pool shared with other work, which has to outlive the writer
+       */
+      PngWriter( const std::string& path, unsigned int width, unsigned int height, CompressionLevel level, ThreadPool& pool );
+
+      /**
+       * @brief Adds the next row of the image, from the top
+       * @param pixels width RGBA pixels, 4 bytes each
+       */
+      void writeRow( const unsigned char* pixels ) override;
+
+      /**
+       * @brief Writes the rest of the compressed data and closes the file. Has to be called after all the rows are written
+       * @throws std::runtime_error If not all the rows were written or the file couldn't be written
+       */
+      void finish() override;
+
+   private:
+      static constexpr int RGBABytes = 4;
+      // Size of the filtered data compressed by one thread at once. Big enough that the restarted compression of every chunk costs almost nothing
+      static constexpr size_t CHUNK_SIZE = 1 << 18;
+      // The deflate window. Every chunk can refer to this much of the data before it
+      static constexpr size_t DICTIONARY_SIZE = 1 << 15;
+
+      PngWriter( const std::string& path, unsigned int width, unsigned int height, CompressionLevel level, std::unique_ptr<ThreadPool> ownPool,
+                 ThreadPool* pool );
+
+      void writeChunk( const char* type, const unsigned char* data, size_t size );
+
+      // Compresses the filled chunks in parallel and writes them to the file. The last chunk ends the zlib stream
+      void compressChunks( bool last );
+
+      CompressionLevel level;
+      // Row of the previous pixels (zeros before the first row), needed by the Up, Average, and Paeth filters
+      std::vector<unsigned char> previousRow;
+      // The filter type byte followed by the filtered row
+      std::vector<unsigned char> filteredRow;
+      std::vector<unsigned char> bestRow;
+
+      // Null if the pool is shared
+      std::unique_ptr<ThreadPool> ownPool;
+      ThreadPool* pool;
+      // One chunk of the filtered data per thread. The chunks before filledChunks are full
+      std::vector<std::vector<unsigned char>> chunks;
+      size_t filledChunks = 0;
+      std::vector<std::vector<unsigned char>> compressedChunks;
+      std::vector<uint32_t> chunkAdlers;
+      // End of the previously compressed data, used as the dictionary of the next chunk
+      std::vector<unsigned char> dictionary;
+      uint32_t adler = 1;
+      bool headerWritten = false;
+};
+
+#endif //SEQUENCIAL_PNGWRITER_H
@@ -0,0 +1,319 @@
+//
+// Created by dominik on 18.10.26.
+//
+
+#include "ProceduralLevel.h"
+#include <charconv>
+#include <cmath>
+#include <numbers>
+#include <random>
+#include <stdexcept>
+#include <string_view>
+
+namespace
+{
+   /**
+    * @brief Seeded random numbers. The standard distributions are implementation defined,
+    * so the numbers are derived from the raw mt19937_64 output to get the same scene with every standard library
+    */
+   class Random
+   {
+      public:
+         explicit Random( uint64_t seed ) : engine( seed )
+         {
+         }
+
+         // Uniform in [min, max)
+         float uniform( float min, float max )
+         {
+            return min + ( max - min ) * static_cast<float>( engine() >> 40 ) * 0x1p-24f;
+         }
+
+         // Uniform in [0, count)
+         uint64_t index( uint64_t count )
+         {
+            return static_cast<uint64_t>( static_cast<double>( engine() >> 11 ) * 0x1p-53 * static_cast<double>( count ) );
+         }
+
+         // The components are generated in order, the evaluation order of function arguments is unspecified
+         Vector3f uniformVector( float min, float max )
+         {
+            float x = uniform( min, max );
+            float y = uniform( min, max );
+            return { x, y, uniform( min, max ) };
+         }
+
+         Color uniformColor( float min, float max )
+         {
+            float r = uniform( min, max );
+            float g = uniform( min, max );
+            return { r, g, uniform( min, max ) };
+         }
+
+         Vector3f normalVector()
+         {
+            float x = normal();
+            float y = normal();
+            return { x, y, normal() };
+         }
+
+         // Standard normal distribution (Box-Muller)
+         float normal()
+         {
+            float u = 1.f - uniform( 0.f, 1.f );
+            float v = uniform( 0.f, 1.f );
+            return std::sqrt( -2.f * std::log( u ) ) * std::cos( 2.f * std::numbers::pi_v<float> * v );
+         }
+
+      private:
+         std::mt19937_64 engine;
+   };
+
+   // Parses a count with an optional k or M suffix
+   uint64_t parseCount( std::string_view key, std::string_view value )
+   {
+      uint64_t multiplier = 1;
+      if( value.ends_with( 'k' ) )
+         multiplier = 1000;
+      else if( value.ends_with( 'M' ) )
+         multiplier = 1000000;
+      if( multiplier != 1 )
+         value.remove_suffix( 1 );
+
+      uint64_t count = 0;
+      auto result = std::from_chars( value.data(), value.data() + value.size(), count );
+      // A count overflowing with its suffix would wrap around and get past the range checks
+      if( result.ec != std::errc() || result.ptr != value.data() + value.size() || count > UINT64_MAX / multiplier )
+         throw std::runtime_error( "Invalid value of " + std::string( key ) + ": " + std::string( value ) );
+      return count * multiplier;
+   }
+
+   constexpr std::pair<std::string_view, ProceduralLevel::Layout> LAYOUTS[] = {
+      { "grid", ProceduralLevel::Layout::GRID },
+      { "clusters", ProceduralLevel::Layout::CLUSTERS },
+      { "overlap", ProceduralLevel::Layout::OVERLAP }
+   };
+}
+
+ProceduralLevel::ProceduralLevel( const Settings& settings ) : settings( settings )
+{
+}
+
+ProceduralLevel::Settings ProceduralLevel::parseSettings( const std::string& specification )
+{
+   Settings settings;
+   std::string_view rest = specification;
+   size_t separator = rest.find( ':' );
+   std::string_view layout = rest.substr( 0, separator );
+
+   bool found = false;
+   for( const auto& [ name, value ]: LAYOUTS )
+   {
+      if( layout == name )
+      {
+         settings.layout = value;
+         found = true;
+      }
+   }
+   if( !found )
+      throw std::runtime_error( "Unknown layout " + std::string( layout ) + ", use grid, clusters, or overlap" );
+
+   while( separator != std::string_view::npos )
+   {
+      rest.remove_prefix( separator + 1 );
+      separator = rest.find( ':' );
+      std::string_view option = rest.substr( 0, separator );
+      size_t equals = option.find( '=' );
+      if( equals == std::string_view::npos )
+         throw std::runtime_error( "Expected key=value, got " + std::string( option ) );
+
+      std::string_view key = option.substr( 0, equals );
+      uint64_t value = parseCount( key, option.substr( equals + 1 ) );
+      if( key == "spheres" )
+         settings.sphereCount = value;
+      else if( key == "blocks" )
+         settings.blockCount = value;
+      else if( key == "lights" )
+         settings.lightCount = static_cast<unsigned int>( value );
+      else if( key == "seed" )
+         settings.seed = value;
+      else if( key == "width" )
+         settings.imageWidth = static_cast<unsigned int>( value );
+      else if( key == "height" )
+         settings.imageHeight = static_cast<unsigned int>( value );
+      else
+         throw std::runtime_error( "Unknown key " + std::string( key ) + ", use spheres, blocks, lights, seed, width, or height" );
+   }
+
+   if( settings.imageWidth == 0 || settings.imageHeight == 0 )
+      throw std::runtime_error( "The image size can't be 0" );
+   if( settings.sphereCount + settings.blockCount > UINT32_MAX )
+      throw std::runtime_error( "Too many primitives" );
+   return settings;
+}
+
+bool ProceduralLevel::isSpecification( const std::string& specification )
+{
+   std::string_view layout = std::string_view( specification ).substr( 0, specification.find( ':' ) );
+   for( const auto& entry: LAYOUTS )
+   {
+      if( layout == entry.first )
+         return true;
+   }
+   return false;
+}
+
+void ProceduralLevel::loadLevel( TracerOptions& options, std::vector<std::shared_ptr<SceneObject>>& objects, std::vector<Light>& lights )
+{
+   std::vector<Material> palette;
+   objects.reserve( settings.sphereCount + settings.blockCount + 1 );
+   generate( options, lights, [ & ]( const std::vector<Material>& materials )
+   {
+      palette = materials;
+   }, [ & ]( const Vector3f& center, float radius, int material )
+   {
+      objects.emplace_back( std::make_shared<Sphere>( center, palette[ material ], radius ) );
+   }, [ & ]( const Vector3f& center, const Vector3f& extents, int material )
+   {
+      objects.emplace_back( std::make_shared<Block>( center, palette[ material ], extents ) );
+   } );
+   objects.emplace_back( std::make_shared<Plane>( createFloor() ) );
+}
+
+Scene ProceduralLevel::loadScene( TracerOptions& options, std::vector<Light>& lights )
+{
+   // The primitives reference the palette materials by index instead of every object having its own copy
+   Scene scene;
+   generate( options, lights, [ & ]( const std::vector<Material>& materials )
+   {
+      for( const auto& material: materials )
+         scene.addMaterial( material );
+   }, [ & ]( const Vector3f& center, float radius, int material )
+   {
+      scene.addSphere( center, radius, static_cast<uint32_t>( material ) );
+   }, [ & ]( const Vector3f& center, const Vector3f& extents, int material )
+   {
+      scene.addBlock( center - extents, center + extents, static_cast<uint32_t>( material ) );
+   } );
+   createFloor().addToScene( scene );
+   scene.build();
+   return scene;
+}
+
+template<typename PaletteFunction, typename SphereFunction, typename BlockFunction>
+void ProceduralLevel::generate( TracerOptions& options, std::vector<Light>& lights, PaletteFunction&& paletteFunction,
+                                SphereFunction&& sphere, BlockFunction&& block ) const
+{
+   options.fieldOfView = 90;
+   options.cameraDistance = 50;
+   options.imageWidth = settings.imageWidth;
+   options.imageHeight = settings.imageHeight;
+   options.backgroundColor = Color( 0.01f, 0.01f, 0.01f );
+   options.ambientLightColor = Color( 0.1f, 0.1f, 0.1f );
+
+   Random random( settings.seed );
+
+   static constexpr float SHININESS[] = { 16.f, 32.f, 64.f, 128.f };
+   std::vector<Material> palette;
+   for( int i = 0; i < PALETTE_SIZE; ++i )
+   {
+      Color color = random.uniformColor( 0.1f, 1.f );
+      float specular = random.uniform( 0.2f, 0.7f );
+      float diffuse = random.uniform( 0.3f, 0.7f );
+      float shininess = SHININESS[ random.index( 4 ) ];
+      // A quarter of the materials is reflective, so the secondary rays scale with the scene too
+      float reflectivity = i % 4 == 0 ? random.uniform( 0.2f, 0.5f ) : 0.f;
+      palette.emplace_back( color, specular, diffuse, shininess, reflectivity, 0.f );
+   }
+   paletteFunction( palette );
+
+   // The total light power doesn't depend on the number of lights
+   float intensity = TOTAL_LIGHT_POWER / static_cast<float>( std::max( 1u, settings.lightCount ) );
+   for( unsigned int i = 0; i < settings.lightCount; ++i )
+   {
+      float x = random.uniform( -BOX_HALF_SIZE, BOX_HALF_SIZE );
+      float y = random.uniform( 150.f, 250.f );
+      Vector3f position( x, y, random.uniform( 0.f, BOX_CENTER_Z + BOX_HALF_SIZE ) );
+      Color color = random.uniformColor( 0.8f, 1.f );
+      lights.emplace_back( position, color, intensity );
+   }
+
+   uint64_t total = settings.sphereCount + settings.blockCount;
+   if( total == 0 )
+      return;
+
+   const Vector3f boxCenter( 0.f, 0.f, BOX_CENTER_Z );
+   const Vector3f boxMin = boxCenter - Vector3f( BOX_HALF_SIZE, BOX_HALF_SIZE, BOX_HALF_SIZE );
+   // Spheres and blocks are mixed by selection sampling: the next primitive is a sphere with probability remaining spheres / remaining primitives
+   uint64_t remainingSpheres = settings.sphereCount;
+   auto emit = [ & ]( uint64_t i, const Vector3f& center, float size )
+   {
+      int material = static_cast<int>( random.index( PALETTE_SIZE ) );
+      if( random.index( total - i ) < remainingSpheres )
+      {
+         --remainingSpheres;
+         sphere( center, size, material );
+      }
+      else
+      {
+         block( center, random.uniformVector( 0.6f, 1.f ) * size, material );
+      }
+   };
+
+   switch( settings.layout )
+   {
+      case Layout::GRID:
+      {
+         auto side = static_cast<uint64_t>( std::ceil( std::cbrt( static_cast<double>( total ) ) ) );
+         while( side * side * side < total )
+            ++side;
+         float spacing = 2.f * BOX_HALF_SIZE / static_cast<float>( side );
+         for( uint64_t i = 0; i < total; ++i )
+         {
+            Vector3f cell( static_cast<float>( i % side ), static_cast<float>( i / side % side ), static_cast<float>( i / ( side * side ) ) );
+            Vector3f jitter = random.uniformVector( -0.15f, 0.15f );
+            float size = spacing * random.uniform( 0.2f, 0.35f );
+            emit( i, boxMin + ( cell + Vector3f( 0.5f, 0.5f, 0.5f ) + jitter ) * spacing, size );
+         }
+         break;
+      }
+      case Layout::CLUSTERS:
+      {
+         // Total^(1/3) clusters, each with about total^(2/3) primitives
+         auto clusterCount = std::max<uint64_t>( 1, static_cast<uint64_t>( std::cbrt( static_cast<double>( total ) ) ) );
+         std::vector<Vector3f> clusters;
+         for( uint64_t i = 0; i < clusterCount; ++i )
+            clusters.emplace_back( boxCenter + random.uniformVector( -0.8f, 0.8f ) * BOX_HALF_SIZE );
+
+         float sigma = 0.3f * BOX_HALF_SIZE / std::cbrt( static_cast<float>( clusterCount ) );
+         // Typical distance of neighbours in a cluster
+         float spacing = 2.f * sigma / std::cbrt( static_cast<float>( total ) / static_cast<float>( clusterCount ) );
+         for( uint64_t i = 0; i < total; ++i )
+         {
+            const Vector3f& cluster = clusters[ random.index( clusterCount ) ];
+            Vector3f offset = random.normalVector();
+            float size = spacing * random.uniform( 0.2f, 0.5f );
+            emit( i, cluster + offset * sigma, size );
+         }
+         break;
+      }
+      case Layout::OVERLAP:
+      {
+         // Every primitive is larger than the region of the centers, so all of them overlap each other
+         float region = 0.3f * BOX_HALF_SIZE;
+         for( uint64_t i = 0; i < total; ++i )
+         {
+            Vector3f center = boxCenter + random.uniformVector( -1.f, 1.f ) * region;
+            float size = random.uniform( 0.3f, 1.f ) * region;
+            emit( i, center, size );
+         }
+         break;
+      }
+   }
+}
+
+Plane ProceduralLevel::createFloor()
+{
+   Material floor( Color( 0.6f, 0.6f, 0.6f ), 0.1f, 0.8f, 16.f );
+   return { Vector3f( 0.f, -BOX_HALF_SIZE - 10.f, BOX_CENTER_Z ), floor, Vector3f( 0.f, 1.f, 0.f ), Plane::UNBOUNDED, Plane::UNBOUNDED };
+}
@@ -0,0 +1,90 @@
+//
+// Created by dominik on 18.10.26.
+//
+
+#ifndef SEQUENCIAL_PROCEDURALLEVEL_H
+#define SEQUENCIAL_PROCEDURALLEVEL_H
+
+#include "Levels.h"
+#include <cstdint>
+#include <string>
+
+/**
+ * @brief Randomly generated level with a configurable number of primitives, for testing how the ray tracer scales with the scene size
+ *
+ * The primitives fill a 200 x 200 x 200 box in front of the camera standing on an infinite floor, lit by lights above the box.
+ * The same settings (including the seed) always generate the same scene, on any platform.
+ * The materials are taken from a small palette, so the scene size is dominated by the primitives
+ */
+class ProceduralLevel : public Level
+{
+   public:
+      enum class Layout
+      {
+         // Primitives on a jittered regular grid, evenly spread over the box
+         GRID,
+         // Primitives in dense normally distributed clusters with empty space around them
+         CLUSTERS,
+         // Large primitives all overlapping around the box center. The worst case for the BVH
+         OVERLAP
+      };
+
+      struct Settings
+      {
+         Layout layout = Layout::GRID;
+         uint64_t sphereCount = 1000;
+         uint64_t blockCount = 0;
+         unsigned int lightCount = 2;
+         uint64_t seed = 1;
+         unsigned int imageWidth = 1280;
+         unsigned int imageHeight = 720;
+      };
+
+      explicit ProceduralLevel( const Settings& settings );
+
+      /**
+       * @brief Parses the settings from a specification "layout[:key=value]...", e.g. "grid:spheres=1M:blocks=10k:lights=4:seed=7"
+       *
+       * The layout is grid, clusters, or overlap. The keys are spheres, blocks, lights, seed, width, and height.
+       * The counts can have a k (thousand) or M (million) suffix
+       * @throws std::runtime_error If the specification is invalid
+       */
+      static Settings parseSettings( const std::string& specification );
+
+      /**
+       * @return True if the string starts with a layout name, so it's meant to be a procedural level specification
+       */
+      static bool isSpecification( const std::string& specification );
+
+      void loadLevel( TracerOptions& options, std::vector<std::shared_ptr<SceneObject>>& objects, std::vector<Light>& lights ) override;
+
+      /**
+       * @brief Generates the primitives straight into the scene arrays, without the intermediate scene objects.
+       * Used for the large scenes, where the objects would take most of the memory
+       */
+      Scene loadScene( TracerOptions& options, std::vector<Light>& lights ) override;
+
+   private:
+      static constexpr int PALETTE_SIZE = 16;
+      // Half of the edge of the box with the primitives and its center on the z-axis
+      static constexpr float BOX_HALF_SIZE = 100.f;
+      static constexpr float BOX_CENTER_Z = 250.f;
+      // Split evenly among the lights, so a light sweep changes the shadows, not the brightness
+      static constexpr float TOTAL_LIGHT_POWER = 10.f;
+
+      /**
+       * @brief Generates the level and passes the materials and every primitive to the callbacks.
+       * The callbacks are paletteFunction( materials ), called once before the primitives,
+       * sphere( center, radius, paletteIndex ), and block( center, extents, paletteIndex )
+       */
+      template<typename PaletteFunction, typename SphereFunction, typename BlockFunction>
+      void generate( TracerOptions& options, std::vector<Light>& lights, PaletteFunction&& paletteFunction, SphereFunction&& sphere,
+                     BlockFunction&& block ) const;
+
+      // Infinite floor below the box
+      [[nodiscard]] static Plane createFloor();
+
+      Settings settings;
+};
+
+#endif //SEQUENCIAL_PROCEDURALLEVEL_H
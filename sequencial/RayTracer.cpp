@@ -3,55 +3,204 @@
 //
 #include "RayTracer.h"
 #include "Math.h"
+#include "PacketTracer.h"
+#include <mutex>
 
 Pixels RayTracer::generateImage( const TracerOptions& options, const std::vector<std::shared_ptr<SceneObject>>& objects,
-                                 const std::vector<Light>& lights )
+                                 const std::vector<Light>& lights, RenderStats* stats )
 {
-   float clampedFOV = std::clamp( options.fieldOfView, 0.0f, MAX_FOV );
-   auto viewport = calculateViewport( {
-      options.cameraDistance, clampedFOV, options.maxRecursionDepth, options.imageWidth, options.imageHeight,
-      options.backgroundColor, options.ambientLightColor
-   } );
+   return generateImage( options, Scene( objects ), lights, stats );
+}
 
-   Pixels pixels;
-   pixels.reserve( options.imageWidth * options.imageHeight );
+RawPixels RayTracer::generateRawImage( const TracerOptions& options, const std::vector<std::shared_ptr<SceneObject>>& objects,
+                                       const std::vector<Light>& lights, RenderStats* stats )
+{
+   return generateRawImage( options, Scene( objects ), lights, stats );
+}
 
-   for( auto i = 0u; i < options.imageHeight; ++i )
+Pixels RayTracer::generateImage( const TracerOptions& options, const Scene& scene, const std::vector<Light>& lights,
+                                 RenderStats* stats )
+{
+   Pixels pixels( options.imageWidth * options.imageHeight );
+   ThreadPool pool( options.threadCount );
+
+   renderTiles( options, scene, lights, pool, 0, options.imageHeight, [ & ]( unsigned int pixelX, unsigned int pixelY, const Color& color )
    {
-      for( auto j = 0u; j < options.imageWidth; ++j )
-      {
-         auto ray = generateRayForPixel( options, viewport, j, i );
-         pixels.emplace_back( getRayTracedColor( options, ray, objects, lights ) );
-      }
-   }
+      pixels[ pixelY * options.imageWidth + pixelX ] = color;
+   }, stats );
 
    return pixels;
 }
 
-RawPixels RayTracer::generateRawImage( const TracerOptions& options, const std::vector<std::shared_ptr<SceneObject>>& objects,
-                                       const std::vector<Light>& lights )
+RawPixels RayTracer::generateRawImage( const TracerOptions& options, const Scene& scene, const std::vector<Light>& lights,
+                                       RenderStats* stats )
 {
-   float clampedFOV = std::clamp( options.fieldOfView, 0.0f, MAX_FOV );
-   auto viewport = calculateViewport( {
-      options.cameraDistance, clampedFOV, options.maxRecursionDepth, options.imageWidth, options.imageHeight,
-      options.backgroundColor, options.ambientLightColor
-   } );
-
    RawPixels pixels( options.imageWidth * options.imageHeight * RGBABytes );
+   ToneMapper toneMapper( options.exposure, options.gamma );
+   ThreadPool pool( options.threadCount );
 
-   for( auto i = 0u; i < options.imageHeight; ++i )
+   // Every pixel only writes its own bytes, so the tiles don't need any synchronization
+   renderTiles( options, scene, lights, pool, 0, options.imageHeight, [ & ]( unsigned int pixelX, unsigned int pixelY, const Color& color )
    {
-      for( auto j = 0u; j < options.imageWidth; ++j )
+      addColorToRawPixels( pixels, toneMapper, color, ( pixelY * options.imageWidth + pixelX ) * RGBABytes );
+   }, stats );
+
+   return pixels;
+}
+
+void RayTracer::generateRawRows( const TracerOptions& options, const std::vector<std::shared_ptr<SceneObject>>& objects,
+                                 const std::vector<Light>& lights, const RowFunction& rowFunction, RenderStats* stats )
+{
+   generateRawRows( options, Scene( objects ), lights, rowFunction, stats );
+}
+
+void RayTracer::generateRawRows( const TracerOptions& options, const Scene& scene, const std::vector<Light>& lights,
+                                 const RowFunction& rowFunction, RenderStats* stats, ThreadPool* pool )
+{
+   ToneMapper toneMapper( options.exposure, options.gamma );
+
+   renderRows<unsigned char>( options, scene, lights, RGBABytes, [ & ]( RawPixels& band, size_t index, const Color& color )
+   {
+      addColorToRawPixels( band, toneMapper, color, index );
+   }, rowFunction, stats, pool );
+}
+
+void RayTracer::generateRows( const TracerOptions& options, const std::vector<std::shared_ptr<SceneObject>>& objects,
+                              const std::vector<Light>& lights, const ColorRowFunction& rowFunction, RenderStats* stats )
+{
+   generateRows( options, Scene( objects ), lights, rowFunction, stats );
+}
+
+void RayTracer::generateRows( const TracerOptions& options, const Scene& scene, const std::vector<Light>& lights,
+                              const ColorRowFunction& rowFunction, RenderStats* stats, ThreadPool* pool )
+{
+   renderRows<Color>( options, scene, lights, 1, []( Pixels& band, size_t index, const Color& color )
+   {
+      band[ index ] = color;
+   }, rowFunction, stats, pool );
+}
+
+template<typename Element, typename StoreFunction>
+void RayTracer::renderRows( const TracerOptions& options, const Scene& scene, const std::vector<Light>& lights, size_t elementsPerPixel,
+                            StoreFunction&& storePixel, const std::function<void( unsigned int, const Element* )>& rowFunction,
+                            RenderStats* stats, ThreadPool* pool )
+{
+   unsigned int bandHeight = std::max( 1u, options.tileSize );
+   unsigned int bandCount = ( options.imageHeight + bandHeight - 1 ) / bandHeight;
+   size_t rowElements = static_cast<size_t>( options.imageWidth ) * elementsPerPixel;
+   std::unique_ptr<ThreadPool> ownPool;
+   if( pool == nullptr )
+   {
+      ownPool = std::make_unique<ThreadPool>( options.threadCount );
+      pool = ownPool.get();
+   }
+
+   // A ring of two bands, band i is stored in bands[ i % 2 ]
+   std::vector<Element> bands[ 2 ] = { std::vector<Element>( rowElements * bandHeight ), std::vector<Element>( rowElements * bandHeight ) };
+   auto passRows = [ & ]( unsigned int band )
+   {
+      unsigned int firstRow = band * bandHeight;
+      unsigned int endRow = std::min( firstRow + bandHeight, options.imageHeight );
+      for( auto row = firstRow; row < endRow; ++row )
+         rowFunction( row, bands[ band % 2 ].data() + ( row - firstRow ) * rowElements );
+   };
+
+   for( unsigned int band = 0; band < bandCount; ++band )
+   {
+      // The calling thread passes the rows of the previous band to rowFunction while the pool renders this one,
+      // so no other thread is started and a pool of 1 thread renders everything on the calling thread
+      std::function<void()> passPreviousRows;
+      if( band > 0 )
+         passPreviousRows = [ & ] { passRows( band - 1 ); };
+
+      auto& pixels = bands[ band % 2 ];
+      unsigned int firstRow = band * bandHeight;
+      renderTiles( options, scene, lights, *pool, firstRow, std::min( firstRow + bandHeight, options.imageHeight ),
+                   [ & ]( unsigned int pixelX, unsigned int pixelY, const Color& color )
+                   {
+                      storePixel( pixels, ( pixelY - firstRow ) * rowElements + pixelX * elementsPerPixel, color );
+                   }, stats, passPreviousRows );
+   }
+   if( bandCount > 0 )
+      passRows( bandCount - 1 );
+}
+
+TracerOptions RayTracer::clampedOptions( const TracerOptions& options )
+{
+   TracerOptions clamped = options;
+   clamped.fieldOfView = std::clamp( options.fieldOfView, 0.0f, MAX_FOV );
+   return clamped;
+}
+
+template<typename ColorFunction>
+void RayTracer::renderTiles( const TracerOptions& options, const Scene& scene, const std::vector<Light>& lights, ThreadPool& pool,
+                             unsigned int firstRow, unsigned int endRow, ColorFunction&& colorFunction, RenderStats* stats,
+                             const std::function<void()>& callerTask )
+{
+   auto viewport = calculateViewport( clampedOptions( options ) );
+   unsigned int packetWidth = options.packetTracing ? PacketTracer::supportedPacketWidth() : 1u;
+   unsigned int tileSize = std::max( 1u, options.tileSize );
+   unsigned int tilesX = ( options.imageWidth + tileSize - 1 ) / tileSize;
+   unsigned int tilesY = ( endRow - firstRow + tileSize - 1 ) / tileSize;
+
+   std::mutex statsMutex;
+
+   pool.parallelFor( static_cast<size_t>( tilesX ) * tilesY, [ & ]( size_t tile )
+   {
+      unsigned int startX = static_cast<unsigned int>( tile % tilesX ) * tileSize;
+      unsigned int startY = firstRow + static_cast<unsigned int>( tile / tilesX ) * tileSize;
+      unsigned int endX = std::min( startX + tileSize, options.imageWidth );
+      unsigned int endY = std::min( startY + tileSize, endRow );
+
+      Ray rays[ PacketTracer::MAX_PACKET_WIDTH ];
+      Scene::PrimitiveHit hits[ PacketTracer::MAX_PACKET_WIDTH ];
+      RenderStats tileStats;
+      tileStats.primary = static_cast<uint64_t>( endX - startX ) * ( endY - startY );
+
+      for( auto i = startY; i < endY; ++i )
       {
-         // Generate a ray for the current pixel and trace it
-         auto ray = generateRayForPixel( options, viewport, j, i );
+         auto j = startX;
+
+         // Neighbouring pixels in a row are coherent, so their primary rays are traced as a packet
+         if( packetWidth > 1 )
+         {
+            for( ; j + packetWidth <= endX; j += packetWidth )
+            {
+               for( unsigned int lane = 0; lane < packetWidth; ++lane )
+                  rays[ lane ] = generateRayForPixel( options, viewport, j + lane, i );
+
+               PacketTracer::findClosest( scene, packetWidth, rays, hits );
 
-         addColorToRawPixels( pixels, getRayTracedColor( options, ray, objects, lights ),
-                              ( i * options.imageWidth + j ) * RGBABytes );
+               for( unsigned int lane = 0; lane < packetWidth; ++lane )
+               {
+                  RayTraceResult traceResult;
+                  if( hits[ lane ].isHit() )
+                  {
+                     scene.resolveHit( rays[ lane ], hits[ lane ], traceResult.closestHit, traceResult.material );
+                     RAYTRACER_STAT( hits, 1 );
+                  }
+
+                  colorFunction( j + lane, i, shadeHit( options, rays[ lane ], traceResult, scene, lights, tileStats ) );
+               }
+            }
+         }
+
+         // The rest of the row which doesn't fill a whole packet
+         for( ; j < endX; ++j )
+         {
+            auto ray = generateRayForPixel( options, viewport, j, i );
+            colorFunction( j, i, getRayTracedColor( options, ray, scene, lights, tileStats ) );
+         }
       }
-   }
 
-   return pixels;
+      // Taken even without stats, so the counters don't leak into the next image
+      tileStats += Stats::takeThreadStats();
+      if( stats )
+      {
+         std::lock_guard lock( statsMutex );
+         *stats += tileStats;
+      }
+   }, callerTask );
 }
 
 RayTracer::Viewport RayTracer::calculateViewport( const TracerOptions& options )
@@ -70,22 +219,17 @@ RayTracer::Viewport RayTracer::calculateViewport( const TracerOptions& options )
    };
 }
 
-RayTracer::RayTraceResult RayTracer::traceRay( const Ray& ray, const std::vector<std::shared_ptr<SceneObject>>& objects )
+RayTracer::RayTraceResult RayTracer::traceRay( const Ray& ray, const Scene& scene )
 {
-   RayHitResult closestResult;
-   std::shared_ptr<SceneObject> closestObject = nullptr;
-
-   for( const auto& object: objects )
-   {
-      RayHitResult result;
-      if( object->intersects( ray, result ) && result.distance < closestResult.distance )
-      {
-         closestResult = result;
-         closestObject = object;
-      }
-   }
+   RayTraceResult result;
+   if( scene.intersect( ray, result.closestHit, result.material ) )
+      RAYTRACER_STAT( hits, 1 );
+   return result;
+}
 
-   return { closestResult, closestObject };
+bool RayTracer::isOccluded( const Ray& ray, float maxDistance, const Scene& scene )
+{
+   return scene.isOccluded( ray, maxDistance );
 }
 
 Ray RayTracer::generateRayForPixel( const TracerOptions& options, const Viewport& viewport, unsigned int pixelX,
@@ -113,14 +257,90 @@ Ray RayTracer::generateShadowRay( const Light& light, const Vector3f& intersecti
    return { intersectionPoint, rayDirection };
 }
 
-Color RayTracer::getRayTracedColor( const TracerOptions& options, const Ray& ray,
-                                    const std::vector<std::shared_ptr<SceneObject>>& objects, const std::vector<Light>& lights )
+Color RayTracer::getRayTracedColor( const TracerOptions& options, const Ray& ray, const Scene& scene,
+                                    const std::vector<Light>& lights, RenderStats& stats )
 {
-   auto traceResult = traceRay( ray, objects );
-   auto& material = traceResult.closestObject->material;
+   return shadeHit( options, ray, traceRay( ray, scene ), scene, lights, stats );
+}
 
-   if( !traceResult.closestObject )
-      return options.backgroundColor;
+Color RayTracer::shadeHit( const TracerOptions& options, const Ray& ray, const RayTraceResult& traceResult,
+                           const Scene& scene, const std::vector<Light>& lights, RenderStats& stats )
+{
+   // Secondary rays wait on an explicit stack instead of recursion. Every path spawns at most two rays, and one of them is traced right away,
+   // so the stack never holds more than one pending ray per bounce, plus the second ray of the last bounce
+   PathSegment stack[ SEGMENT_STACK_SIZE ];
+   int stackSize = 0;
+   unsigned int maxDepth = std::min( options.maxRecursionDepth, MAX_BOUNCES );
+
+   PathSegment current{ ray, Color( 1.f, 1.f, 1.f ), 0 };
+   RayTraceResult currentResult = traceResult;
+   Color finalColor( 0.f, 0.f, 0.f );
+
+   while( true )
+   {
+      if( !currentResult.material )
+         finalColor += current.throughput * options.backgroundColor;
+      else
+      {
+         auto& material = *currentResult.material;
+         float reflectivity = material.reflectivity;
+         float transparency = material.transparency;
+         float surfaceWeight = std::max( 0.f, 1.f - reflectivity - transparency );
+
+         if( surfaceWeight > 0.f )
+         {
+            finalColor += current.throughput * shadeSurface( options, current.ray, currentResult, scene, lights ) * surfaceWeight;
+            // One shadow ray per light
+            stats.shadow += lights.size();
+         }
+
+         if( current.depth < maxDepth )
+         {
+            const auto& hit = currentResult.closestHit;
+
+            if( transparency > 0.f )
+            {
+               Ray refractedRay;
+               if( generateRefractedRay( current.ray, hit, material.refractiveIndex, refractedRay ) )
+                  pushSegment( stack, stackSize, { refractedRay, current.throughput * transparency, current.depth + 1 } );
+               else
+                  // Total internal reflection, all the light is reflected
+                  reflectivity += transparency;
+            }
+
+            if( reflectivity > 0.f )
+               pushSegment( stack, stackSize,
+                            { generateReflectedRay( current.ray, hit ), current.throughput * reflectivity, current.depth + 1 } );
+         }
+      }
+
+      if( stackSize == 0 )
+         break;
+
+      current = stack[ --stackSize ];
+      currentResult = traceRay( current.ray, scene );
+      ++stats.secondary;
+   }
+
+   return finalColor;
+}
+
+void RayTracer::pushSegment( PathSegment* stack, int& stackSize, const PathSegment& segment )
+{
+   // Paths which can't add visible energy anymore are dropped
+   if( std::max( { segment.throughput.R, segment.throughput.G, segment.throughput.B } ) < MIN_THROUGHPUT )
+      return;
+   // Can't happen with the depth limited to MAX_BOUNCES, but a full stack drops the ray instead of overwriting memory
+   if( stackSize >= SEGMENT_STACK_SIZE )
+      return;
+
+   stack[ stackSize++ ] = segment;
+}
+
+Color RayTracer::shadeSurface( const TracerOptions& options, const Ray& ray, const RayTraceResult& traceResult,
+                               const Scene& scene, const std::vector<Light>& lights )
+{
+   auto& material = *traceResult.material;
 
    // Object shading
    // Start with ambient color (intensity)
@@ -128,33 +348,70 @@ Color RayTracer::getRayTracedColor( const TracerOptions& options, const Ray& ray
 
    // Blinn-Phong model
    for( const auto& light: lights )
-      finalColor += blinnPhongReflexion( light, traceResult, ray, objects );
+      finalColor += blinnPhongReflexion( light, traceResult, ray, scene );
 
    return finalColor;
 }
 
-void RayTracer::addColorToRawPixels( RawPixels& rawPixels, const Color& color, size_t index )
+Ray RayTracer::generateReflectedRay( const Ray& ray, const RayHitResult& hit )
+{
+   // The normal facing the incoming ray, so we also reflect correctly inside objects
+   Vector3f normal = hit.normal;
+   if( VectorOps::dotProduct( ray.direction, normal ) > 0.f )
+      normal = -normal;
+   auto direction = ray.direction - normal * ( 2.f * VectorOps::dotProduct( ray.direction, normal ) );
+   direction.normalize();
+   return { hit.hitPoint + normal * SHADOW_RAY_OFFSET, direction };
+}
+
+bool RayTracer::generateRefractedRay( const Ray& ray, const RayHitResult& hit, float refractiveIndex, Ray& refractedRay )
+{
+   // Snell's law: https://www.scratchapixel.com/lessons/3d-basic-rendering/introduction-to-shading/reflection-refraction-fresnel.html
+   Vector3f normal = hit.normal;
+   float cosIncident = -VectorOps::dotProduct( ray.direction, normal );
+   float eta = 1.f / refractiveIndex;
+
+   // The ray is leaving the object
+   if( cosIncident < 0.f )
+   {
+      normal = -normal;
+      cosIncident = -cosIncident;
+      eta = refractiveIndex;
+   }
+
+   float k = 1.f - eta * eta * ( 1.f - cosIncident * cosIncident );
+   if( k < 0.f )
+      return false;
+
+   auto direction = ray.direction * eta + normal * ( eta * cosIncident - std::sqrt( k ) );
+   direction.normalize();
+   // Start on the other side of the surface
+   refractedRay = Ray( hit.hitPoint - normal * SHADOW_RAY_OFFSET, direction );
+   return true;
+}
+
+void RayTracer::addColorToRawPixels( RawPixels& rawPixels, const ToneMapper& toneMapper, const Color& color, size_t index )
 {
-   // TODO tone map
-   rawPixels[ index ] = toneMapToUint8( color.R );
-   rawPixels[ index + 1 ] = toneMapToUint8( color.G );
-   rawPixels[ index + 2 ] = toneMapToUint8( color.B );
+   rawPixels[ index ] = toneMapper.map( color.R );
+   rawPixels[ index + 1 ] = toneMapper.map( color.G );
+   rawPixels[ index + 2 ] = toneMapper.map( color.B );
    rawPixels[ index + 3 ] = color.alpha;
 }
 
 Color RayTracer::blinnPhongReflexion( const Light& light, const RayTraceResult& closestResult,
-                                      const Ray& originalRay, const std::vector<std::shared_ptr<SceneObject>>& objects )
+                                      const Ray& originalRay, const Scene& scene )
 {
    Vector3f offsetHitPoint = closestResult.closestHit.hitPoint + closestResult.closestHit.normal * SHADOW_RAY_OFFSET;
    auto lightRay = generateShadowRay( light, offsetHitPoint );
    auto lightDistance = offsetHitPoint.getEuclideanDistance( light.centerPosition );
-   auto& material = closestResult.closestObject->material;
+   auto& material = *closestResult.material;
 
-   // Trace a ray from the closest objects intersect point to the light
-   auto lightTraceResult = traceRay( lightRay, objects );
-
-   if( lightTraceResult.closestObject && lightTraceResult.closestHit.distance < lightDistance )
+   // Check if anything blocks the ray from the closest objects intersect point to the light
+   if( isOccluded( lightRay, lightDistance, scene ) )
+   {
+      RAYTRACER_STAT( occludedLights, 1 );
       return {};
+   }
 
    auto distance = closestResult.closestHit.hitPoint.getEuclideanDistance( light.centerPosition );
    auto distanceAttenuation = light.intensity / ( distance * distance );
@@ -172,9 +429,3 @@ Color RayTracer::blinnPhongReflexion( const Light& light, const RayTraceResult&
 
    return ( diffuse + specular ) * distanceAttenuation;
 }
-
-uint8_t RayTracer::toneMapToUint8( float value )
-{
-   // TODO magical number for exposure fix
-   return static_cast<uint8_t>( std::lround( Math::gammaCorrection( Math::exposureToneMapping( value, 1.1f ), 1.6f ) * 255.0f ) );
-}
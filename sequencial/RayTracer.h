@@ -7,6 +7,11 @@
 
 #include "Color.h"
 #include "Objects.h"
+#include "RenderStats.h"
+#include "Scene.h"
+#include "ThreadPool.h"
+#include "ToneMapper.h"
+#include <functional>
 #include <memory>
 #include <vector>
 
@@ -14,6 +19,10 @@
 
 using Pixels = std::vector<Color>;
 using RawPixels = std::vector<unsigned char>;
+// Called with the index of a row (from the top) and its options.imageWidth RGBA pixels
+using RowFunction = std::function<void( unsigned int pixelY, const unsigned char* row )>;
+// Called with the index of a row (from the top) and its options.imageWidth colors
+using ColorRowFunction = std::function<void( unsigned int pixelY, const Color* row )>;
 
 class RayTracer
 {
@@ -30,9 +39,12 @@ class RayTracer
        * 5. If the material is reflective, we cast another reflective ray recursively until a non-reflective material is found or the ray doesn't hit anything.
        * This new ray acts as a regular ray, and the color of its intersection point is also calculated using the Blinn-Phong model. The resulting color is added back to the original intersection point
        * 6. If the material is refractive, we cast a refraction ray using the Schnell law. This ray also acts as a regular ray, and we add the resulting color back to the original model
+       * The secondary rays are kept on a fixed-size stack instead of recursion. They stop after options.maxRecursionDepth bounces, or earlier when their contribution to the pixel becomes invisible
        *
-       * @remarks This ray tracer uses basic ray-tracing without any optimizations and no space partitioning.
-       * For each pixel, a ray is cast and is checked with all scene objects, and a shadow ray made from all intersection points is checked with all lights
+       * @remarks The objects are converted into a structure-of-arrays Scene. Objects with finite bounds are put into per-type BVHs built with the surface area heuristic,
+       * which are used for both the primary and the shadow rays. Objects without finite bounds (infinite planes) are checked with every ray
+       * The image is split into tiles which are rendered in parallel using options.threadCount threads. The result doesn't depend on the thread count
+       * The primary rays are traced in SIMD packets of neighbouring pixels (see PacketTracer), shading and shadow rays are traced one by one
        *
        * @note See more about the generation method in the report: REPORT.md
        *
@@ -41,28 +53,86 @@ class RayTracer
        * @param options The ray tracer options
        * @param objects A list of objects in a scene
        * @param lights A list of lights in a scene
+       * @param stats Optional out parameter with the statistics of the image. See RenderStats
        * @return A vector of individual pixel colors. The amount is equal to options.imageWidth * options.imageHeight
        */
       static Pixels generateImage( const TracerOptions& options, const std::vector<std::shared_ptr<SceneObject>>& objects,
-                                   const std::vector<Light>& lights );
+                                   const std::vector<Light>& lights, RenderStats* stats = nullptr );
 
       /**
        * @brief An overload of the generateImage method which returns raw pixel data, that can be used directly with Png libraries
        * @param options The ray tracer options
        * @param objects A list of objects in a scene
        * @param lights A list of lights in a scene
+       * @param stats Optional out parameter with the statistics of the image. See RenderStats
        * @return A vector of individual pixel data. Each element represents one color channel, and the pixels are stored behind each other in memory as unsigned chars.
        * E.g. data: R,G,B,A,R,G,B,A The amount is equal to options.imageWidth * options.imageHeight
        */
       static RawPixels generateRawImage( const TracerOptions& options, const std::vector<std::shared_ptr<SceneObject>>& objects,
-                                         const std::vector<Light>& lights );
+                                         const std::vector<Light>& lights, RenderStats* stats = nullptr );
+
+      /**
+       * @brief An overload of generateImage for an already built scene. Useful when the same scene is rendered multiple times
+       */
+      static Pixels generateImage( const TracerOptions& options, const Scene& scene, const std::vector<Light>& lights,
+                                   RenderStats* stats = nullptr );
+
+      /**
+       * @brief An overload of generateRawImage for an already built scene. Useful when the same scene is rendered multiple times
+       */
+      static RawPixels generateRawImage( const TracerOptions& options, const Scene& scene, const std::vector<Light>& lights,
+                                         RenderStats* stats = nullptr );
+
+      /**
+       * @brief Generates the same raw pixels as generateRawImage, but passes them to rowFunction row by row instead of returning the whole image
+       *
+       * The image is rendered in bands of options.tileSize rows. Only two bands are kept in memory: the rows of one band are passed to rowFunction
+       * while the next band is rendered, so the memory is proportional to the image width instead of its area
+       *
+       * @param options The ray tracer options
+       * @param objects A list of objects in a scene
+       * @param lights A list of lights in a scene
+       * @param rowFunction Called with every row of the image, in order from the top. Always called from the calling thread
+       * @param stats Optional out parameter with the statistics of the image. See RenderStats
+       */
+      static void generateRawRows( const TracerOptions& options, const std::vector<std::shared_ptr<SceneObject>>& objects,
+                                   const std::vector<Light>& lights, const RowFunction& rowFunction, RenderStats* stats = nullptr );
+
+      /**
+       * @brief An overload of generateRawRows for an already built scene
+       * @param pool Optional pool rendering the tiles instead of a new pool of options.threadCount threads, e.g. shared by several images rendered at once
+       */
+      static void generateRawRows( const TracerOptions& options, const Scene& scene, const std::vector<Light>& lights,
+                                   const RowFunction& rowFunction, RenderStats* stats = nullptr, ThreadPool* pool = nullptr );
+
+      /**
+       * @brief Generates the colors of generateImage row by row, the same way as generateRawRows. The colors aren't tone mapped
+       */
+      static void generateRows( const TracerOptions& options, const std::vector<std::shared_ptr<SceneObject>>& objects,
+                                const std::vector<Light>& lights, const ColorRowFunction& rowFunction, RenderStats* stats = nullptr );
+
+      /**
+       * @brief An overload of generateRows for an already built scene
+       * @param pool Optional pool rendering the tiles instead of a new pool of options.threadCount threads
+       */
+      static void generateRows( const TracerOptions& options, const Scene& scene, const std::vector<Light>& lights,
+                                const ColorRowFunction& rowFunction, RenderStats* stats = nullptr, ThreadPool* pool = nullptr );
 
    private:
+      // Measures the private shading functions in isolation
+      friend class MicroBench;
+
       static constexpr float MAX_FOV = 120.f;
       static constexpr int RGBABytes = 4;
       // Determines how much of the intersection point normal vector is added to the intersection point to offset it from the original intersection point.
       // This avoids self-intersections and fixes the "shadow acne"
       static constexpr float SHADOW_RAY_OFFSET = 0.05f;
+      // Upper limit of options.maxRecursionDepth
+      static constexpr unsigned int MAX_BOUNCES = 32;
+      // One pending ray per bounce, and the last bounce can push both its reflected and refracted ray
+      static constexpr int SEGMENT_STACK_SIZE = MAX_BOUNCES + 1;
+      // Secondary rays whose contribution to the pixel is smaller than this in every channel aren't traced
+      static constexpr float MIN_THROUGHPUT = 0.01f;
 
       struct Viewport
       {
@@ -73,17 +143,68 @@ class RayTracer
          Vector3f bottomLeftCorner;
       };
 
-      // Currently we use smart pointers in the vector for objects which gives use scattered memory and bad cache coherence = slower access, but it gives use easy polymorphism and intersection detection
-      // We could use variant with a variant + visit method, Enum tags or arrays for all types, but this will be used in the CUDA solution
+      // The objects are stored in the Scene arrays, so we only keep a pointer to the material of the closest primitive. No reference counting on the hot path
       struct RayTraceResult
       {
          RayHitResult closestHit{};
-         std::shared_ptr<SceneObject> closestObject{};
+         const Material* material = nullptr;
+      };
+
+      // A ray waiting on the secondary ray stack together with the fraction of its color which reaches the pixel
+      struct PathSegment
+      {
+         Ray ray;
+         Color throughput;
+         unsigned int depth;
       };
 
       static Viewport calculateViewport( const TracerOptions& options );
 
-      static RayTraceResult traceRay( const Ray& ray, const std::vector<std::shared_ptr<SceneObject>>& objects );
+      static TracerOptions clampedOptions( const TracerOptions& options );
+
+      /**
+       * Splits the rows [firstRow, endRow) of the image into square tiles of options.tileSize and renders them on a work-stealing thread pool.
+       * With options.packetTracing, the primary rays of neighbouring pixels are traced as SIMD packets
+       * @param options The ray tracer options
+       * @param scene The objects in the scene
+       * @param lights A list of lights in the scene
+       * @param pool The thread pool rendering the tiles
+       * @param firstRow The first rendered row of the image
+       * @param endRow The row after the last rendered row
+       * @param colorFunction Function called with the x and y coordinates and the final color of every pixel of the image. It has to be safe to call from multiple threads
+       * @param stats Optional out parameter with the statistics. Every tile counts its rays locally, takes the thread-local counters, and adds them once at its end
+       * @param callerTask Optional work of the calling thread done while the pool renders the tiles, see ThreadPool::parallelFor
+       */
+      template<typename ColorFunction>
+      static void renderTiles( const TracerOptions& options, const Scene& scene, const std::vector<Light>& lights, ThreadPool& pool,
+                               unsigned int firstRow, unsigned int endRow, ColorFunction&& colorFunction, RenderStats* stats,
+                               const std::function<void()>& callerTask = {} );
+
+      /**
+       * Renders the image in bands of options.tileSize rows and passes it to rowFunction row by row. See generateRawRows
+       * @param elementsPerPixel Number of elements of a pixel in a row
+       * @param storePixel Function called with a band, the index of the first element of a pixel in the band, and the pixel color
+       * @param rowFunction Called with every row of the image, in order from the top
+       * @param pool The pool rendering the tiles. A pool of options.threadCount threads is created if it's null
+       */
+      template<typename Element, typename StoreFunction>
+      static void renderRows( const TracerOptions& options, const Scene& scene, const std::vector<Light>& lights, size_t elementsPerPixel,
+                              StoreFunction&& storePixel, const std::function<void( unsigned int, const Element* )>& rowFunction,
+                              RenderStats* stats, ThreadPool* pool );
+
+      static RayTraceResult traceRay( const Ray& ray, const Scene& scene );
+
+      /**
+       * @brief Any-hit query used for shadow rays. Stops at the first object that blocks the ray
+       *
+       * Unlike traceRay, the closest object isn't searched for, and no hit points or normals are calculated
+       *
+       * @param ray The ray to trace
+       * @param maxDistance Objects at this distance or further don't block the ray (e.g. the distance to the light)
+       * @param scene The objects in the scene
+       * @return True if any object intersects the ray closer than maxDistance
+       */
+      static bool isOccluded( const Ray& ray, float maxDistance, const Scene& scene );
 
       static Ray generateRayForPixel( const TracerOptions& options, const Viewport& viewport,
                                       unsigned int pixelX, unsigned int pixelY );
@@ -94,15 +215,47 @@ class RayTracer
        * Traces a ray and returns a final color this ray generates.
        * @param options The ray tracer parameters
        * @param ray The ray to trace
-       * @param objects A list of objects in the scene
+       * @param scene The objects in the scene
        * @param lights A list of lights in the scene
        * @return Returns
        */
-      static Color getRayTracedColor( const TracerOptions& options, const Ray& ray,
-                                      const std::vector<std::shared_ptr<SceneObject>>& objects,
-                                      const std::vector<Light>& lights );
+      static Color getRayTracedColor( const TracerOptions& options, const Ray& ray, const Scene& scene,
+                                      const std::vector<Light>& lights, RenderStats& stats );
 
-      static void addColorToRawPixels( RawPixels& rawPixels, const Color& color, size_t index );
+      /**
+       * Calculates the color of an already traced ray including the reflected and refracted rays.
+       * The secondary rays are traced iteratively using a fixed-size stack, up to options.maxRecursionDepth bounces
+       * @param options The ray tracer parameters
+       * @param ray The traced ray
+       * @param traceResult The closest hit of the ray. The background color is used if the ray didn't hit anything
+       * @param scene The objects in the scene
+       * @param lights A list of lights in the scene
+       * @param stats Counts of the secondary and shadow rays are added here
+       * @return The final color of the ray
+       */
+      static Color shadeHit( const TracerOptions& options, const Ray& ray, const RayTraceResult& traceResult, const Scene& scene,
+                             const std::vector<Light>& lights, RenderStats& stats );
+
+      /**
+       * Pushes a secondary ray on the stack unless its throughput is below MIN_THROUGHPUT or the stack (of SEGMENT_STACK_SIZE) is full
+       */
+      static void pushSegment( PathSegment* stack, int& stackSize, const PathSegment& segment );
+
+      /**
+       * Calculates the color of a surface hit (ambient + Blinn-Phong from all lights) without any secondary rays
+       */
+      static Color shadeSurface( const TracerOptions& options, const Ray& ray, const RayTraceResult& traceResult,
+                                 const Scene& scene, const std::vector<Light>& lights );
+
+      static Ray generateReflectedRay( const Ray& ray, const RayHitResult& hit );
+
+      /**
+       * Generates the refracted ray using the Snell's law. The objects are expected to be surrounded by air (refractive index 1)
+       * @return False on total internal reflection
+       */
+      static bool generateRefractedRay( const Ray& ray, const RayHitResult& hit, float refractiveIndex, Ray& refractedRay );
+
+      static void addColorToRawPixels( RawPixels& rawPixels, const ToneMapper& toneMapper, const Color& color, size_t index );
 
       /**
        * Returns the reflexion color of the closest object using the Blinn-Phong reflexion model
@@ -112,12 +265,10 @@ class RayTracer
        * @param light Current light to calculate the reflexion for
        * @param closestResult The result of the original ray trace
        * @param originalRay The original ray used to get the intersection point of an object
-       * @param objects A list of objects in the scene
+       * @param scene The objects in the scene
        * @return
        */
       static Color blinnPhongReflexion( const Light& light, const RayTraceResult& closestResult, const Ray& originalRay,
-                                        const std::vector<std::shared_ptr<SceneObject>>& objects );
-
-      static uint8_t toneMapToUint8( float value );
+                                        const Scene& scene );
 };
 #endif //SEQUENCIAL_RAYTRACER_H
@@ -0,0 +1,530 @@
+//
+// Created by dominik on 18.10.26.
+//
+
+#include "RenderDaemon.h"
+#include "ImageWriter.h"
+#include "Levels.h"
+#include "RayTracer.h"
+#include "SceneFile.h"
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace
+{
+   using Clock = std::chrono::high_resolution_clock;
+
+   double milliseconds( Clock::duration duration )
+   {
+      return std::chrono::duration<double, std::milli>( duration ).count();
+   }
+
+   std::vector<std::string> splitTokens( const std::string& line )
+   {
+      std::vector<std::string> tokens;
+      std::istringstream stream( line );
+      for( std::string token; stream >> token; )
+         tokens.push_back( token );
+      return tokens;
+   }
+
+   template<typename Number>
+   Number parseNumber( const std::string& key, const std::string& value )
+   {
+      Number number{};
+      auto result = std::from_chars( value.data(), value.data() + value.size(), number );
+      if( result.ec != std::errc() || result.ptr != value.data() + value.size() )
+         throw std::runtime_error( "Invalid " + key + " " + value );
+      return number;
+   }
+
+   // The order of the job heap, the job with the highest priority and the lowest id is on the top
+   template<typename QueuedJob>
+   bool startsLater( const QueuedJob& lhs, const QueuedJob& rhs )
+   {
+      if( lhs.job.priority != rhs.job.priority )
+         return lhs.job.priority < rhs.job.priority;
+      return lhs.id > rhs.id;
+   }
+
+   bool sendAll( int connection, const std::string& data )
+   {
+      for( size_t sent = 0; sent < data.size(); )
+      {
+         // No SIGPIPE if the client is gone
+         ssize_t count = send( connection, data.data() + sent, data.size() - sent, MSG_NOSIGNAL );
+         if( count < 0 && errno == EINTR )
+            continue;
+         if( count <= 0 )
+            return false;
+         sent += static_cast<size_t>( count );
+      }
+      return true;
+   }
+}
+
+RenderDaemon::RenderDaemon( unsigned int threadCount, unsigned int concurrentJobs ) : pool( threadCount )
+{
+   for( auto i = 0u; i < std::max( 1u, concurrentJobs ); ++i )
+      runners.emplace_back( &RenderDaemon::runnerLoop, this );
+}
+
+RenderDaemon::~RenderDaemon()
+{
+   stop();
+   for( auto& runner: runners )
+      runner.join();
+}
+
+void RenderDaemon::enableFrameCache( const std::filesystem::path& directory, uint64_t maxSize )
+{
+   frameCache = std::make_unique<FrameCache>( directory, maxSize );
+}
+
+std::future<RenderDaemon::JobResult> RenderDaemon::submit( Job job )
+{
+   QueuedJob queued;
+   queued.job = std::move( job );
+   queued.submitted = Clock::now();
+   auto result = queued.result.get_future();
+   {
+      std::lock_guard lock( queueMutex );
+      if( stopping )
+      {
+         queued.result.set_exception( std::make_exception_ptr( std::runtime_error( "The daemon is shutting down" ) ) );
+         return result;
+      }
+
+      queued.id = nextJobId++;
+      queue.push_back( std::move( queued ) );
+      std::push_heap( queue.begin(), queue.end(), startsLater<QueuedJob> );
+   }
+   jobQueued.notify_one();
+   return result;
+}
+
+double RenderDaemon::loadScene( const std::string& scene )
+{
+   double loadMs = 0.;
+   acquireScene( scene, loadMs );
+   return loadMs;
+}
+
+bool RenderDaemon::unloadScene( const std::string& scene )
+{
+   std::lock_guard lock( scenesMutex );
+   return scenes.erase( scene ) > 0;
+}
+
+void RenderDaemon::serve( const std::string& socketPath )
+{
+   sockaddr_un address{};
+   if( socketPath.empty() || socketPath.size() >= sizeof( address.sun_path ) )
+      throw std::runtime_error( "Invalid socket path " + socketPath );
+   address.sun_family = AF_UNIX;
+   std::copy( socketPath.begin(), socketPath.end(), address.sun_path );
+
+   int socketDescriptor = socket( AF_UNIX, SOCK_STREAM, 0 );
+   if( socketDescriptor < 0 )
+      throw std::runtime_error( std::string( "Can't create a socket: " ) + std::strerror( errno ) );
+
+   // A socket file left by a previous run would make bind fail
+   unlink( socketPath.c_str() );
+   if( bind( socketDescriptor, reinterpret_cast<const sockaddr*>( &address ), sizeof( address ) ) != 0 ||
+       listen( socketDescriptor, SOMAXCONN ) != 0 )
+   {
+      std::string error = std::strerror( errno );
+      close( socketDescriptor );
+      throw std::runtime_error( "Can't listen on " + socketPath + ": " + error );
+   }
+
+   {
+      std::lock_guard lock( connectionsMutex );
+      listeningSocket = socketDescriptor;
+      if( closingConnections )
+         shutdown( socketDescriptor, SHUT_RDWR );
+   }
+
+   // Connection threads by their socket. stop shuts the listening socket down, which makes accept fail
+   std::map<int, std::thread> connectionThreads;
+   while( true )
+   {
+      int connection = accept( socketDescriptor, nullptr, nullptr );
+      if( connection < 0 )
+      {
+         if( errno == EINTR || errno == ECONNABORTED )
+            continue;
+         break;
+      }
+
+      std::lock_guard lock( connectionsMutex );
+      // A closed connection is reported before its socket is closed, so its number can't be reused by a connection accepted before the join
+      for( int closed: closedConnections )
+      {
+         connectionThreads[ closed ].join();
+         connectionThreads.erase( closed );
+      }
+      closedConnections.clear();
+
+      connections.insert( connection );
+      if( closingConnections )
+         shutdown( connection, SHUT_RD );
+      connectionThreads.emplace( connection, std::thread( &RenderDaemon::handleConnection, this, connection ) );
+   }
+
+   // Also when accept failed by itself, so the connection threads end
+   stop();
+   for( auto& [ connection, thread ]: connectionThreads )
+      thread.join();
+
+   {
+      std::lock_guard lock( connectionsMutex );
+      listeningSocket = -1;
+      closedConnections.clear();
+   }
+   close( socketDescriptor );
+   unlink( socketPath.c_str() );
+}
+
+void RenderDaemon::stop()
+{
+   {
+      std::lock_guard lock( queueMutex );
+      stopping = true;
+      for( auto& queued: queue )
+         queued.result.set_exception( std::make_exception_ptr( std::runtime_error( "The daemon is shutting down" ) ) );
+      queue.clear();
+   }
+   jobQueued.notify_all();
+
+   // The connections stop reading the commands, the replies of the running jobs can still be sent
+   std::lock_guard lock( connectionsMutex );
+   closingConnections = true;
+   if( listeningSocket >= 0 )
+      shutdown( listeningSocket, SHUT_RDWR );
+   for( int connection: connections )
+      shutdown( connection, SHUT_RD );
+}
+
+RenderDaemon::Job RenderDaemon::parseJob( const std::vector<std::string>& arguments )
+{
+   if( arguments.size() < 2 )
+      throw std::runtime_error( "Expected render <scene> <output> [key=value]..." );
+
+   Job job;
+   job.scene = arguments[ 0 ];
+   job.outputPath = arguments[ 1 ];
+   for( size_t i = 2; i < arguments.size(); ++i )
+   {
+      const auto& argument = arguments[ i ];
+      auto separator = argument.find( '=' );
+      if( separator == std::string::npos )
+         throw std::runtime_error( "Expected key=value instead of " + argument );
+
+      std::string key = argument.substr( 0, separator ), value = argument.substr( separator + 1 );
+      if( key == "priority" )
+         job.priority = parseNumber<int>( key, value );
+      else if( key == "width" || key == "height" )
+      {
+         auto size = parseNumber<unsigned int>( key, value );
+         if( size == 0 )
+            throw std::runtime_error( "The image " + key + " can't be 0" );
+         ( key == "width" ? job.imageWidth : job.imageHeight ) = size;
+      }
+      else if( key == "fov" )
+         job.fieldOfView = parseNumber<float>( key, value );
+      else if( key == "distance" )
+         job.cameraDistance = parseNumber<float>( key, value );
+      else if( key == "compression" )
+      {
+         if( value == "fast" )
+            job.compressionLevel = CompressionLevel::FAST;
+         else if( value == "balanced" )
+            job.compressionLevel = CompressionLevel::BALANCED;
+         else if( value == "max" )
+            job.compressionLevel = CompressionLevel::MAX;
+         else
+            throw std::runtime_error( "Invalid compression " + value );
+      }
+      else
+         throw std::runtime_error( "Unknown option " + key );
+   }
+   // Rejected before the job is queued, the file itself is opened once the scene gives the image size
+   ImageWriter::checkFormat( job.outputPath );
+   return job;
+}
+
+std::shared_ptr<const RenderDaemon::ResidentScene> RenderDaemon::acquireScene( const std::string& scene, double& loadMs )
+{
+   std::promise<std::shared_ptr<const ResidentScene>> loaded;
+   std::shared_future<std::shared_ptr<const ResidentScene>> result;
+   bool isLoader = false;
+   {
+      std::lock_guard lock( scenesMutex );
+      auto found = scenes.find( scene );
+      if( found != scenes.end() )
+         result = found->second;
+      else
+      {
+         result = loaded.get_future().share();
+         scenes.emplace( scene, result );
+         isLoader = true;
+      }
+   }
+
+   auto start = Clock::now();
+   bool isResident = !isLoader && result.wait_for( std::chrono::seconds( 0 ) ) == std::future_status::ready;
+   if( isLoader )
+   {
+      try
+      {
+         auto resident = std::make_shared<ResidentScene>();
+         // The same levels as the renderer accepts
+         if( scene.ends_with( ".rtscene" ) )
+            resident->scene = SceneFile::load( scene, resident->options, resident->lights );
+         else
+            resident->scene = createLevel( scene )->loadScene( resident->options, resident->lights );
+         if( frameCache )
+            resident->sceneKey = FrameCache::sceneKey( resident->scene, resident->lights );
+         loaded.set_value( std::move( resident ) );
+      }
+      catch( ... )
+      {
+         // The next job tries to load the scene again
+         {
+            std::lock_guard lock( scenesMutex );
+            scenes.erase( scene );
+         }
+         loaded.set_exception( std::current_exception() );
+      }
+   }
+
+   auto resident = result.get();
+   loadMs = isResident ? 0. : milliseconds( Clock::now() - start );
+   return resident;
+}
+
+void RenderDaemon::runnerLoop()
+{
+   while( true )
+   {
+      QueuedJob queued;
+      {
+         std::unique_lock lock( queueMutex );
+         jobQueued.wait( lock, [ this ] { return stopping || !queue.empty(); } );
+         if( queue.empty() )
+            return;
+
+         std::pop_heap( queue.begin(), queue.end(), startsLater<QueuedJob> );
+         queued = std::move( queue.back() );
+         queue.pop_back();
+         ++runningJobs;
+      }
+
+      JobResult result;
+      std::exception_ptr error;
+      try
+      {
+         result = render( queued );
+      }
+      catch( ... )
+      {
+         error = std::current_exception();
+      }
+
+      // The job stops counting as running before its result is available
+      {
+         std::lock_guard lock( queueMutex );
+         --runningJobs;
+      }
+      if( error )
+         queued.result.set_exception( error );
+      else
+         queued.result.set_value( result );
+   }
+}
+
+RenderDaemon::JobResult RenderDaemon::render( QueuedJob& queued )
+{
+   const Job& job = queued.job;
+   JobResult result;
+   result.id = queued.id;
+   result.queuedMs = milliseconds( Clock::now() - queued.submitted );
+
+   auto resident = acquireScene( job.scene, result.loadMs );
+   TracerOptions options = resident->options;
+   options.imageWidth = job.imageWidth.value_or( options.imageWidth );
+   options.imageHeight = job.imageHeight.value_or( options.imageHeight );
+   options.fieldOfView = job.fieldOfView.value_or( options.fieldOfView );
+   options.cameraDistance = job.cameraDistance.value_or( options.cameraDistance );
+   result.imageWidth = options.imageWidth;
+   result.imageHeight = options.imageHeight;
+
+   auto renderStart = Clock::now();
+   std::string frameKey;
+   if( frameCache )
+   {
+      frameKey = FrameCache::frameKey( resident->sceneKey, options, job.outputPath, job.compressionLevel );
+      if( frameCache->fetch( frameKey, job.outputPath ) )
+      {
+         auto end = Clock::now();
+         result.cached = true;
+         result.renderMs = milliseconds( end - renderStart );
+         result.totalMs = milliseconds( end - queued.submitted );
+         return result;
+      }
+   }
+
+   // The rows are written as they are rendered, the same way as the renderer does it
+   auto writer = ImageWriter::create( job.outputPath, options.imageWidth, options.imageHeight, job.compressionLevel, pool );
+   if( writer->isHdr() )
+   {
+      RayTracer::generateRows( options, resident->scene, resident->lights, [ & ]( unsigned int, const Color* row )
+      {
+         writer->writeColorRow( row );
+      }, &result.stats, &pool );
+   }
+   else
+   {
+      RayTracer::generateRawRows( options, resident->scene, resident->lights, [ & ]( unsigned int, const unsigned char* row )
+      {
+         writer->writeRow( row );
+      }, &result.stats, &pool );
+   }
+   writer->finish();
+   if( frameCache )
+      frameCache->store( frameKey, job.outputPath );
+
+   auto end = Clock::now();
+   result.renderMs = milliseconds( end - renderStart );
+   result.totalMs = milliseconds( end - queued.submitted );
+   return result;
+}
+
+void RenderDaemon::handleConnection( int connection )
+{
+   std::string buffer;
+   char chunk[ 4096 ];
+   bool isOpen = true;
+   while( isOpen )
+   {
+      ssize_t received = recv( connection, chunk, sizeof( chunk ), 0 );
+      if( received < 0 && errno == EINTR )
+         continue;
+      if( received <= 0 )
+         break;
+
+      buffer.append( chunk, static_cast<size_t>( received ) );
+      size_t lineStart = 0;
+      for( size_t newline = buffer.find( '\n' ); isOpen && newline != std::string::npos; newline = buffer.find( '\n', lineStart ) )
+      {
+         std::string line = buffer.substr( lineStart, newline - lineStart );
+         lineStart = newline + 1;
+         if( line.ends_with( '\r' ) )
+            line.pop_back();
+
+         std::string reply;
+         isOpen = handleCommand( line, reply );
+         isOpen = sendAll( connection, reply + "\n" ) && isOpen;
+      }
+      buffer.erase( 0, lineStart );
+
+      if( buffer.size() > MAX_COMMAND_LENGTH )
+      {
+         sendAll( connection, "error Command too long\n" );
+         break;
+      }
+   }
+
+   {
+      std::lock_guard lock( connectionsMutex );
+      connections.erase( connection );
+      closedConnections.push_back( connection );
+   }
+   close( connection );
+}
+
+bool RenderDaemon::handleCommand( const std::string& line, std::string& reply )
+{
+   auto tokens = splitTokens( line );
+   std::string command = tokens.empty() ? "" : tokens[ 0 ];
+   std::vector<std::string> arguments( tokens.begin() + ( tokens.empty() ? 0 : 1 ), tokens.end() );
+   std::ostringstream output;
+   output << "ok";
+   try
+   {
+      if( command == "render" )
+      {
+         Job job = parseJob( arguments );
+         JobResult result = submit( job ).get();
+         output << " job=" << result.id << " width=" << result.imageWidth << " height=" << result.imageHeight << " queued_ms=" <<
+               result.queuedMs << " load_ms=" << result.loadMs << " render_ms=" << result.renderMs << " total_ms=" << result.totalMs <<
+               " primary_rays=" << result.stats.primary << " secondary_rays=" << result.stats.secondary << " shadow_rays=" <<
+               result.stats.shadow << " cached=" << result.cached;
+         std::ostringstream message;
+         message << "Job " << result.id << ": " << job.scene << " -> " << job.outputPath << " in " << result.totalMs << " ms";
+         log( message.str() );
+      }
+      else if( command == "load" && arguments.size() == 1 )
+         output << " load_ms=" << loadScene( arguments[ 0 ] );
+      else if( command == "unload" && arguments.size() == 1 )
+      {
+         if( !unloadScene( arguments[ 0 ] ) )
+            throw std::runtime_error( "Scene " + arguments[ 0 ] + " isn't loaded" );
+      }
+      else if( command == "status" && arguments.empty() )
+      {
+         {
+            std::lock_guard lock( scenesMutex );
+            output << " scenes=" << scenes.size();
+         }
+         {
+            std::lock_guard lock( queueMutex );
+            output << " queued=" << queue.size() << " running=" << runningJobs << " threads=" << pool.getThreadCount();
+         }
+         if( frameCache )
+         {
+            auto cacheStats = frameCache->getStatistics();
+            output << " cache_hits=" << cacheStats.hits << " cache_misses=" << cacheStats.misses << " cache_frames=" <<
+                  cacheStats.frameCount << " cache_bytes=" << cacheStats.size;
+         }
+      }
+      else if( command == "quit" && arguments.empty() )
+      {
+         reply = output.str();
+         return false;
+      }
+      else if( command == "shutdown" && arguments.empty() )
+      {
+         log( "Shutting down" );
+         stop();
+         reply = output.str();
+         return false;
+      }
+      else
+         throw std::runtime_error( "Invalid command \"" + line + "\". Commands: render, load, unload, status, quit, shutdown" );
+   }
+   catch( const std::exception& error )
+   {
+      reply = std::string( "error " ) + error.what();
+      log( reply );
+      return true;
+   }
+
+   reply = output.str();
+   return true;
+}
+
+void RenderDaemon::log( const std::string& line )
+{
+   std::lock_guard lock( logMutex );
+   std::cout << line << std::endl;
+}
@@ -0,0 +1,210 @@
+//
+// Created by dominik on 18.10.26.
+//
+
+#ifndef SEQUENCIAL_RENDERDAEMON_H
+#define SEQUENCIAL_RENDERDAEMON_H
+
+#include "Deflate.h"
+#include "FrameCache.h"
+#include "RenderStats.h"
+#include "Scene.h"
+#include "ThreadPool.h"
+#include "TracerOptions.h"
+#include <chrono>
+#include <condition_variable>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Long-running renderer. The scenes stay loaded with their acceleration structures, so a job only pays for the rendering itself
+ *
+ * The jobs wait in a queue ordered by priority (first come, first served within a priority) and are started by concurrentJobs runner threads.
+ * All the running jobs render their tiles and compress their PNG files on one shared thread pool, so a small job doesn't wait for a large one
+ * to finish, and the pool threads are started once for the whole lifetime of the daemon.
+ * A scene is loaded by the first job (or load command) which needs it, the jobs needing the same scene at the same time wait for that one load.
+ *
+ * The jobs are received over a Unix domain socket (serve) as text commands, one per line, and every command gets a reply line.
+ * The reply starts with "ok" followed by key=value pairs, or with "error" followed by the message:
+ * - render <scene> <output> [priority=N] [width=N] [height=N] [fov=DEGREES] [distance=D] [compression=fast|balanced|max]
+ *   Renders the scene into the output file and replies once it's written, with the timings of the job. The scene is a level ID, a JSON or
+ *   .rtscene file, or a procedural level, the same as the argument of the renderer. The other options override the ones of the scene
+ * - load <scene>: loads the scene ahead of the jobs
+ * - unload <scene>: frees the scene once the jobs rendering it finish
+ * - status: the number of loaded scenes, the queued and running jobs, and the frame cache statistics if the cache is enabled
+ * - quit: closes the connection
+ * - shutdown: rejects the queued jobs, finishes the running ones, and stops the daemon
+ *
+ * With the frame cache enabled (enableFrameCache), a job whose frame was rendered before is copied from the cache instead of rendered.
+ * The scene part of the key is hashed once when the scene is loaded.
+ *
+ * A connection waits for the reply of a render command, so the jobs rendered at once come from separate connections.
+ * The paths can't contain spaces
+ */
+class RenderDaemon
+{
+   public:
+      // Render request. The unset options are taken from the scene
+      struct Job
+      {
+         std::string scene;
+         std::string outputPath;
+         // Jobs with a higher priority are started first
+         int priority = 0;
+         std::optional<unsigned int> imageWidth;
+         std::optional<unsigned int> imageHeight;
+         std::optional<float> fieldOfView;
+         std::optional<float> cameraDistance;
+         CompressionLevel compressionLevel = CompressionLevel::BALANCED;
+      };
+
+      struct JobResult
+      {
+         uint64_t id = 0;
+         unsigned int imageWidth = 0;
+         unsigned int imageHeight = 0;
+         // Time spent in the queue before a runner took the job
+         double queuedMs = 0.;
+         // Time spent loading the scene, or waiting for another job loading it. 0 if the scene was already loaded
+         double loadMs = 0.;
+         // Rendering together with writing the file, which is written while the image is rendered. Copying the file on a cache hit
+         double renderMs = 0.;
+         // From submitting the job to writing the file
+         double totalMs = 0.;
+         RenderStats stats;
+         // The frame was copied from the frame cache, the stats are empty then
+         bool cached = false;
+      };
+
+      static constexpr unsigned int DEFAULT_CONCURRENT_JOBS = 2;
+      // Longer command lines are rejected and the connection is closed
+      static constexpr size_t MAX_COMMAND_LENGTH = 1 << 16;
+
+      /**
+       * @param threadCount Number of threads of the shared pool. 0 means one thread per hardware thread
+       * @param concurrentJobs Maximum number of jobs rendered at once
+       */
+      explicit RenderDaemon( unsigned int threadCount = 0, unsigned int concurrentJobs = DEFAULT_CONCURRENT_JOBS );
+
+      RenderDaemon( const RenderDaemon& ) = delete;
+
+      RenderDaemon& operator=( const RenderDaemon& ) = delete;
+
+      /**
+       * @brief Stops the daemon and waits for the running jobs
+       */
+      ~RenderDaemon();
+
+      /**
+       * @brief Copies the frames rendered before from a cache directory and stores the new ones there. Has to be called before any scene is loaded
+       * @throws std::filesystem::filesystem_error If the directory can't be created or read
+       */
+      void enableFrameCache( const std::filesystem::path& directory, uint64_t maxSize = FrameCache::DEFAULT_MAX_SIZE );
+
+      /**
+       * @brief Queues a job
+       * @return The result, available once the file is written. It holds a std::runtime_error if the job failed or was rejected by stop
+       */
+      std::future<JobResult> submit( Job job );
+
+      /**
+       * @brief Loads a scene unless it's loaded already
+       * @return The time spent loading the scene in milliseconds, 0 if it was loaded already
+       * @throws std::runtime_error If the scene can't be loaded
+       */
+      double loadScene( const std::string& scene );
+
+      /**
+       * @brief Removes a scene. The jobs rendering it keep it until they finish
+       * @return False if the scene wasn't loaded
+       */
+      bool unloadScene( const std::string& scene );
+
+      /**
+       * @brief Accepts connections on a Unix domain socket and handles their commands until stop is called (e.g. by the shutdown command)
+       *
+       * An existing file at the socket path is replaced, and the socket file is removed at the end
+       * @throws std::runtime_error If the socket can't be created
+       */
+      void serve( const std::string& socketPath );
+
+      /**
+       * @brief Rejects the queued jobs and stops serve. The running jobs are finished. Can be called from any thread
+       */
+      void stop();
+
+      /**
+       * @brief Parses the arguments of a render command: <scene> <output> [key=value]...
+       * @throws std::runtime_error If an argument is missing or invalid
+       */
+      static Job parseJob( const std::vector<std::string>& arguments );
+
+   private:
+      // A loaded scene with everything needed to render it
+      struct ResidentScene
+      {
+         Scene scene;
+         TracerOptions options;
+         std::vector<Light> lights;
+         // FrameCache::sceneKey, only computed with the frame cache enabled
+         std::string sceneKey;
+      };
+
+      struct QueuedJob
+      {
+         Job job;
+         uint64_t id = 0;
+         std::chrono::high_resolution_clock::time_point submitted;
+         std::promise<JobResult> result;
+      };
+
+      // Loads the scene or waits for the job already loading it
+      std::shared_ptr<const ResidentScene> acquireScene( const std::string& scene, double& loadMs );
+
+      void runnerLoop();
+
+      JobResult render( QueuedJob& queued );
+
+      void handleConnection( int connection );
+
+      // Executes one command line. Returns false if the connection should be closed after the reply
+      bool handleCommand( const std::string& line, std::string& reply );
+
+      void log( const std::string& line );
+
+      ThreadPool pool;
+      std::vector<std::thread> runners;
+
+      std::mutex queueMutex;
+      std::condition_variable jobQueued;
+      // Binary heap ordered by the priority and the id
+      std::vector<QueuedJob> queue;
+      uint64_t nextJobId = 1;
+      unsigned int runningJobs = 0;
+      bool stopping = false;
+
+      std::mutex scenesMutex;
+      std::map<std::string, std::shared_future<std::shared_ptr<const ResidentScene>>> scenes;
+
+      std::unique_ptr<FrameCache> frameCache;
+
+      std::mutex connectionsMutex;
+      int listeningSocket = -1;
+      // Open connections, shut down by stop
+      std::set<int> connections;
+      // Connections whose threads finished and have to be joined
+      std::vector<int> closedConnections;
+      bool closingConnections = false;
+
+      // Keeps the log lines of the connections whole
+      std::mutex logMutex;
+};
+
+#endif //SEQUENCIAL_RENDERDAEMON_H
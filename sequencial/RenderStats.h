@@ -0,0 +1,85 @@
+//
+// Created by dominik on 18.10.26.
+//
+
+#ifndef SEQUENCIAL_RENDERSTATS_H
+#define SEQUENCIAL_RENDERSTATS_H
+
+#include <cstdint>
+
+/**
+ * @brief Statistics of one generated image
+ *
+ * The ray counts are always collected. The intersection tests, hits, and occluded lights are only counted in the stats mode,
+ * when the ray tracer is compiled with RAYTRACER_STATS (the RAYTRACER_STATS CMake option), otherwise they stay 0 and the counting is compiled out.
+ */
+struct RenderStats
+{
+   uint64_t primary = 0;
+   // Reflected and refracted rays
+   uint64_t secondary = 0;
+   uint64_t shadow = 0;
+
+   // Ray-primitive intersection tests. A packet test counts one test per ray of the packet
+   uint64_t sphereTests = 0;
+   uint64_t planeTests = 0;
+   uint64_t blockTests = 0;
+   uint64_t triangleTests = 0;
+   // Rays transformed into the object space of an instance
+   uint64_t instanceTests = 0;
+   // Primary and secondary rays which hit any object
+   uint64_t hits = 0;
+   // Lights blocked by an object when shading a hit
+   uint64_t occludedLights = 0;
+
+   RenderStats& operator+=( const RenderStats& other )
+   {
+      primary += other.primary;
+      secondary += other.secondary;
+      shadow += other.shadow;
+      sphereTests += other.sphereTests;
+      planeTests += other.planeTests;
+      blockTests += other.blockTests;
+      triangleTests += other.triangleTests;
+      instanceTests += other.instanceTests;
+      hits += other.hits;
+      occludedLights += other.occludedLights;
+      return *this;
+   }
+};
+
+namespace Stats
+{
+#ifdef RAYTRACER_STATS
+   inline constexpr bool ENABLED = true;
+
+   // Every thread counts into its own copy, so the counting needs no atomics
+   inline thread_local RenderStats threadStats;
+
+   /**
+    * @return The counters of the calling thread since the last call. The counters are reset
+    */
+   inline RenderStats takeThreadStats()
+   {
+      RenderStats stats = threadStats;
+      threadStats = {};
+      return stats;
+   }
+#else
+   inline constexpr bool ENABLED = false;
+
+   inline RenderStats takeThreadStats()
+   {
+      return {};
+   }
+#endif
+}
+
+// Adds amount to a counter of the calling thread. Expands to nothing without RAYTRACER_STATS
+#ifdef RAYTRACER_STATS
+#define RAYTRACER_STAT( counter, amount ) ( Stats::threadStats.counter += ( amount ) )
+#else
+#define RAYTRACER_STAT( counter, amount ) ( ( void ) 0 )
+#endif
+
+#endif //SEQUENCIAL_RENDERSTATS_H
@@ -0,0 +1,756 @@
+//
+// Created by dominik on 17.10.26.
+//
+
+#include "Scene.h"
+#include "Intersections.h"
+#include "RenderStats.h"
+#include "SphereBatch.h"
+#include <stdexcept>
+
+namespace
+{
+   // Reorders the array so that array[ i ] = old array[ order[ i ] ]
+   template<typename T>
+   void permute( MappedArray<T>& array, const std::vector<uint32_t>& order )
+   {
+      std::vector<T> reordered;
+      reordered.reserve( array.size() );
+      for( auto index: order )
+         reordered.push_back( array[ index ] );
+      array = std::move( reordered );
+   }
+
+   // Updates the positions of the primitives by their add index after the arrays were reordered by order. Empty locations mean the arrays
+   // were in the add order
+   void reorderLocations( std::vector<uint32_t>& locations, const std::vector<uint32_t>& order )
+   {
+      std::vector<uint32_t> positions( order.size() );
+      for( size_t i = 0; i < order.size(); ++i )
+         positions[ order[ i ] ] = static_cast<uint32_t>( i );
+
+      if( locations.empty() )
+         locations = std::move( positions );
+      else
+      {
+         for( auto& location: locations )
+            location = positions[ location ];
+      }
+   }
+
+   uint32_t locate( const std::vector<uint32_t>& locations, uint32_t index )
+   {
+      return locations.empty() ? index : locations[ index ];
+   }
+}
+
+AABB SphereArrays::bounds( size_t i ) const
+{
+   Vector3f extents( radius[ i ], radius[ i ], radius[ i ] );
+   return { center( i ) - extents, center( i ) + extents };
+}
+
+void SphereArrays::reorder( const std::vector<uint32_t>& order )
+{
+   permute( centerX, order );
+   permute( centerY, order );
+   permute( centerZ, order );
+   permute( radius, order );
+   permute( materialIndex, order );
+}
+
+void BlockArrays::reorder( const std::vector<uint32_t>& order )
+{
+   permute( minX, order );
+   permute( minY, order );
+   permute( minZ, order );
+   permute( maxX, order );
+   permute( maxY, order );
+   permute( maxZ, order );
+   permute( materialIndex, order );
+}
+
+AABB PlaneArrays::bounds( size_t i ) const
+{
+   return Intersection::planeBounds( center( i ), tangent( i ), bitangent( i ), halfWidth[ i ], halfDepth[ i ] );
+}
+
+void PlaneArrays::reorder( const std::vector<uint32_t>& order )
+{
+   permute( centerX, order );
+   permute( centerY, order );
+   permute( centerZ, order );
+   permute( normalX, order );
+   permute( normalY, order );
+   permute( normalZ, order );
+   permute( tangentX, order );
+   permute( tangentY, order );
+   permute( tangentZ, order );
+   permute( bitangentX, order );
+   permute( bitangentY, order );
+   permute( bitangentZ, order );
+   permute( halfWidth, order );
+   permute( halfDepth, order );
+   permute( materialIndex, order );
+}
+
+Scene::Scene( const std::vector<std::shared_ptr<SceneObject>>& objects )
+{
+   materials.reserve( objects.size() );
+   objectIndices.reserve( objects.size() );
+   for( const auto& object: objects )
+      objectIndices.push_back( object->addToScene( *this ) );
+
+   build();
+}
+
+uint32_t Scene::addMaterial( const Material& material )
+{
+   materials.push_back( material );
+   return static_cast<uint32_t>( materials.size() - 1 );
+}
+
+uint32_t Scene::addSphere( const Vector3f& center, float radius, uint32_t materialIndex )
+{
+   spheres.centerX.push_back( center.x() );
+   spheres.centerY.push_back( center.y() );
+   spheres.centerZ.push_back( center.z() );
+   spheres.radius.push_back( radius );
+   spheres.materialIndex.push_back( materialIndex );
+
+   auto sphere = static_cast<uint32_t>( spheres.size() - 1 );
+   if( !sphereLocations.empty() )
+      sphereLocations.push_back( sphere );
+   return sphere;
+}
+
+uint32_t Scene::addPlane( const Vector3f& center, const Vector3f& normal, const Vector3f& tangent, const Vector3f& bitangent,
+                          float halfWidth, float halfDepth, uint32_t materialIndex )
+{
+   planes.centerX.push_back( center.x() );
+   planes.centerY.push_back( center.y() );
+   planes.centerZ.push_back( center.z() );
+   planes.normalX.push_back( normal.x() );
+   planes.normalY.push_back( normal.y() );
+   planes.normalZ.push_back( normal.z() );
+   planes.tangentX.push_back( tangent.x() );
+   planes.tangentY.push_back( tangent.y() );
+   planes.tangentZ.push_back( tangent.z() );
+   planes.bitangentX.push_back( bitangent.x() );
+   planes.bitangentY.push_back( bitangent.y() );
+   planes.bitangentZ.push_back( bitangent.z() );
+   planes.halfWidth.push_back( halfWidth );
+   planes.halfDepth.push_back( halfDepth );
+   planes.materialIndex.push_back( materialIndex );
+   return static_cast<uint32_t>( planes.size() - 1 );
+}
+
+uint32_t Scene::addBlock( const Vector3f& minPoint, const Vector3f& maxPoint, uint32_t materialIndex )
+{
+   blocks.minX.push_back( minPoint.x() );
+   blocks.minY.push_back( minPoint.y() );
+   blocks.minZ.push_back( minPoint.z() );
+   blocks.maxX.push_back( maxPoint.x() );
+   blocks.maxY.push_back( maxPoint.y() );
+   blocks.maxZ.push_back( maxPoint.z() );
+   blocks.materialIndex.push_back( materialIndex );
+
+   auto block = static_cast<uint32_t>( blocks.size() - 1 );
+   if( !blockLocations.empty() )
+      blockLocations.push_back( block );
+   return block;
+}
+
+uint32_t Scene::addMesh( std::shared_ptr<const TriangleMesh> geometry, uint32_t materialIndex )
+{
+   meshBounds.push_back( geometry->getBounds() );
+   meshes.push_back( { std::move( geometry ), materialIndex } );
+   return static_cast<uint32_t>( meshes.size() - 1 );
+}
+
+uint32_t Scene::addInstance( std::shared_ptr<const Scene> prototype, const Transform& transform )
+{
+   if( !prototype->instances.empty() )
+      throw std::runtime_error( "A prototype can't contain instances" );
+   if( !prototype->getBounds().isFinite() )
+      throw std::runtime_error( "A prototype can't contain infinite planes" );
+
+   instances.push_back( { std::move( prototype ), transform } );
+   return static_cast<uint32_t>( instances.size() - 1 );
+}
+
+void Scene::moveSphere( uint32_t sphere, const Vector3f& center, float radius )
+{
+   uint32_t i = locate( sphereLocations, sphere );
+   spheres.centerX[ i ] = center.x();
+   spheres.centerY[ i ] = center.y();
+   spheres.centerZ[ i ] = center.z();
+   spheres.radius[ i ] = radius;
+   movedSpheres.push_back( i );
+}
+
+void Scene::moveBlock( uint32_t block, const Vector3f& minPoint, const Vector3f& maxPoint )
+{
+   uint32_t i = locate( blockLocations, block );
+   blocks.minX[ i ] = minPoint.x();
+   blocks.minY[ i ] = minPoint.y();
+   blocks.minZ[ i ] = minPoint.z();
+   blocks.maxX[ i ] = maxPoint.x();
+   blocks.maxY[ i ] = maxPoint.y();
+   blocks.maxZ[ i ] = maxPoint.z();
+   movedBlocks.push_back( i );
+}
+
+void Scene::setInstanceTransform( uint32_t instance, const Transform& transform )
+{
+   instances[ instance ].transform = transform;
+   movedInstances.push_back( instance );
+}
+
+void Scene::refit()
+{
+   // The wide BVHs are refitted from the refitted binary nodes. The grids are built again (the moved primitives can leave the grid bounds),
+   // and so are the wide BVHs of rebuilt BVHs
+   bool rebuildSpheres = false, rebuildBlocks = false;
+   if( !movedSpheres.empty() )
+   {
+      sphereBVH.refit( movedSpheres, [ this ]( uint32_t i ) { return spheres.bounds( i ); } );
+      if( sphereBVH.getDegradation() > REBUILD_DEGRADATION )
+      {
+         buildSpheres();
+         rebuildSpheres = true;
+      }
+      else if( accelerator == Accelerator::WIDE_BVH )
+         sphereWideBVH.refit( sphereBVH, movedSpheres );
+      else
+         rebuildSpheres = true;
+      movedSpheres.clear();
+   }
+
+   if( !movedBlocks.empty() )
+   {
+      blockBVH.refit( movedBlocks, [ this ]( uint32_t i ) { return blocks.bounds( i ); } );
+      if( blockBVH.getDegradation() > REBUILD_DEGRADATION )
+      {
+         buildBlocks();
+         rebuildBlocks = true;
+      }
+      else if( accelerator == Accelerator::WIDE_BVH )
+         blockWideBVH.refit( blockBVH, movedBlocks );
+      else
+         rebuildBlocks = true;
+      movedBlocks.clear();
+   }
+
+   buildAccelerators( rebuildSpheres, rebuildBlocks, false );
+
+   if( movedInstances.empty() )
+      return;
+
+   // Instances added after the last build aren't in the BVH yet
+   const auto& order = instanceBVH.getPrimitiveIndices();
+   if( order.size() != instances.size() )
+   {
+      buildInstances();
+      return;
+   }
+
+   if( instanceLocations.empty() )
+      reorderLocations( instanceLocations, order );
+   for( auto& instance: movedInstances )
+      instance = instanceLocations[ instance ];
+   instanceBVH.refit( movedInstances, [ & ]( uint32_t i ) { return instanceBounds( order[ i ] ); } );
+   movedInstances.clear();
+   if( instanceBVH.getDegradation() > REBUILD_DEGRADATION )
+      buildInstances();
+}
+
+void Scene::update( const std::vector<std::shared_ptr<SceneObject>>& objects, const std::vector<size_t>& changed )
+{
+   for( auto i: changed )
+      objects[ i ]->updateInScene( *this, objectIndices[ i ] );
+   refit();
+}
+
+void Scene::build()
+{
+   buildSpheres();
+   buildBlocks();
+   buildPlanes();
+   buildInstances();
+   buildAccelerators( true, true, true );
+}
+
+void Scene::buildSpheres()
+{
+   std::vector<AABB> bounds;
+   bounds.reserve( spheres.size() );
+   for( size_t i = 0; i < spheres.size(); ++i )
+      bounds.push_back( spheres.bounds( i ) );
+   // A sphere leaf is tested as one SIMD batch, so it can be as wide as the batch
+   sphereBVH = BVH( bounds, std::max( BVH::MAX_LEAF_SIZE, SphereBatch::batchWidth() ) );
+   spheres.reorder( sphereBVH.getPrimitiveIndices() );
+   reorderLocations( sphereLocations, sphereBVH.getPrimitiveIndices() );
+   movedSpheres.clear();
+}
+
+void Scene::buildBlocks()
+{
+   std::vector<AABB> bounds;
+   bounds.reserve( blocks.size() );
+   for( size_t i = 0; i < blocks.size(); ++i )
+      bounds.push_back( blocks.bounds( i ) );
+   blockBVH = BVH( bounds );
+   blocks.reorder( blockBVH.getPrimitiveIndices() );
+   reorderLocations( blockLocations, blockBVH.getPrimitiveIndices() );
+   movedBlocks.clear();
+}
+
+void Scene::buildPlanes()
+{
+   // Bounded planes go into the BVH and are moved to the front, the infinite ones follow them
+   std::vector<AABB> bounds;
+   std::vector<uint32_t> boundedPlanes, unboundedPlanes;
+   for( size_t i = 0; i < planes.size(); ++i )
+   {
+      AABB planeBounds = planes.bounds( i );
+      if( planeBounds.isFinite() )
+      {
+         boundedPlanes.push_back( static_cast<uint32_t>( i ) );
+         bounds.push_back( planeBounds );
+      }
+      else
+         unboundedPlanes.push_back( static_cast<uint32_t>( i ) );
+   }
+   planeBVH = BVH( bounds );
+   boundedPlaneCount = static_cast<uint32_t>( boundedPlanes.size() );
+
+   std::vector<uint32_t> planeOrder;
+   planeOrder.reserve( planes.size() );
+   for( auto index: planeBVH.getPrimitiveIndices() )
+      planeOrder.push_back( boundedPlanes[ index ] );
+   planeOrder.insert( planeOrder.end(), unboundedPlanes.begin(), unboundedPlanes.end() );
+   planes.reorder( planeOrder );
+}
+
+void Scene::buildInstances()
+{
+   std::vector<AABB> bounds;
+   bounds.reserve( instances.size() );
+   for( uint32_t i = 0; i < instances.size(); ++i )
+      bounds.push_back( instanceBounds( i ) );
+   instanceBVH = BVH( bounds );
+   instanceLocations.clear();
+   movedInstances.clear();
+}
+
+void Scene::setAccelerator( Accelerator accelerator )
+{
+   this->accelerator = accelerator;
+   sphereWideBVH = {};
+   blockWideBVH = {};
+   planeWideBVH = {};
+   sphereGrid = {};
+   blockGrid = {};
+   planeGrid = {};
+   buildAccelerators( true, true, true );
+}
+
+Scene::Accelerator Scene::getAccelerator() const
+{
+   return accelerator;
+}
+
+void Scene::buildAccelerators( bool buildSpheres, bool buildBlocks, bool buildPlanes )
+{
+   if( accelerator == Accelerator::BVH )
+      return;
+
+   if( accelerator == Accelerator::WIDE_BVH )
+   {
+      if( buildSpheres )
+         sphereWideBVH = WideBVH( sphereBVH );
+      if( buildBlocks )
+         blockWideBVH = WideBVH( blockBVH );
+      if( buildPlanes )
+         planeWideBVH = WideBVH( planeBVH );
+      return;
+   }
+
+   auto layout = accelerator == Accelerator::HASHED_GRID ? UniformGrid::Layout::HASHED : UniformGrid::Layout::AUTOMATIC;
+   std::vector<AABB> bounds;
+   if( buildSpheres )
+   {
+      bounds.reserve( spheres.size() );
+      for( size_t i = 0; i < spheres.size(); ++i )
+         bounds.push_back( spheres.bounds( i ) );
+      sphereGrid = UniformGrid( bounds, layout );
+   }
+
+   if( buildBlocks )
+   {
+      bounds.clear();
+      for( size_t i = 0; i < blocks.size(); ++i )
+         bounds.push_back( blocks.bounds( i ) );
+      blockGrid = UniformGrid( bounds, layout );
+   }
+
+   if( buildPlanes )
+   {
+      bounds.clear();
+      for( size_t i = 0; i < boundedPlaneCount; ++i )
+         bounds.push_back( planes.bounds( i ) );
+      planeGrid = UniformGrid( bounds, layout );
+   }
+}
+
+AABB Scene::instanceBounds( uint32_t instance ) const
+{
+   return instances[ instance ].transform.transformBounds( instances[ instance ].prototype->getBounds() );
+}
+
+bool Scene::intersect( const Ray& ray, RayHitResult& result, const Material*& material ) const
+{
+   PrimitiveHit closest;
+   findClosest( ray, closest );
+
+   if( !closest.isHit() )
+      return false;
+
+   resolveHit( ray, closest, result, material );
+   return true;
+}
+
+void Scene::findClosest( const Ray& ray, PrimitiveHit& closest ) const
+{
+   // Planes first, hits of the large infinite planes also help to cull the BVH nodes
+   intersectPlanes( ray, closest );
+   intersectSpheres( ray, closest );
+   intersectBlocks( ray, closest );
+   findClosestMesh( ray, closest );
+   findClosestInstance( ray, closest );
+}
+
+void Scene::findClosestMesh( const Ray& ray, PrimitiveHit& closest ) const
+{
+   float entry;
+   for( size_t i = 0; i < meshes.size(); ++i )
+   {
+      if( !meshBounds[ i ].intersects( ray.startPoint, ray.inverseDirection, closest.distance, entry ) )
+         continue;
+
+      if( meshes[ i ].geometry->findClosest( ray, closest.distance, closest.index ) )
+      {
+         closest.type = MESH;
+         closest.mesh = static_cast<uint32_t>( i );
+      }
+   }
+}
+
+void Scene::findClosestInstance( const Ray& ray, PrimitiveHit& closest ) const
+{
+   const auto& order = instanceBVH.getPrimitiveIndices();
+   instanceBVH.traverse( ray.startPoint, ray.inverseDirection, closest.distance,
+                         [ & ]( uint32_t first, uint32_t count, float& closestDistance )
+                         {
+                            RAYTRACER_STAT( instanceTests, count );
+                            for( auto i = first; i < first + count; ++i )
+                            {
+                               const SceneInstance& instance = instances[ order[ i ] ];
+                               float distanceScale;
+                               Ray objectRay = instance.transform.toObjectSpace( ray, distanceScale );
+
+                               // Only the primitives closer than the current closest hit count
+                               PrimitiveHit hit;
+                               float limit = closestDistance * distanceScale;
+                               hit.distance = limit;
+                               instance.prototype->findClosest( objectRay, hit );
+                               if( hit.distance < limit )
+                               {
+                                  closest = hit;
+                                  closest.distance = hit.distance / distanceScale;
+                                  closest.instance = order[ i ];
+                               }
+                            }
+                            return false;
+                         } );
+}
+
+void Scene::resolveHit( const Ray& ray, const PrimitiveHit& hit, RayHitResult& result, const Material*& material ) const
+{
+   if( hit.instance != PrimitiveHit::NO_INSTANCE )
+   {
+      const SceneInstance& instance = instances[ hit.instance ];
+      float distanceScale;
+      Ray objectRay = instance.transform.toObjectSpace( ray, distanceScale );
+
+      PrimitiveHit objectHit = hit;
+      objectHit.distance = hit.distance * distanceScale;
+      objectHit.instance = PrimitiveHit::NO_INSTANCE;
+      instance.prototype->resolveHit( objectRay, objectHit, result, material );
+      instance.transform.toWorldSpace( ray, hit.distance, result );
+      return;
+   }
+
+   uint32_t i = hit.index;
+   switch( hit.type )
+   {
+      case SPHERE:
+         Intersection::sphereSurface( ray, spheres.center( i ), hit.distance, result );
+         material = &materials[ spheres.materialIndex[ i ] ];
+         break;
+      case PLANE:
+         Intersection::planeSurface( ray, planes.normal( i ), hit.distance, result );
+         material = &materials[ planes.materialIndex[ i ] ];
+         break;
+      case BLOCK:
+         Intersection::blockSurface( ray, blocks.minPoint( i ), blocks.maxPoint( i ), hit.distance, result );
+         material = &materials[ blocks.materialIndex[ i ] ];
+         break;
+      case MESH:
+         meshes[ hit.mesh ].geometry->surface( ray, i, hit.distance, result );
+         material = &materials[ meshes[ hit.mesh ].materialIndex ];
+         break;
+   }
+}
+
+bool Scene::isOccluded( const Ray& ray, float maxDistance ) const
+{
+   float distance;
+   RAYTRACER_STAT( planeTests, planes.size() - boundedPlaneCount );
+   for( size_t i = boundedPlaneCount; i < planes.size(); ++i )
+   {
+      if( planeDistance( ray, i, distance ) && distance < maxDistance )
+         return true;
+   }
+
+   float limit = maxDistance;
+   if( traverse( planeBVH, planeWideBVH, planeGrid, ray, limit, [ & ]( uint32_t first, uint32_t count, float& )
+   {
+      RAYTRACER_STAT( planeTests, count );
+      for( auto i = first; i < first + count; ++i )
+      {
+         if( planeDistance( ray, i, distance ) && distance < maxDistance )
+            return true;
+      }
+      return false;
+   } ) )
+      return true;
+
+   limit = maxDistance;
+   if( traverse( sphereBVH, sphereWideBVH, sphereGrid, ray, limit, [ & ]( uint32_t first, uint32_t count, float& )
+   {
+      RAYTRACER_STAT( sphereTests, count );
+      return SphereBatch::anyHit( spheres, first, count, ray, maxDistance );
+   } ) )
+      return true;
+
+   float entry;
+   for( size_t i = 0; i < meshes.size(); ++i )
+   {
+      if( meshBounds[ i ].intersects( ray.startPoint, ray.inverseDirection, maxDistance, entry ) &&
+          meshes[ i ].geometry->isOccluded( ray, maxDistance ) )
+         return true;
+   }
+
+   limit = maxDistance;
+   const auto& order = instanceBVH.getPrimitiveIndices();
+   if( instanceBVH.traverse( ray.startPoint, ray.inverseDirection, limit, [ & ]( uint32_t first, uint32_t count, float& )
+   {
+      RAYTRACER_STAT( instanceTests, count );
+      for( auto i = first; i < first + count; ++i )
+      {
+         const SceneInstance& instance = instances[ order[ i ] ];
+         float distanceScale;
+         Ray objectRay = instance.transform.toObjectSpace( ray, distanceScale );
+         if( instance.prototype->isOccluded( objectRay, maxDistance * distanceScale ) )
+            return true;
+      }
+      return false;
+   } ) )
+      return true;
+
+   limit = maxDistance;
+   return traverse( blockBVH, blockWideBVH, blockGrid, ray, limit, [ & ]( uint32_t first, uint32_t count, float& )
+   {
+      RAYTRACER_STAT( blockTests, count );
+      for( auto i = first; i < first + count; ++i )
+      {
+         if( Intersection::blockDistance( ray, blocks.minPoint( i ), blocks.maxPoint( i ), distance ) && distance < maxDistance )
+            return true;
+      }
+      return false;
+   } );
+}
+
+const MappedArray<Material>& Scene::getMaterials() const
+{
+   return materials;
+}
+
+const SphereArrays& Scene::getSpheres() const
+{
+   return spheres;
+}
+
+const PlaneArrays& Scene::getPlanes() const
+{
+   return planes;
+}
+
+const BlockArrays& Scene::getBlocks() const
+{
+   return blocks;
+}
+
+const std::vector<SceneMesh>& Scene::getMeshes() const
+{
+   return meshes;
+}
+
+const std::vector<SceneInstance>& Scene::getInstances() const
+{
+   return instances;
+}
+
+AABB Scene::getBounds() const
+{
+   if( boundedPlaneCount < planes.size() )
+      return AABB::infinite();
+
+   AABB bounds;
+   for( const BVH* bvh: { &sphereBVH, &blockBVH, &planeBVH, &instanceBVH } )
+   {
+      if( !bvh->isEmpty() )
+         bounds.grow( bvh->getNodes()[ 0 ].bounds );
+   }
+   for( const auto& meshBound: meshBounds )
+      bounds.grow( meshBound );
+   return bounds;
+}
+
+size_t Scene::getPrimitiveCount() const
+{
+   size_t count = spheres.size() + blocks.size() + planes.size();
+   for( const auto& mesh: meshes )
+      count += mesh.geometry->getTriangleCount();
+   for( const auto& instance: instances )
+      count += instance.prototype->getPrimitiveCount();
+   return count;
+}
+
+const WideBVH& Scene::getSphereWideBVH() const
+{
+   return sphereWideBVH;
+}
+
+const WideBVH& Scene::getBlockWideBVH() const
+{
+   return blockWideBVH;
+}
+
+const WideBVH& Scene::getPlaneWideBVH() const
+{
+   return planeWideBVH;
+}
+
+const UniformGrid& Scene::getSphereGrid() const
+{
+   return sphereGrid;
+}
+
+const UniformGrid& Scene::getBlockGrid() const
+{
+   return blockGrid;
+}
+
+const UniformGrid& Scene::getPlaneGrid() const
+{
+   return planeGrid;
+}
+
+const BVH& Scene::getSphereBVH() const
+{
+   return sphereBVH;
+}
+
+const BVH& Scene::getBlockBVH() const
+{
+   return blockBVH;
+}
+
+const BVH& Scene::getPlaneBVH() const
+{
+   return planeBVH;
+}
+
+uint32_t Scene::getBoundedPlaneCount() const
+{
+   return boundedPlaneCount;
+}
+
+void Scene::intersectSpheres( const Ray& ray, PrimitiveHit& closest ) const
+{
+   traverse( sphereBVH, sphereWideBVH, sphereGrid, ray, closest.distance, [ & ]( uint32_t first, uint32_t count, float& closestDistance )
+   {
+      RAYTRACER_STAT( sphereTests, count );
+      if( SphereBatch::findClosest( spheres, first, count, ray, closestDistance, closest.index ) )
+         closest.type = SPHERE;
+      return false;
+   } );
+}
+
+void Scene::intersectBlocks( const Ray& ray, PrimitiveHit& closest ) const
+{
+   traverse( blockBVH, blockWideBVH, blockGrid, ray, closest.distance, [ & ]( uint32_t first, uint32_t count, float& closestDistance )
+   {
+      RAYTRACER_STAT( blockTests, count );
+      float distance;
+      for( auto i = first; i < first + count; ++i )
+      {
+         if( Intersection::blockDistance( ray, blocks.minPoint( i ), blocks.maxPoint( i ), distance ) && distance < closestDistance )
+         {
+            closestDistance = distance;
+            closest.type = BLOCK;
+            closest.index = i;
+         }
+      }
+      return false;
+   } );
+}
+
+void Scene::intersectPlanes( const Ray& ray, PrimitiveHit& closest ) const
+{
+   float distance;
+   RAYTRACER_STAT( planeTests, planes.size() - boundedPlaneCount );
+   for( size_t i = boundedPlaneCount; i < planes.size(); ++i )
+   {
+      if( planeDistance( ray, i, distance ) && distance < closest.distance )
+      {
+         closest.distance = distance;
+         closest.type = PLANE;
+         closest.index = static_cast<uint32_t>( i );
+      }
+   }
+
+   traverse( planeBVH, planeWideBVH, planeGrid, ray, closest.distance, [ & ]( uint32_t first, uint32_t count, float& closestDistance )
+   {
+      RAYTRACER_STAT( planeTests, count );
+      for( auto i = first; i < first + count; ++i )
+      {
+         if( planeDistance( ray, i, distance ) && distance < closestDistance )
+         {
+            closestDistance = distance;
+            closest.type = PLANE;
+            closest.index = i;
+         }
+      }
+      return false;
+   } );
+}
+
+bool Scene::planeDistance( const Ray& ray, size_t i, float& distance ) const
+{
+   return Intersection::planeDistance( ray, planes.center( i ), planes.normal( i ), planes.tangent( i ), planes.bitangent( i ),
+                                       planes.halfWidth[ i ], planes.halfDepth[ i ], distance );
+}
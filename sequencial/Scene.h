@@ -0,0 +1,482 @@
+//
+// Created by dominik on 17.10.26.
+//
+
+#ifndef SEQUENCIAL_SCENE_H
+#define SEQUENCIAL_SCENE_H
+
+#include "BVH.h"
+#include "MappedArray.h"
+#include "Material.h"
+#include "Objects.h"
+#include "Transform.h"
+#include "TriangleMesh.h"
+#include "UniformGrid.h"
+#include "WideBVH.h"
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+enum ObjectType : uint8_t
+{
+   SPHERE,
+   PLANE,
+   BLOCK,
+   MESH
+};
+
+// Spheres stored as structure of arrays. All arrays have the same size
+struct SphereArrays
+{
+   MappedArray<float> centerX, centerY, centerZ;
+   MappedArray<float> radius;
+   MappedArray<uint32_t> materialIndex;
+
+   [[nodiscard]] size_t size() const { return radius.size(); }
+
+   [[nodiscard]] Vector3f center( size_t i ) const { return { centerX[ i ], centerY[ i ], centerZ[ i ] }; }
+
+   [[nodiscard]] AABB bounds( size_t i ) const;
+
+   void reorder( const std::vector<uint32_t>& order );
+
+   // Calls the function with every array in a fixed order, e.g. to save or map them. Works with const arrays too
+   template<typename Arrays, typename Function>
+   static void forEachArray( Arrays& arrays, Function&& function )
+   {
+      function( arrays.centerX );
+      function( arrays.centerY );
+      function( arrays.centerZ );
+      function( arrays.radius );
+      function( arrays.materialIndex );
+   }
+};
+
+// Axis-aligned blocks stored as structure of arrays. All arrays have the same size
+struct BlockArrays
+{
+   MappedArray<float> minX, minY, minZ;
+   MappedArray<float> maxX, maxY, maxZ;
+   MappedArray<uint32_t> materialIndex;
+
+   [[nodiscard]] size_t size() const { return minX.size(); }
+
+   [[nodiscard]] Vector3f minPoint( size_t i ) const { return { minX[ i ], minY[ i ], minZ[ i ] }; }
+
+   [[nodiscard]] Vector3f maxPoint( size_t i ) const { return { maxX[ i ], maxY[ i ], maxZ[ i ] }; }
+
+   [[nodiscard]] AABB bounds( size_t i ) const { return { minPoint( i ), maxPoint( i ) }; }
+
+   void reorder( const std::vector<uint32_t>& order );
+
+   // Calls the function with every array in a fixed order, e.g. to save or map them. Works with const arrays too
+   template<typename Arrays, typename Function>
+   static void forEachArray( Arrays& arrays, Function&& function )
+   {
+      function( arrays.minX );
+      function( arrays.minY );
+      function( arrays.minZ );
+      function( arrays.maxX );
+      function( arrays.maxY );
+      function( arrays.maxZ );
+      function( arrays.materialIndex );
+   }
+};
+
+// Finite planes (rectangles) stored as structure of arrays. All arrays have the same size
+struct PlaneArrays
+{
+   MappedArray<float> centerX, centerY, centerZ;
+   MappedArray<float> normalX, normalY, normalZ;
+   MappedArray<float> tangentX, tangentY, tangentZ;
+   MappedArray<float> bitangentX, bitangentY, bitangentZ;
+   MappedArray<float> halfWidth, halfDepth;
+   MappedArray<uint32_t> materialIndex;
+
+   [[nodiscard]] size_t size() const { return centerX.size(); }
+
+   [[nodiscard]] Vector3f center( size_t i ) const { return { centerX[ i ], centerY[ i ], centerZ[ i ] }; }
+
+   [[nodiscard]] Vector3f normal( size_t i ) const { return { normalX[ i ], normalY[ i ], normalZ[ i ] }; }
+
+   [[nodiscard]] Vector3f tangent( size_t i ) const { return { tangentX[ i ], tangentY[ i ], tangentZ[ i ] }; }
+
+   [[nodiscard]] Vector3f bitangent( size_t i ) const { return { bitangentX[ i ], bitangentY[ i ], bitangentZ[ i ] }; }
+
+   [[nodiscard]] AABB bounds( size_t i ) const;
+
+   void reorder( const std::vector<uint32_t>& order );
+
+   // Calls the function with every array in a fixed order, e.g. to save or map them. Works with const arrays too
+   template<typename Arrays, typename Function>
+   static void forEachArray( Arrays& arrays, Function&& function )
+   {
+      function( arrays.centerX );
+      function( arrays.centerY );
+      function( arrays.centerZ );
+      function( arrays.normalX );
+      function( arrays.normalY );
+      function( arrays.normalZ );
+      function( arrays.tangentX );
+      function( arrays.tangentY );
+      function( arrays.tangentZ );
+      function( arrays.bitangentX );
+      function( arrays.bitangentY );
+      function( arrays.bitangentZ );
+      function( arrays.halfWidth );
+      function( arrays.halfDepth );
+      function( arrays.materialIndex );
+   }
+};
+
+// Triangle mesh placed in a scene. The geometry is shared with the scene objects and other scenes
+struct SceneMesh
+{
+   std::shared_ptr<const TriangleMesh> geometry;
+   uint32_t materialIndex = 0;
+};
+
+class Scene;
+
+// Instance of a shared prototype scene (the bottom level) placed in a scene by a transform
+struct SceneInstance
+{
+   std::shared_ptr<const Scene> prototype;
+   Transform transform;
+};
+
+/**
+ * @brief Scene representation used by the ray tracer
+ *
+ * Spheres, blocks, and planes are stored in separate contiguous structure-of-arrays containers, and the materials are referenced by index.
+ * The intersection is done type by type without any virtual dispatch or reference counting.
+ * Every bounded primitive type has its own BVH, and its arrays are reordered in the BVH order, so a BVH leaf is a contiguous range in the arrays.
+ * Infinite planes can't be put into the plane BVH, they are stored after the bounded planes and tested with every ray.
+ * Triangle meshes have their own BVHs over the triangles, the scene tests the mesh bounds and then traverses the mesh BVH.
+ *
+ * Repeated geometry is added as instances: a transform and a shared, already built prototype scene with its own BVHs (the bottom level).
+ * The scene has a top-level BVH over the world bounds of the instances, and a ray entering an instance is transformed into its object space.
+ * The memory grows with the unique prototypes, not with the instance count.
+ * Prototypes can't contain instances themselves or infinite planes.
+ *
+ * Spheres, blocks, and instances can be moved in a built scene (animation). refit then only updates the BVH nodes above the moved primitives,
+ * and a BVH is rebuilt only once the refitted tree got too much worse than a new one would be (see REBUILD_DEGRADATION).
+ *
+ * The BVHs can be replaced by uniform grids (setAccelerator), which suit evenly spread primitives of similar size and are built in O(N).
+ * The grids cover the spheres, blocks, and bounded planes. The meshes and instances keep their BVHs, and the packets are traced ray by ray.
+ * The wide BVHs (Accelerator::WIDE_BVH) are collapsed from the binary BVHs of the same primitives and test 4 or 8 children of a node at once.
+ *
+ * @note The scene is filled using the add methods (or from scene objects) and then build has to be called before tracing any rays.
+ * Alternatively, a built scene can be saved to a binary scene file and mapped back by SceneFile without a rebuild
+ */
+class Scene
+{
+   public:
+      // Closest primitive found by a ray, before the hit point and normal are calculated
+      struct PrimitiveHit
+      {
+         float distance = std::numeric_limits<float>::infinity();
+         ObjectType type = SPHERE;
+         // Primitive index, or the triangle index for meshes
+         uint32_t index = 0;
+         // Index of the mesh in getMeshes() for mesh hits
+         uint32_t mesh = 0;
+         // Index of the instance in getInstances() if the primitive is in a prototype
+         uint32_t instance = NO_INSTANCE;
+
+         static constexpr uint32_t NO_INSTANCE = UINT32_MAX;
+
+         [[nodiscard]] bool isHit() const
+         {
+            return distance != std::numeric_limits<float>::infinity();
+         }
+      };
+
+      // Acceleration structure of the spheres, blocks, and bounded planes
+      enum class Accelerator : uint8_t
+      {
+         BVH,
+         // BVH with the SIMD width of children per node. The binary BVH is used without SIMD
+         WIDE_BVH,
+         // Uniform grid. Hashed for mostly empty worlds, dense otherwise
+         GRID,
+         HASHED_GRID
+      };
+
+      // A refitted BVH is rebuilt once its SAH cost grows by this factor
+      static constexpr float REBUILD_DEGRADATION = 1.5f;
+
+      Scene() = default;
+
+      /**
+       * @brief Creates and builds a scene from a list of scene objects
+       * @param objects A list of objects in a scene
+       */
+      explicit Scene( const std::vector<std::shared_ptr<SceneObject>>& objects );
+
+      /**
+       * @return Index of the added material
+       */
+      uint32_t addMaterial( const Material& material );
+
+      /**
+       * @return Index of the sphere. It stays valid for moveSphere even though build reorders the spheres
+       */
+      uint32_t addSphere( const Vector3f& center, float radius, uint32_t materialIndex );
+
+      /**
+       * @brief Adds a rectangle. See Plane::tangentFrame for the tangent and bitangent. Infinite half sizes make an infinite plane
+       * @return Index of the plane
+       */
+      uint32_t addPlane( const Vector3f& center, const Vector3f& normal, const Vector3f& tangent, const Vector3f& bitangent,
+                         float halfWidth, float halfDepth, uint32_t materialIndex );
+
+      /**
+       * @return Index of the block. It stays valid for moveBlock even though build reorders the blocks
+       */
+      uint32_t addBlock( const Vector3f& minPoint, const Vector3f& maxPoint, uint32_t materialIndex );
+
+      /**
+       * @brief Adds a triangle mesh. The geometry is shared, not copied
+       * @return Index of the mesh
+       */
+      uint32_t addMesh( std::shared_ptr<const TriangleMesh> geometry, uint32_t materialIndex );
+
+      /**
+       * @brief Adds an instance of a built prototype scene. The prototype is shared, not copied, and keeps its own materials
+       * @return Index of the instance
+       * @throws std::runtime_error If the prototype contains instances or infinite planes
+       */
+      uint32_t addInstance( std::shared_ptr<const Scene> prototype, const Transform& transform );
+
+      /**
+       * @brief Moves a sphere of a built scene. refit has to be called before tracing rays again
+       * @param sphere Index returned by addSphere, or the index in the scene file for mapped scenes
+       */
+      void moveSphere( uint32_t sphere, const Vector3f& center, float radius );
+
+      /**
+       * @brief Moves or resizes a block of a built scene. refit has to be called before tracing rays again
+       * @param block Index returned by addBlock, or the index in the scene file for mapped scenes
+       */
+      void moveBlock( uint32_t block, const Vector3f& minPoint, const Vector3f& maxPoint );
+
+      /**
+       * @brief Moves an instance. refit (or buildInstances) has to be called before tracing rays again
+       */
+      void setInstanceTransform( uint32_t instance, const Transform& transform );
+
+      /**
+       * @brief Updates the BVHs after the primitives were moved. Costs O(moved primitives) with Accelerator::BVH and WIDE_BVH,
+       * unless a BVH degraded and is rebuilt
+       *
+       * Only the BVH nodes above the moved primitives are refitted, and the wide BVH nodes copy their new bounds.
+       * A BVH whose SAH cost grew by REBUILD_DEGRADATION is rebuilt, the BVHs of the other primitive types are kept.
+       * The grids aren't refitted: the grid of a primitive type with moved primitives is built again in O(N)
+       * @warning A rebuild reorders the primitive arrays like build. The indices returned by the add methods stay valid
+       */
+      void refit();
+
+      /**
+       * @brief Moves the primitives of changed objects of a scene created from the objects, then calls refit
+       * @param objects The objects the scene was created from, some of them moved
+       * @param changed Indices of the moved objects in objects
+       * @throws std::runtime_error If a changed object can't be moved, see SceneObject::updateInScene
+       */
+      void update( const std::vector<std::shared_ptr<SceneObject>>& objects, const std::vector<size_t>& changed );
+
+      /**
+       * @brief Builds the acceleration structures. Has to be called after adding all the primitives
+       * @warning Reorders the primitive arrays
+       */
+      void build();
+
+      /**
+       * @brief Rebuilds only the top-level BVH over the instances, e.g. after they were moved. Called by build
+       */
+      void buildInstances();
+
+      /**
+       * @brief Switches the acceleration structure of a built scene. The grids are built in O(N) over the current primitive arrays,
+       * the wide BVHs are collapsed from the binary BVHs
+       *
+       * The BVHs are kept with the other accelerators, since they give the scene bounds and are saved in scene files. The others aren't saved.
+       * The grids make refit O(N) in the primitives of the moved types, see refit
+       */
+      void setAccelerator( Accelerator accelerator );
+
+      [[nodiscard]] Accelerator getAccelerator() const;
+
+      /**
+       * @brief Finds the closest intersection of a ray with the scene
+       * @param ray The ray to trace
+       * @param result Out parameter with the closest hit. The hit point and normal are only calculated for the closest primitive
+       * @param material Out parameter with the material of the closest primitive
+       * @return True if the ray hits anything
+       */
+      bool intersect( const Ray& ray, RayHitResult& result, const Material*& material ) const;
+
+      /**
+       * @brief Finds the closest primitive hit by a ray without calculating the hit point and normal
+       * @param ray The ray to trace
+       * @param closest In/out parameter. Only primitives closer than closest.distance are considered
+       */
+      void findClosest( const Ray& ray, PrimitiveHit& closest ) const;
+
+      /**
+       * @brief The mesh part of findClosest. Used by the packet queries, which handle the other primitive types themselves
+       */
+      void findClosestMesh( const Ray& ray, PrimitiveHit& closest ) const;
+
+      /**
+       * @brief The instance part of findClosest. Used by the packet queries like findClosestMesh
+       */
+      void findClosestInstance( const Ray& ray, PrimitiveHit& closest ) const;
+
+      /**
+       * @brief Calculates the hit point, normal, and material for a hit found by findClosest (or a packet query)
+       * @param ray The ray which found the hit
+       * @param hit The closest primitive. Has to be a hit
+       * @param result Out parameter with the hit data
+       * @param material Out parameter with the material of the primitive
+       */
+      void resolveHit( const Ray& ray, const PrimitiveHit& hit, RayHitResult& result, const Material*& material ) const;
+
+      /**
+       * @brief Any-hit query. Stops at the first primitive closer than maxDistance
+       * @return True if any primitive intersects the ray closer than maxDistance
+       */
+      [[nodiscard]] bool isOccluded( const Ray& ray, float maxDistance ) const;
+
+      [[nodiscard]] const MappedArray<Material>& getMaterials() const;
+
+      [[nodiscard]] const SphereArrays& getSpheres() const;
+
+      [[nodiscard]] const PlaneArrays& getPlanes() const;
+
+      [[nodiscard]] const BlockArrays& getBlocks() const;
+
+      [[nodiscard]] const std::vector<SceneMesh>& getMeshes() const;
+
+      [[nodiscard]] const std::vector<SceneInstance>& getInstances() const;
+
+      /**
+       * @return Bounds of all primitives. Infinite if the scene has infinite planes
+       */
+      [[nodiscard]] AABB getBounds() const;
+
+      /**
+       * @return Number of primitives rendered, every triangle and every primitive of every instance counts
+       */
+      [[nodiscard]] size_t getPrimitiveCount() const;
+
+      [[nodiscard]] const BVH& getSphereBVH() const;
+
+      [[nodiscard]] const BVH& getBlockBVH() const;
+
+      [[nodiscard]] const BVH& getPlaneBVH() const;
+
+      [[nodiscard]] const WideBVH& getSphereWideBVH() const;
+
+      [[nodiscard]] const WideBVH& getBlockWideBVH() const;
+
+      [[nodiscard]] const WideBVH& getPlaneWideBVH() const;
+
+      [[nodiscard]] const UniformGrid& getSphereGrid() const;
+
+      [[nodiscard]] const UniformGrid& getBlockGrid() const;
+
+      [[nodiscard]] const UniformGrid& getPlaneGrid() const;
+
+      /**
+       * @return Number of planes in the plane BVH. The planes from this index to the end are infinite
+       */
+      [[nodiscard]] uint32_t getBoundedPlaneCount() const;
+
+   private:
+      // Saves and maps the arrays and BVHs directly
+      friend class SceneFile;
+
+      void intersectSpheres( const Ray& ray, PrimitiveHit& closest ) const;
+
+      void intersectBlocks( const Ray& ray, PrimitiveHit& closest ) const;
+
+      void intersectPlanes( const Ray& ray, PrimitiveHit& closest ) const;
+
+      [[nodiscard]] bool planeDistance( const Ray& ray, size_t i, float& distance ) const;
+
+      void buildSpheres();
+
+      void buildBlocks();
+
+      void buildPlanes();
+
+      // Builds the wide BVHs or the grids of the primitive types whose flag is set, depending on the accelerator
+      void buildAccelerators( bool buildSpheres, bool buildBlocks, bool buildPlanes );
+
+      // Traverses the BVH, the wide BVH, or the grid of a primitive type, depending on the accelerator
+      template<typename LeafFunction>
+      bool traverse( const BVH& bvh, const WideBVH& wideBVH, const UniformGrid& grid, const Ray& ray, float& maxDistance,
+                     LeafFunction&& leafFunction ) const;
+
+      // World bounds of an instance
+      [[nodiscard]] AABB instanceBounds( uint32_t instance ) const;
+
+      MappedArray<Material> materials;
+      SphereArrays spheres;
+      PlaneArrays planes;
+      BlockArrays blocks;
+      std::vector<SceneMesh> meshes;
+      // Bounds of the meshes, so a ray skips a mesh without touching its BVH
+      std::vector<AABB> meshBounds;
+      std::vector<SceneInstance> instances;
+      // Top-level BVH. The instances keep their order, the leaves index them through getPrimitiveIndices
+      BVH instanceBVH;
+      BVH sphereBVH;
+      BVH blockBVH;
+      BVH planeBVH;
+      uint32_t boundedPlaneCount = 0;
+      Accelerator accelerator = Accelerator::BVH;
+      // Empty unless the accelerator is the wide BVH
+      WideBVH sphereWideBVH;
+      WideBVH blockWideBVH;
+      WideBVH planeWideBVH;
+      // Empty unless the accelerator is a grid
+      UniformGrid sphereGrid;
+      UniformGrid blockGrid;
+      UniformGrid planeGrid;
+      // Positions in the arrays (or in the BVH order for instances) by the index returned by the add methods.
+      // Empty if the arrays weren't reordered, e.g. in mapped scenes
+      std::vector<uint32_t> sphereLocations;
+      std::vector<uint32_t> blockLocations;
+      std::vector<uint32_t> instanceLocations;
+      // Positions of the primitives moved since the last refit
+      std::vector<uint32_t> movedSpheres;
+      std::vector<uint32_t> movedBlocks;
+      std::vector<uint32_t> movedInstances;
+      // Index of every scene object among the primitives of its type, for scenes created from objects
+      std::vector<uint32_t> objectIndices;
+      // Keeps the mapped scene file alive while the arrays view it. Null if the scene owns its arrays
+      std::shared_ptr<void> mapping;
+};
+
+template<typename LeafFunction>
+bool Scene::traverse( const BVH& bvh, const WideBVH& wideBVH, const UniformGrid& grid, const Ray& ray, float& maxDistance,
+                      LeafFunction&& leafFunction ) const
+{
+   switch( accelerator )
+   {
+      case Accelerator::GRID:
+      case Accelerator::HASHED_GRID:
+         return grid.traverse( ray, maxDistance, leafFunction );
+      case Accelerator::WIDE_BVH:
+         if( !wideBVH.isEmpty() )
+            return wideBVH.traverse( ray.startPoint, ray.inverseDirection, maxDistance, leafFunction );
+         break;
+      case Accelerator::BVH:
+         break;
+   }
+   return bvh.traverse( ray.startPoint, ray.inverseDirection, maxDistance, leafFunction );
+}
+
+#endif //SEQUENCIAL_SCENE_H
@@ -0,0 +1,52 @@
+//
+// Created by dominik on 18.10.26.
+//
+
+#include "Levels.h"
+#include "SceneFile.h"
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <string>
+
+/**
+ * @brief Converts a built-in level, a JSON scene, or a procedural level into a binary scene file, which the renderer maps instead of parsing and building the scene
+ *
+ * Usage: sceneconvert <level ID|scene.json|procedural level> <output.rtscene> [--no-bvh]
+ */
+int main( int argc, char** argv )
+{
+   if( argc < 3 || argc > 4 || ( argc == 4 && std::string( argv[ 3 ] ) != "--no-bvh" ) )
+   {
+      std::cout << "Usage: " << argv[ 0 ] << " <level ID|scene.json|procedural level> <output.rtscene> [--no-bvh]" << std::endl;
+      std::cout << "--no-bvh leaves the BVHs out of the file, they are built when it's loaded" << std::endl;
+      return -1;
+   }
+
+   std::string levelArgument = argv[ 1 ];
+   std::string outputPath = argv[ 2 ];
+   bool includeBVH = argc == 3;
+
+   try
+   {
+      auto start = std::chrono::high_resolution_clock::now();
+
+      TracerOptions options;
+      std::vector<Light> lights;
+      Scene scene = createLevel( levelArgument )->loadScene( options, lights );
+
+      auto built = std::chrono::high_resolution_clock::now();
+      SceneFile::save( outputPath, options, scene, lights, includeBVH );
+      auto end = std::chrono::high_resolution_clock::now();
+
+      std::cout << "Loaded and built the scene in " <<
+            std::chrono::duration_cast<std::chrono::milliseconds>( built - start ).count() << " ms" << std::endl;
+      std::cout << "Wrote " << outputPath << " (" << std::filesystem::file_size( outputPath ) << " bytes) in " <<
+            std::chrono::duration_cast<std::chrono::milliseconds>( end - built ).count() << " ms" << std::endl;
+   }
+   catch( const std::exception& error )
+   {
+      std::cerr << error.what() << std::endl;
+      return -1;
+   }
+}
@@ -0,0 +1,348 @@
+//
+// Created by dominik on 18.10.26.
+//
+
+#include "SceneFile.h"
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+   [[noreturn]] void invalidFile( const std::string& path, const std::string& reason )
+   {
+      throw std::runtime_error( path + ": " + reason );
+   }
+
+   // Calls the function with every primitive array of the scene in the file order
+   template<typename Function>
+   void forEachPrimitiveArray( auto& spheres, auto& blocks, auto& planes, Function&& function )
+   {
+      SphereArrays::forEachArray( spheres, function );
+      BlockArrays::forEachArray( blocks, function );
+      PlaneArrays::forEachArray( planes, function );
+   }
+
+   // Checks that every index is below the count
+   template<typename Indices>
+   bool indicesBelow( const Indices& indices, size_t count )
+   {
+      return std::all_of( indices.begin(), indices.end(), [ count ]( uint32_t index ) { return index < count; } );
+   }
+
+   // Checks that all arrays of a primitive type have the same size
+   template<typename Arrays>
+   bool haveSameSize( const Arrays& arrays )
+   {
+      bool same = true;
+      Arrays::forEachArray( arrays, [ & ]( const auto& array )
+      {
+         same = same && array.size() == arrays.size();
+      } );
+      return same;
+   }
+}
+
+uint32_t SceneFile::bodySectionCount( bool hasBVH )
+{
+   SphereArrays spheres;
+   BlockArrays blocks;
+   PlaneArrays planes;
+   // Scene info, materials, and the mesh table
+   uint32_t count = 3;
+   forEachPrimitiveArray( spheres, blocks, planes, [ & ]( const auto& )
+   {
+      ++count;
+   } );
+   return count + ( hasBVH ? 3 : 0 );
+}
+
+void SceneFile::save( const std::string& path, const TracerOptions& options, const Scene& scene, const std::vector<Light>& lights,
+                      bool includeBVH )
+{
+   struct Data
+   {
+      const void* data;
+      uint64_t size;
+   };
+   std::vector<Data> data;
+   auto addArray = [ & ]( const auto& array )
+   {
+      data.push_back( { array.data(), array.size() * sizeof( array[ 0 ] ) } );
+   };
+
+   // Every prototype and geometry is stored once, however many instances and meshes use it
+   std::vector<const Scene*> prototypes;
+   std::map<const Scene*, uint32_t> prototypeIndices;
+   std::vector<InstanceEntry> instanceTable;
+   for( const auto& instance: scene.instances )
+   {
+      auto [ entry, isNew ] = prototypeIndices.emplace( instance.prototype.get(), static_cast<uint32_t>( prototypes.size() ) );
+      if( isNew )
+         prototypes.push_back( instance.prototype.get() );
+      instanceTable.push_back( { entry->second, 0, instance.transform } );
+   }
+
+   std::vector<const TriangleMesh*> geometries;
+   std::map<const TriangleMesh*, uint32_t> geometryIndices;
+   std::vector<std::vector<MeshEntry>> meshTables;
+   std::vector<const Scene*> bodies = prototypes;
+   bodies.push_back( &scene );
+   for( const auto* body: bodies )
+   {
+      auto& meshTable = meshTables.emplace_back();
+      for( const auto& mesh: body->meshes )
+      {
+         auto [ entry, isNew ] = geometryIndices.emplace( mesh.geometry.get(), static_cast<uint32_t>( geometries.size() ) );
+         if( isNew )
+            geometries.push_back( mesh.geometry.get() );
+         meshTable.push_back( { entry->second, mesh.materialIndex } );
+      }
+   }
+
+   data.push_back( { &options, sizeof( options ) } );
+   addArray( lights );
+   for( const auto* geometry: geometries )
+   {
+      addArray( geometry->vertices );
+      addArray( geometry->indices );
+      addArray( geometry->normals );
+      addArray( geometry->normalIndices );
+      addArray( geometry->bvh.getNodes() );
+   }
+
+   std::vector<BodyInfo> infos;
+   infos.reserve( bodies.size() );
+   for( size_t i = 0; i < bodies.size(); ++i )
+   {
+      const Scene& body = *bodies[ i ];
+      infos.push_back( { body.boundedPlaneCount, 0 } );
+      data.push_back( { &infos.back(), sizeof( BodyInfo ) } );
+      addArray( body.materials );
+      forEachPrimitiveArray( body.spheres, body.blocks, body.planes, addArray );
+      addArray( meshTables[ i ] );
+      if( includeBVH )
+      {
+         addArray( body.sphereBVH.getNodes() );
+         addArray( body.blockBVH.getNodes() );
+         addArray( body.planeBVH.getNodes() );
+      }
+   }
+   addArray( instanceTable );
+
+   Header header{};
+   std::memcpy( header.magic, MAGIC, sizeof( MAGIC ) );
+   header.version = VERSION;
+   header.byteOrder = BYTE_ORDER_MARK;
+   header.optionsSize = sizeof( TracerOptions );
+   header.lightSize = sizeof( Light );
+   header.materialSize = sizeof( Material );
+   header.nodeSize = sizeof( BVH::Node );
+   header.instanceSize = sizeof( InstanceEntry );
+   header.sectionCount = static_cast<uint32_t>( data.size() );
+   header.flags = includeBVH ? HAS_BVH : 0;
+   header.geometryCount = static_cast<uint32_t>( geometries.size() );
+   header.prototypeCount = static_cast<uint32_t>( prototypes.size() );
+
+   std::vector<Section> sections;
+   uint64_t offset = sizeof( Header ) + data.size() * sizeof( Section );
+   for( const auto& section: data )
+   {
+      offset = ( offset + SECTION_ALIGNMENT - 1 ) / SECTION_ALIGNMENT * SECTION_ALIGNMENT;
+      sections.push_back( { offset, section.size } );
+      offset += section.size;
+   }
+
+   std::ofstream file( path, std::ios::binary );
+   if( !file )
+      throw std::runtime_error( "Couldn't open " + path + " for writing" );
+
+   file.write( reinterpret_cast<const char*>( &header ), sizeof( header ) );
+   file.write( reinterpret_cast<const char*>( sections.data() ), static_cast<std::streamsize>( sections.size() * sizeof( Section ) ) );
+   static constexpr char padding[ SECTION_ALIGNMENT ] = {};
+   uint64_t position = sizeof( Header ) + sections.size() * sizeof( Section );
+   for( size_t i = 0; i < data.size(); ++i )
+   {
+      file.write( padding, static_cast<std::streamsize>( sections[ i ].offset - position ) );
+      file.write( static_cast<const char*>( data[ i ].data ), static_cast<std::streamsize>( data[ i ].size ) );
+      position = sections[ i ].offset + data[ i ].size;
+   }
+
+   if( !file.flush() )
+      throw std::runtime_error( "Couldn't write " + path );
+}
+
+Scene SceneFile::load( const std::string& path, TracerOptions& options, std::vector<Light>& lights )
+{
+   int descriptor = open( path.c_str(), O_RDONLY );
+   if( descriptor < 0 )
+      throw std::runtime_error( "Couldn't open " + path );
+
+   struct stat status{};
+   if( fstat( descriptor, &status ) != 0 || static_cast<size_t>( status.st_size ) < sizeof( Header ) )
+   {
+      close( descriptor );
+      invalidFile( path, "Not a scene file" );
+   }
+   auto fileSize = static_cast<size_t>( status.st_size );
+
+   // A private writable mapping, so the arrays can be modified (e.g. reordered) without touching the file. Pages are only copied when written
+   void* address = mmap( nullptr, fileSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, descriptor, 0 );
+   close( descriptor );
+   if( address == MAP_FAILED )
+      throw std::runtime_error( "Couldn't map " + path );
+   std::shared_ptr<void> mapping( address, [ fileSize ]( void* pointer )
+   {
+      munmap( pointer, fileSize );
+   } );
+   auto* bytes = static_cast<unsigned char*>( address );
+
+   Header header{};
+   std::memcpy( &header, bytes, sizeof( header ) );
+   if( std::memcmp( header.magic, MAGIC, sizeof( MAGIC ) ) != 0 )
+      invalidFile( path, "Not a scene file" );
+   if( header.version != VERSION )
+      invalidFile( path, "Unsupported version " + std::to_string( header.version ) + ", convert the scene again" );
+   if( header.byteOrder != BYTE_ORDER_MARK || header.optionsSize != sizeof( TracerOptions ) || header.lightSize != sizeof( Light ) ||
+       header.materialSize != sizeof( Material ) || header.nodeSize != sizeof( BVH::Node ) || header.instanceSize != sizeof( InstanceEntry ) )
+      invalidFile( path, "Written by an incompatible build, convert the scene again" );
+
+   bool hasBVH = header.flags & HAS_BVH;
+   // Options, lights, and the instance table, the geometries, and the bodies
+   uint64_t expectedSections = 3 + static_cast<uint64_t>( header.geometryCount ) * GEOMETRY_SECTION_COUNT +
+                               ( static_cast<uint64_t>( header.prototypeCount ) + 1 ) * bodySectionCount( hasBVH );
+   if( header.sectionCount != expectedSections ||
+       fileSize - sizeof( Header ) < header.sectionCount * sizeof( Section ) )
+      invalidFile( path, "Invalid section table" );
+   std::vector<Section> sections( header.sectionCount );
+   std::memcpy( sections.data(), bytes + sizeof( Header ), sections.size() * sizeof( Section ) );
+
+   // Returns the next section and its element count
+   size_t nextSection = 0;
+   auto section = [ & ]( size_t elementSize )
+   {
+      const Section& current = sections[ nextSection++ ];
+      if( current.offset % SECTION_ALIGNMENT != 0 || current.offset > fileSize || current.size > fileSize - current.offset ||
+          current.size % elementSize != 0 )
+         invalidFile( path, "Invalid section " + std::to_string( nextSection - 1 ) );
+      return std::pair{ bytes + current.offset, static_cast<size_t>( current.size / elementSize ) };
+   };
+   auto mapArray = [ & ]( auto& array )
+   {
+      using Element = typename std::remove_reference_t<decltype( array )>::value_type;
+      auto [ data, count ] = section( sizeof( Element ) );
+      array = MappedArray<Element>::view( reinterpret_cast<Element*>( data ), count );
+   };
+
+   auto [ storedOptions, optionsCount ] = section( sizeof( TracerOptions ) );
+   if( optionsCount != 1 )
+      invalidFile( path, "Invalid options" );
+   std::memcpy( &options, storedOptions, sizeof( TracerOptions ) );
+
+   // The lights are few and the ray tracer takes them as a vector, so they are copied
+   auto [ storedLights, lightCount ] = section( sizeof( Light ) );
+   auto* firstLight = reinterpret_cast<const Light*>( storedLights );
+   lights.assign( firstLight, firstLight + lightCount );
+
+   std::vector<std::shared_ptr<const TriangleMesh>> geometries;
+   for( uint32_t i = 0; i < header.geometryCount; ++i )
+   {
+      // The geometry may outlive the scene in a scene object, so it keeps the mapping alive too
+      std::shared_ptr<TriangleMesh> geometry( new TriangleMesh(), [ mapping ]( TriangleMesh* pointer )
+      {
+         delete pointer;
+      } );
+      mapArray( geometry->vertices );
+      mapArray( geometry->indices );
+      mapArray( geometry->normals );
+      mapArray( geometry->normalIndices );
+      MappedArray<BVH::Node> nodes;
+      mapArray( nodes );
+      geometry->bvh = BVH( std::move( nodes ) );
+      // The same checks as the TriangleMesh constructor, which the mapped buffers bypass
+      if( geometry->indices.size() % 3 != 0 ||
+          ( !geometry->normals.empty() && geometry->normalIndices.size() != geometry->indices.size() ) ||
+          !indicesBelow( geometry->indices, geometry->vertices.size() ) ||
+          !indicesBelow( geometry->normalIndices, geometry->normals.size() ) ||
+          !geometry->bvh.isValid( geometry->indices.size() / 3 ) )
+         invalidFile( path, "Invalid mesh geometry " + std::to_string( i ) );
+      geometries.push_back( std::move( geometry ) );
+   }
+
+   // Maps the arrays of a prototype or the scene itself
+   auto loadBody = [ & ]( Scene& body )
+   {
+      auto [ storedInfo, infoCount ] = section( sizeof( BodyInfo ) );
+      if( infoCount != 1 )
+         invalidFile( path, "Invalid scene info" );
+      BodyInfo info{};
+      std::memcpy( &info, storedInfo, sizeof( BodyInfo ) );
+
+      mapArray( body.materials );
+      forEachPrimitiveArray( body.spheres, body.blocks, body.planes, mapArray );
+      if( !haveSameSize( body.spheres ) || !haveSameSize( body.blocks ) || !haveSameSize( body.planes ) )
+         invalidFile( path, "The primitive arrays have different sizes" );
+      if( !indicesBelow( body.spheres.materialIndex, body.materials.size() ) ||
+          !indicesBelow( body.blocks.materialIndex, body.materials.size() ) ||
+          !indicesBelow( body.planes.materialIndex, body.materials.size() ) )
+         invalidFile( path, "Invalid material index" );
+
+      MappedArray<MeshEntry> meshTable;
+      mapArray( meshTable );
+      for( const auto& entry: meshTable )
+      {
+         if( entry.geometry >= geometries.size() || entry.materialIndex >= body.materials.size() )
+            invalidFile( path, "Invalid mesh table" );
+         body.addMesh( geometries[ entry.geometry ], entry.materialIndex );
+      }
+
+      if( hasBVH )
+      {
+         MappedArray<BVH::Node> nodes;
+         mapArray( nodes );
+         body.sphereBVH = BVH( std::move( nodes ) );
+         mapArray( nodes );
+         body.blockBVH = BVH( std::move( nodes ) );
+         mapArray( nodes );
+         body.planeBVH = BVH( std::move( nodes ) );
+         if( info.boundedPlaneCount > body.planes.size() )
+            invalidFile( path, "Invalid number of bounded planes" );
+         body.boundedPlaneCount = info.boundedPlaneCount;
+         if( !body.sphereBVH.isValid( body.spheres.size() ) || !body.blockBVH.isValid( body.blocks.size() ) ||
+             !body.planeBVH.isValid( body.boundedPlaneCount ) )
+            invalidFile( path, "Invalid BVH" );
+      }
+      else
+         body.build();
+      body.mapping = mapping;
+   };
+
+   std::vector<std::shared_ptr<const Scene>> prototypes;
+   for( uint32_t i = 0; i < header.prototypeCount; ++i )
+   {
+      auto prototype = std::make_shared<Scene>();
+      loadBody( *prototype );
+      prototypes.push_back( std::move( prototype ) );
+   }
+
+   Scene scene;
+   loadBody( scene );
+
+   MappedArray<InstanceEntry> instanceTable;
+   mapArray( instanceTable );
+   for( const auto& entry: instanceTable )
+   {
+      if( entry.prototype >= prototypes.size() )
+         invalidFile( path, "Invalid instance table" );
+      scene.addInstance( prototypes[ entry.prototype ], entry.transform );
+   }
+   // The top level is small, it's always built after loading
+   scene.buildInstances();
+   return scene;
+}
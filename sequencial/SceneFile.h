@@ -0,0 +1,112 @@
+//
+// Created by dominik on 18.10.26.
+//
+
+#ifndef SEQUENCIAL_SCENEFILE_H
+#define SEQUENCIAL_SCENEFILE_H
+
+#include "Scene.h"
+#include "TracerOptions.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Binary scene file (.rtscene), a cache of a built Scene together with its options and lights
+ *
+ * The file is a header, a table of sections, and the sections themselves, each aligned to 64 bytes:
+ * the options, the lights, the buffers of every unique mesh geometry (vertices, indices, normals, normal indices, and BVH nodes),
+ * the body of every unique instance prototype and then the body of the scene itself, and the instance table.
+ * A body is the scene info, materials, the sphere, block, and plane arrays (in the forEachArray order), the mesh table, and optionally the nodes of the three BVHs.
+ * A geometry used by several meshes or a prototype used by several instances is stored once, and the loaded scene shares it again.
+ * Everything is stored exactly as it is in memory, so loading maps the file and the scene arrays view the mapping. Nothing is parsed or copied,
+ * and the pages are only read when the rays touch them.
+ * Without the BVH sections the scene BVHs are built after loading, which copies the arrays into the BVH order.
+ * The mesh BVHs are always stored, the triangles are already in their order. The top-level BVH over the instances is always built after loading.
+ *
+ * The file is meant to be used on the machine which wrote it. Files from another version, byte order, or structure layout are rejected.
+ * Only the structure of the file is checked, not the stored values (e.g. material indices), it's a cache written by save, not an exchange format
+ */
+class SceneFile
+{
+   public:
+      /**
+       * @brief Writes a built scene into a file
+       * @param includeBVH Stores the BVHs too, so the loaded scene doesn't have to be built
+       * @throws std::runtime_error If the file can't be written
+       */
+      static void save( const std::string& path, const TracerOptions& options, const Scene& scene, const std::vector<Light>& lights,
+                        bool includeBVH = true );
+
+      /**
+       * @brief Maps a scene file. The scene keeps the file mapped as long as it (or any copy of it) exists
+       * @param options Out parameter with the stored options
+       * @param lights Out parameter with the stored lights
+       * @throws std::runtime_error If the file can't be mapped or isn't a valid scene file
+       */
+      static Scene load( const std::string& path, TracerOptions& options, std::vector<Light>& lights );
+
+      static constexpr uint32_t VERSION = 3;
+
+   private:
+      static constexpr char MAGIC[ 8 ] = { 'R', 'T', 'S', 'C', 'E', 'N', 'E', '\0' };
+      // Written in the native byte order, a file from a machine with the other byte order reads it reversed
+      static constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+      static constexpr uint64_t SECTION_ALIGNMENT = 64;
+      static constexpr uint32_t HAS_BVH = 1;
+
+      struct Header
+      {
+         char magic[ 8 ];
+         uint32_t version;
+         uint32_t byteOrder;
+         // Sizes of the stored structures. A different size means a different layout
+         uint32_t optionsSize;
+         uint32_t lightSize;
+         uint32_t materialSize;
+         uint32_t nodeSize;
+         uint32_t instanceSize;
+         uint32_t sectionCount;
+         uint32_t flags;
+         // Number of unique mesh geometries and instance prototypes
+         uint32_t geometryCount;
+         uint32_t prototypeCount;
+      };
+
+      struct Section
+      {
+         // Offset from the start of the file and the size, both in bytes
+         uint64_t offset;
+         uint64_t size;
+      };
+
+      // Entry of the mesh table
+      struct MeshEntry
+      {
+         uint32_t geometry;
+         uint32_t materialIndex;
+      };
+
+      // Entry of the instance table
+      struct InstanceEntry
+      {
+         uint32_t prototype;
+         uint32_t reserved;
+         Transform transform;
+      };
+
+      // The first section of a body
+      struct BodyInfo
+      {
+         uint32_t boundedPlaneCount;
+         uint32_t reserved;
+      };
+
+      // Sections of one mesh geometry: vertices, indices, normals, normal indices, and BVH nodes
+      static constexpr uint32_t GEOMETRY_SECTION_COUNT = 5;
+
+      // Number of sections of a scene or prototype body
+      static uint32_t bodySectionCount( bool hasBVH );
+};
+
+#endif //SEQUENCIAL_SCENEFILE_H
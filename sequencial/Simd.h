@@ -0,0 +1,134 @@
+//
+// Created by dominik on 17.10.26.
+//
+
+#ifndef SEQUENCIAL_SIMD_H
+#define SEQUENCIAL_SIMD_H
+
+/**
+ * @brief Thin wrappers over the SSE and AVX2 float registers used by the SIMD kernels
+ *
+ * The kernels are written once as templates over the register type (Float4 for SSE, Float8 for AVX2) and compiled for both instruction sets.
+ * SSE2 is part of x86-64, so Float4 is always available there. AVX2 code is only compiled inside the SIMD_AVX2_BEGIN / SIMD_AVX2_END region,
+ * so the rest of the program doesn't need to be built with -mavx2, and it's only called when the CPU supports it (see Simd::hasAVX2).
+ *
+ * The min and max functions follow the std::min / std::max semantics (including NaNs), so the SIMD kernels give the same results as the scalar code
+ */
+
+#if defined( __GNUC__ ) && ( defined( __x86_64__ ) || defined( __i386__ ) )
+#define SIMD_X86 1
+#include <immintrin.h>
+#else
+#define SIMD_X86 0
+#endif
+
+#if SIMD_X86 && defined( __clang__ )
+#define SIMD_AVX2_BEGIN _Pragma( "clang attribute push (__attribute__((target(\"avx2\"))), apply_to = function)" )
+#define SIMD_AVX2_END _Pragma( "clang attribute pop" )
+#elif SIMD_X86
+#define SIMD_AVX2_BEGIN _Pragma( "GCC push_options" ) _Pragma( "GCC target(\"avx2\")" )
+#define SIMD_AVX2_END _Pragma( "GCC pop_options" )
+#endif
+
+namespace Simd
+{
+   /**
+    * @return True if the CPU supports AVX2. Checked once using CPUID
+    */
+   inline bool hasAVX2()
+   {
+#if SIMD_X86
+      static const bool supported = __builtin_cpu_supports( "avx2" );
+      return supported;
+#else
+      return false;
+#endif
+   }
+
+   /**
+    * @return The widest SIMD width for floats supported by the CPU. 8 for AVX2, 4 for SSE, and 1 when no SIMD kernels are available
+    */
+   inline unsigned int detectWidth()
+   {
+#if SIMD_X86
+      return hasAVX2() ? 8u : 4u;
+#else
+      return 1u;
+#endif
+   }
+
+#if SIMD_X86
+   struct Float4
+   {
+      static constexpr int WIDTH = 4;
+      __m128 v;
+
+      static Float4 broadcast( float value ) { return { _mm_set1_ps( value ) }; }
+      static Float4 load( const float* data ) { return { _mm_loadu_ps( data ) }; }
+      void store( float* data ) const { _mm_storeu_ps( data, v ); }
+
+      friend Float4 operator+( Float4 a, Float4 b ) { return { _mm_add_ps( a.v, b.v ) }; }
+      friend Float4 operator-( Float4 a, Float4 b ) { return { _mm_sub_ps( a.v, b.v ) }; }
+      friend Float4 operator*( Float4 a, Float4 b ) { return { _mm_mul_ps( a.v, b.v ) }; }
+      friend Float4 operator/( Float4 a, Float4 b ) { return { _mm_div_ps( a.v, b.v ) }; }
+      friend Float4 operator-( Float4 a ) { return { _mm_xor_ps( a.v, _mm_set1_ps( -0.f ) ) }; }
+
+      // Same as std::min( a, b ): ( b < a ) ? b : a
+      friend Float4 min( Float4 a, Float4 b ) { return { _mm_min_ps( b.v, a.v ) }; }
+      // Same as std::max( a, b ): ( a < b ) ? b : a
+      friend Float4 max( Float4 a, Float4 b ) { return { _mm_max_ps( b.v, a.v ) }; }
+      friend Float4 sqrt( Float4 a ) { return { _mm_sqrt_ps( a.v ) }; }
+      friend Float4 abs( Float4 a ) { return { _mm_andnot_ps( _mm_set1_ps( -0.f ), a.v ) }; }
+
+      // Comparisons return lane masks. The "not" versions are true for NaNs, same as negating the scalar comparison
+      friend Float4 lessThan( Float4 a, Float4 b ) { return { _mm_cmplt_ps( a.v, b.v ) }; }
+      friend Float4 notLessThan( Float4 a, Float4 b ) { return { _mm_cmpnlt_ps( a.v, b.v ) }; }
+      friend Float4 greaterOrEqual( Float4 a, Float4 b ) { return { _mm_cmpge_ps( a.v, b.v ) }; }
+      friend Float4 operator&( Float4 a, Float4 b ) { return { _mm_and_ps( a.v, b.v ) }; }
+      friend Float4 operator|( Float4 a, Float4 b ) { return { _mm_or_ps( a.v, b.v ) }; }
+      // mask ? a : b
+      friend Float4 select( Float4 mask, Float4 a, Float4 b )
+      {
+         return { _mm_or_ps( _mm_and_ps( mask.v, a.v ), _mm_andnot_ps( mask.v, b.v ) ) };
+      }
+      friend int moveMask( Float4 mask ) { return _mm_movemask_ps( mask.v ); }
+   };
+#endif
+}
+
+#if SIMD_X86
+SIMD_AVX2_BEGIN
+namespace Simd
+{
+   struct Float8
+   {
+      static constexpr int WIDTH = 8;
+      __m256 v;
+
+      static Float8 broadcast( float value ) { return { _mm256_set1_ps( value ) }; }
+      static Float8 load( const float* data ) { return { _mm256_loadu_ps( data ) }; }
+      void store( float* data ) const { _mm256_storeu_ps( data, v ); }
+   };
+
+   // Free functions instead of hidden friends, GCC doesn't apply the target pragma to friends defined inside the class
+   inline Float8 operator+( Float8 a, Float8 b ) { return { _mm256_add_ps( a.v, b.v ) }; }
+   inline Float8 operator-( Float8 a, Float8 b ) { return { _mm256_sub_ps( a.v, b.v ) }; }
+   inline Float8 operator*( Float8 a, Float8 b ) { return { _mm256_mul_ps( a.v, b.v ) }; }
+   inline Float8 operator/( Float8 a, Float8 b ) { return { _mm256_div_ps( a.v, b.v ) }; }
+   inline Float8 operator-( Float8 a ) { return { _mm256_xor_ps( a.v, _mm256_set1_ps( -0.f ) ) }; }
+   inline Float8 min( Float8 a, Float8 b ) { return { _mm256_min_ps( b.v, a.v ) }; }
+   inline Float8 max( Float8 a, Float8 b ) { return { _mm256_max_ps( b.v, a.v ) }; }
+   inline Float8 sqrt( Float8 a ) { return { _mm256_sqrt_ps( a.v ) }; }
+   inline Float8 abs( Float8 a ) { return { _mm256_andnot_ps( _mm256_set1_ps( -0.f ), a.v ) }; }
+   inline Float8 lessThan( Float8 a, Float8 b ) { return { _mm256_cmp_ps( a.v, b.v, _CMP_LT_OQ ) }; }
+   inline Float8 notLessThan( Float8 a, Float8 b ) { return { _mm256_cmp_ps( a.v, b.v, _CMP_NLT_UQ ) }; }
+   inline Float8 greaterOrEqual( Float8 a, Float8 b ) { return { _mm256_cmp_ps( a.v, b.v, _CMP_GE_OQ ) }; }
+   inline Float8 operator&( Float8 a, Float8 b ) { return { _mm256_and_ps( a.v, b.v ) }; }
+   inline Float8 operator|( Float8 a, Float8 b ) { return { _mm256_or_ps( a.v, b.v ) }; }
+   inline Float8 select( Float8 mask, Float8 a, Float8 b ) { return { _mm256_blendv_ps( b.v, a.v, mask.v ) }; }
+   inline int moveMask( Float8 mask ) { return _mm256_movemask_ps( mask.v ); }
+}
+SIMD_AVX2_END
+#endif
+
+#endif //SEQUENCIAL_SIMD_H
@@ -0,0 +1,80 @@
+//
+// Created by dominik on 17.10.26.
+//
+
+#include "SphereBatch.h"
+#include "Intersections.h"
+#include "Simd.h"
+#include <limits>
+
+#if SIMD_X86
+namespace
+{
+   namespace SSE
+   {
+      using Float = Simd::Float4;
+#include "SphereKernels.inl"
+   }
+}
+
+SIMD_AVX2_BEGIN
+namespace
+{
+   namespace AVX2
+   {
+      using Float = Simd::Float8;
+#include "SphereKernels.inl"
+   }
+}
+SIMD_AVX2_END
+#endif
+
+namespace
+{
+   const unsigned int BATCH_WIDTH = Simd::detectWidth();
+}
+
+unsigned int SphereBatch::batchWidth()
+{
+   return BATCH_WIDTH;
+}
+
+bool SphereBatch::findClosest( const SphereArrays& spheres, uint32_t first, uint32_t count, const Ray& ray,
+                               float& closestDistance, uint32_t& closestIndex )
+{
+#if SIMD_X86
+   if( BATCH_WIDTH == 8 )
+      return AVX2::findClosest( spheres, first, count, ray, closestDistance, closestIndex );
+   return SSE::findClosest( spheres, first, count, ray, closestDistance, closestIndex );
+#else
+   bool found = false;
+   float distance;
+   for( auto i = first; i < first + count; ++i )
+   {
+      if( Intersection::sphereDistance( ray, spheres.center( i ), spheres.radius[ i ], distance ) && distance < closestDistance )
+      {
+         closestDistance = distance;
+         closestIndex = i;
+         found = true;
+      }
+   }
+   return found;
+#endif
+}
+
+bool SphereBatch::anyHit( const SphereArrays& spheres, uint32_t first, uint32_t count, const Ray& ray, float maxDistance )
+{
+#if SIMD_X86
+   if( BATCH_WIDTH == 8 )
+      return AVX2::anyHit( spheres, first, count, ray, maxDistance );
+   return SSE::anyHit( spheres, first, count, ray, maxDistance );
+#else
+   float distance;
+   for( auto i = first; i < first + count; ++i )
+   {
+      if( Intersection::sphereDistance( ray, spheres.center( i ), spheres.radius[ i ], distance ) && distance < maxDistance )
+         return true;
+   }
+   return false;
+#endif
+}
@@ -0,0 +1,45 @@
+//
+// Created by dominik on 17.10.26.
+//
+
+#ifndef SEQUENCIAL_SPHEREBATCH_H
+#define SEQUENCIAL_SPHEREBATCH_H
+
+#include "Objects.h"
+#include "Scene.h"
+
+/**
+ * @brief Intersects one ray with a contiguous range of spheres using SIMD instructions
+ *
+ * The spheres are read directly from the SphereArrays, so 8 (AVX2) or 4 (SSE) spheres are tested with a single quadratic.
+ * The sphere BVH leaves are contiguous ranges in the arrays, so every visited leaf is tested as one batch.
+ * The math is the same as in Intersection::sphereDistance, and ties are resolved the same way as in the scalar loop (the lower index wins)
+ */
+class SphereBatch
+{
+   public:
+      /**
+       * @return The number of spheres tested at once on this CPU, detected at runtime using CPUID. Used as the maximum sphere BVH leaf size
+       */
+      static unsigned int batchWidth();
+
+      /**
+       * @brief Finds the closest sphere in the range hit by the ray
+       * @param spheres The sphere arrays
+       * @param first Index of the first sphere of the range
+       * @param count Number of spheres in the range
+       * @param ray The ray to trace
+       * @param closestDistance In/out parameter. Only hits closer than this are considered, updated with the closest hit
+       * @param closestIndex Out parameter with the index of the closest sphere. Only written if a closer hit is found
+       * @return True if a hit closer than closestDistance was found
+       */
+      static bool findClosest( const SphereArrays& spheres, uint32_t first, uint32_t count, const Ray& ray,
+                               float& closestDistance, uint32_t& closestIndex );
+
+      /**
+       * @return True if any sphere in the range intersects the ray closer than maxDistance
+       */
+      static bool anyHit( const SphereArrays& spheres, uint32_t first, uint32_t count, const Ray& ray, float maxDistance );
+};
+
+#endif //SEQUENCIAL_SPHEREBATCH_H
@@ -0,0 +1,114 @@
+//
+// Created by dominik on 17.10.26.
+//
+
+// No include guard. This file is included by SphereBatch.cpp once per instruction set, inside a namespace which defines
+// the Float register type (Simd::Float4 or Simd::Float8). See Simd.h
+
+constexpr int WIDTH = Float::WIDTH;
+
+alignas( 32 ) inline constexpr float LANE_OFFSETS[ 8 ] = { 0.f, 1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f };
+
+// Distances from the ray to up to WIDTH spheres starting at index, same math as Intersection::sphereDistance
+// The hit mask is false for the lanes without a hit and for the lanes past the end of the range
+inline Float sphereDistances( const SphereArrays& spheres, uint32_t index, uint32_t remaining, const Ray& ray, Float& hitMask )
+{
+   Float centerX, centerY, centerZ, radius;
+   if( remaining >= WIDTH )
+   {
+      centerX = Float::load( spheres.centerX.data() + index );
+      centerY = Float::load( spheres.centerY.data() + index );
+      centerZ = Float::load( spheres.centerZ.data() + index );
+      radius = Float::load( spheres.radius.data() + index );
+   }
+   else
+   {
+      // Don't read past the end of the arrays, the unused lanes are masked out
+      alignas( 32 ) float tail[ 4 ][ WIDTH ] = {};
+      for( uint32_t lane = 0; lane < remaining; ++lane )
+      {
+         tail[ 0 ][ lane ] = spheres.centerX[ index + lane ];
+         tail[ 1 ][ lane ] = spheres.centerY[ index + lane ];
+         tail[ 2 ][ lane ] = spheres.centerZ[ index + lane ];
+         tail[ 3 ][ lane ] = spheres.radius[ index + lane ];
+      }
+      centerX = Float::load( tail[ 0 ] );
+      centerY = Float::load( tail[ 1 ] );
+      centerZ = Float::load( tail[ 2 ] );
+      radius = Float::load( tail[ 3 ] );
+   }
+
+   Float offsetX = Float::broadcast( ray.startPoint.x() ) - centerX;
+   Float offsetY = Float::broadcast( ray.startPoint.y() ) - centerY;
+   Float offsetZ = Float::broadcast( ray.startPoint.z() ) - centerZ;
+
+   Float b = ( Float::broadcast( ray.direction.x() ) * offsetX + Float::broadcast( ray.direction.y() ) * offsetY ) +
+             Float::broadcast( ray.direction.z() ) * offsetZ;
+   Float c = ( ( offsetX * offsetX + offsetY * offsetY ) + offsetZ * offsetZ ) - radius * radius;
+   Float discriminant = b * b - c;
+
+   Float discriminantSqrt = sqrt( discriminant );
+   Float nearRoot = -b - discriminantSqrt;
+   Float farRoot = -b + discriminantSqrt;
+   const Float minDistance = Float::broadcast( Intersection::EPSILON );
+   Float root = select( lessThan( nearRoot, minDistance ), farRoot, nearRoot );
+
+   Float inRange = lessThan( Float::load( LANE_OFFSETS ), Float::broadcast( static_cast<float>( remaining ) ) );
+   hitMask = inRange & notLessThan( discriminant, Float::broadcast( std::numeric_limits<float>::epsilon() ) ) &
+             notLessThan( root, minDistance );
+   return root;
+}
+
+inline bool findClosest( const SphereArrays& spheres, uint32_t first, uint32_t count, const Ray& ray, float& closestDistance,
+                         uint32_t& closestIndex )
+{
+   const Float laneOffsets = Float::load( LANE_OFFSETS );
+   Float bestDistances = Float::broadcast( closestDistance );
+   // Offsets from first stored as floats, exact for any realistic leaf size. -1 for lanes without a hit
+   Float bestOffsets = Float::broadcast( -1.f );
+
+   for( uint32_t offset = 0; offset < count; offset += WIDTH )
+   {
+      Float hitMask;
+      Float distances = sphereDistances( spheres, first + offset, count - offset, ray, hitMask );
+      Float closer = hitMask & lessThan( distances, bestDistances );
+      bestDistances = select( closer, distances, bestDistances );
+      bestOffsets = select( closer, laneOffsets + Float::broadcast( static_cast<float>( offset ) ), bestOffsets );
+   }
+
+   // Horizontal min reduction. On equal distances the lower index wins, same as in the scalar loop
+   alignas( 32 ) float distances[ WIDTH ];
+   alignas( 32 ) float offsets[ WIDTH ];
+   bestDistances.store( distances );
+   bestOffsets.store( offsets );
+
+   int bestLane = -1;
+   for( int lane = 0; lane < WIDTH; ++lane )
+   {
+      if( offsets[ lane ] < 0.f )
+         continue;
+      if( bestLane < 0 || distances[ lane ] < distances[ bestLane ] ||
+          ( distances[ lane ] == distances[ bestLane ] && offsets[ lane ] < offsets[ bestLane ] ) )
+         bestLane = lane;
+   }
+
+   if( bestLane < 0 )
+      return false;
+
+   closestDistance = distances[ bestLane ];
+   closestIndex = first + static_cast<uint32_t>( offsets[ bestLane ] );
+   return true;
+}
+
+inline bool anyHit( const SphereArrays& spheres, uint32_t first, uint32_t count, const Ray& ray, float maxDistance )
+{
+   const Float limit = Float::broadcast( maxDistance );
+   for( uint32_t offset = 0; offset < count; offset += WIDTH )
+   {
+      Float hitMask;
+      Float distances = sphereDistances( spheres, first + offset, count - offset, ray, hitMask );
+      if( moveMask( hitMask & lessThan( distances, limit ) ) != 0 )
+         return true;
+   }
+   return false;
+}
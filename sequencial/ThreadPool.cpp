@@ -0,0 +1,169 @@
+//
+// Created by dominik on 17.10.26.
+//
+
+#include "ThreadPool.h"
+#include <algorithm>
+
+ThreadPool::ThreadPool( unsigned int threadCount ) : threadCount( resolveThreadCount( threadCount ) )
+{
+   // The calling thread works as well, so we only need threadCount - 1 workers. The last queue belongs to the callers
+   for( auto i = 0u; i < this->threadCount; ++i )
+      queues.emplace_back( std::make_unique<TaskQueue>() );
+
+   workers.reserve( this->threadCount - 1 );
+   for( auto i = 0u; i + 1 < this->threadCount; ++i )
+      workers.emplace_back( &ThreadPool::workerLoop, this, i );
+}
+
+ThreadPool::~ThreadPool()
+{
+   {
+      std::lock_guard lock( sleepMutex );
+      stopping = true;
+   }
+   wakeUp.notify_all();
+
+   for( auto& worker: workers )
+      worker.join();
+}
+
+void ThreadPool::parallelFor( size_t taskCount, const std::function<void( size_t )>& task )
+{
+   parallelFor( taskCount, task, {} );
+}
+
+void ThreadPool::parallelFor( size_t taskCount, const std::function<void( size_t )>& task, const std::function<void()>& callerTask )
+{
+   if( taskCount == 0 )
+   {
+      if( callerTask )
+         callerTask();
+      return;
+   }
+
+   Batch batch{ &task, taskCount, {}, {} };
+
+   // Split the tasks into contiguous blocks, one per queue, so that neighbouring tasks stay on the same thread
+   size_t queueCount = queues.size();
+   for( size_t q = 0; q < queueCount; ++q )
+   {
+      size_t first = taskCount * q / queueCount;
+      size_t last = taskCount * ( q + 1 ) / queueCount;
+      if( first == last )
+         continue;
+
+      std::lock_guard lock( queues[ q ]->mutex );
+      for( size_t i = first; i < last; ++i )
+         queues[ q ]->tasks.push_back( { &batch, i } );
+   }
+
+   {
+      std::lock_guard lock( sleepMutex );
+      pendingTasks += taskCount;
+   }
+   wakeUp.notify_all();
+
+   // The batch lives on this stack frame, so the tasks have to finish even if the caller task fails
+   std::exception_ptr callerError;
+   if( callerTask )
+   {
+      try
+      {
+         callerTask();
+      }
+      catch( ... )
+      {
+         callerError = std::current_exception();
+      }
+   }
+
+   // Help with the work until there is nothing left to take, then wait for the tasks still running on the workers
+   size_t callerQueue = queueCount - 1;
+   Task current{};
+   while( batch.remaining.load() > 0 && popTask( callerQueue, current ) )
+      runTask( current );
+
+   std::unique_lock lock( batch.mutex );
+   batch.finished.wait( lock, [ &batch ] { return batch.remaining.load() == 0; } );
+   lock.unlock();
+   if( callerError )
+      std::rethrow_exception( callerError );
+}
+
+unsigned int ThreadPool::getThreadCount() const
+{
+   return threadCount;
+}
+
+unsigned int ThreadPool::resolveThreadCount( unsigned int threadCount )
+{
+   if( threadCount != 0 )
+      return threadCount;
+
+   return std::max( 1u, std::thread::hardware_concurrency() );
+}
+
+void ThreadPool::workerLoop( size_t queueIndex )
+{
+   Task task{};
+   while( true )
+   {
+      if( popTask( queueIndex, task ) )
+      {
+         runTask( task );
+         continue;
+      }
+
+      std::unique_lock lock( sleepMutex );
+      wakeUp.wait( lock, [ this ] { return stopping || pendingTasks.load() > 0; } );
+      if( stopping && pendingTasks.load() == 0 )
+         return;
+   }
+}
+
+bool ThreadPool::popTask( size_t queueIndex, Task& task )
+{
+   {
+      auto& queue = *queues[ queueIndex ];
+      std::lock_guard lock( queue.mutex );
+      if( !queue.tasks.empty() )
+      {
+         task = queue.tasks.front();
+         queue.tasks.pop_front();
+         --pendingTasks;
+         return true;
+      }
+   }
+
+   return stealTask( queueIndex + 1, task );
+}
+
+bool ThreadPool::stealTask( size_t firstQueue, Task& task )
+{
+   // Steal from the back of the queue. The owner takes from the front, so this takes the work furthest away from it
+   for( size_t i = 0; i < queues.size(); ++i )
+   {
+      auto& queue = *queues[ ( firstQueue + i ) % queues.size() ];
+      std::lock_guard lock( queue.mutex );
+      if( !queue.tasks.empty() )
+      {
+         task = queue.tasks.back();
+         queue.tasks.pop_back();
+         --pendingTasks;
+         return true;
+      }
+   }
+
+   return false;
+}
+
+void ThreadPool::runTask( const Task& task )
+{
+   ( *task.batch->function )( task.index );
+
+   // The counter is decremented under the lock, so the waiting thread can't destroy the batch before we are done with it
+   std::lock_guard lock( task.batch->mutex );
+   if( --task.batch->remaining == 0 )
+      task.batch->finished.notify_all();
+}
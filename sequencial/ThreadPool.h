@@ -0,0 +1,110 @@
+//
+// Created by dominik on 17.10.26.
+//
+
+#ifndef SEQUENCIAL_THREADPOOL_H
+#define SEQUENCIAL_THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief A work-stealing thread pool used for rendering image tiles in parallel
+ *
+ * Each worker owns a task queue. Work is distributed into the queues in contiguous blocks, so neighbouring tasks (tiles) end up on the same worker.
+ * A worker takes tasks from the front of its own queue, and when it runs out of work, it steals from the back of the other queues.
+ * The thread calling parallelFor also executes tasks, so a pool with a thread count of 1 has no workers and runs everything on the calling thread.
+ */
+class ThreadPool
+{
+   public:
+      /**
+       * @param threadCount The total number of threads executing tasks, including the calling thread. 0 means one thread per hardware thread
+       */
+      explicit ThreadPool( unsigned int threadCount = 0 );
+
+      ThreadPool( const ThreadPool& ) = delete;
+
+      ThreadPool& operator=( const ThreadPool& ) = delete;
+
+      ~ThreadPool();
+
+      /**
+       * @brief Executes task(i) for every i in [0, taskCount) and blocks until all the tasks are finished
+       *
+       * Can be called from multiple threads at once. The tasks of all callers share the same workers.
+       *
+       * @param taskCount Number of tasks to run
+       * @param task The task function. It's called with the index of the task
+       */
+      void parallelFor( size_t taskCount, const std::function<void( size_t )>& task );
+
+      /**
+       * @brief A parallelFor which runs callerTask on the calling thread first, while the workers already execute the tasks.
+       * Then the calling thread helps with the tasks as usual
+       *
+       * If callerTask throws, the exception is rethrown once all the tasks are finished
+       */
+      void parallelFor( size_t taskCount, const std::function<void( size_t )>& task, const std::function<void()>& callerTask );
+
+      /**
+       * @return The total number of threads executing tasks, including the calling thread
+       */
+      [[nodiscard]] unsigned int getThreadCount() const;
+
+      /**
+       * @brief Resolves the requested thread count. 0 is resolved to the number of hardware threads
+       */
+      [[nodiscard]] static unsigned int resolveThreadCount( unsigned int threadCount );
+
+      // Upper bound of the thread counts accepted from the users (options and command lines), far above any real machine
+      static constexpr unsigned int MAX_THREAD_COUNT = 1024;
+
+   private:
+      struct Batch
+      {
+         const std::function<void( size_t )>* function;
+         std::atomic<size_t> remaining;
+         std::mutex mutex;
+         std::condition_variable finished;
+      };
+
+      struct Task
+      {
+         Batch* batch;
+         size_t index;
+      };
+
+      struct TaskQueue
+      {
+         std::mutex mutex;
+         std::deque<Task> tasks;
+      };
+
+      void workerLoop( size_t queueIndex );
+
+      bool popTask( size_t queueIndex, Task& task );
+
+      bool stealTask( size_t firstQueue, Task& task );
+
+      void runTask( const Task& task );
+
+      unsigned int threadCount;
+      // One queue per worker + one shared by the calling threads
+      std::vector<std::unique_ptr<TaskQueue>> queues;
+      std::vector<std::thread> workers;
+      std::atomic<size_t> pendingTasks{ 0 };
+      std::mutex sleepMutex;
+      std::condition_variable wakeUp;
+      bool stopping = false;
+};
+
+#endif //SEQUENCIAL_THREADPOOL_H
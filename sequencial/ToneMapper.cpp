@@ -0,0 +1,51 @@
+//
+// Created by dominik on 17.10.26.
+//
+
+#include "ToneMapper.h"
+#include "Math.h"
+#include <bit>
+#include <cmath>
+#include <limits>
+
+ToneMapper::ToneMapper( float exposure, float gamma )
+   : exposure( exposure ), gamma( gamma ),
+     exact( !( exposure > 0.f && gamma > 0.f && std::isfinite( exposure ) && std::isfinite( gamma ) ) )
+{
+   if( exact )
+      return;
+
+   // Non-negative floats are ordered the same way as their bit patterns, so we binary search the bit patterns
+   constexpr uint32_t infinityBits = std::bit_cast<uint32_t>( std::numeric_limits<float>::infinity() );
+   thresholds[ 0 ] = -std::numeric_limits<float>::infinity();
+
+   for( unsigned int level = 1; level < LEVELS; ++level )
+   {
+      if( mapExact( std::numeric_limits<float>::infinity(), exposure, gamma ) < level )
+      {
+         thresholds[ level ] = std::numeric_limits<float>::quiet_NaN();
+         continue;
+      }
+
+      uint32_t low = 0;
+      uint32_t high = infinityBits;
+      while( low < high )
+      {
+         uint32_t middle = low + ( high - low ) / 2;
+         if( mapExact( std::bit_cast<float>( middle ), exposure, gamma ) >= level )
+            high = middle;
+         else
+            low = middle + 1;
+      }
+      thresholds[ level ] = std::bit_cast<float>( low );
+   }
+}
+
+uint8_t ToneMapper::mapExact( float value, float exposure, float gamma )
+{
+   float mapped = Math::gammaCorrection( Math::exposureToneMapping( value, exposure ), gamma ) * 255.0f;
+   // Negative values would give NaN from the gamma correction
+   if( !( mapped > 0.f ) )
+      return 0;
+   return static_cast<uint8_t>( std::min( std::lround( mapped ), 255l ) );
+}
@@ -0,0 +1,55 @@
+//
+// Created by dominik on 17.10.26.
+//
+
+#ifndef SEQUENCIAL_TONEMAPPER_H
+#define SEQUENCIAL_TONEMAPPER_H
+
+#include <array>
+#include <cstdint>
+
+/**
+ * @brief Maps the float color channels to 8-bit values using exposure tone mapping and gamma correction
+ *
+ * The curve lround( gamma( exposure( value ) ) * 255 ) is monotonic, so instead of evaluating std::exp and std::pow for every channel,
+ * the mapper stores the smallest channel value which reaches each of the 255 output levels. A value is then mapped with a branchless binary search
+ * over these thresholds, which gives the same results as the exact curve.
+ * The thresholds are computed once in the constructor, so one mapper should be created per image (per exposure and gamma pair).
+ * The curve is only monotonic for a positive finite exposure and gamma. For other values (e.g. a negative exposure, which inverts the curve)
+ * the mapper falls back to evaluating the exact curve for every channel
+ */
+class ToneMapper
+{
+   public:
+      ToneMapper( float exposure, float gamma );
+
+      [[nodiscard]] uint8_t map( float value ) const
+      {
+         // The same for the whole image, so the branch is always predicted
+         if( exact )
+            return mapExact( value, exposure, gamma );
+
+         // Largest level whose threshold is not above the value. NaNs and values below the first threshold map to 0
+         unsigned int level = 0;
+         for( unsigned int step = LEVELS / 2; step > 0; step /= 2 )
+            level += ( value >= thresholds[ level + step ] ) ? step : 0;
+         return static_cast<uint8_t>( level );
+      }
+
+      /**
+       * @brief Evaluates the tone mapping curve directly. Used to build the thresholds
+       */
+      [[nodiscard]] static uint8_t mapExact( float value, float exposure, float gamma );
+
+   private:
+      static constexpr unsigned int LEVELS = 256;
+
+      // thresholds[ i ] is the smallest value mapped to level i or higher. NaN for levels which can't be reached. thresholds[ 0 ] is never read
+      std::array<float, LEVELS> thresholds{};
+      float exposure;
+      float gamma;
+      // The curve isn't monotonic, the thresholds aren't used
+      bool exact;
+};
+
+#endif //SEQUENCIAL_TONEMAPPER_H
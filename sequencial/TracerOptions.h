@@ -18,11 +18,21 @@ struct TracerOptions
 {
    float cameraDistance;
    float fieldOfView;
-   unsigned int maxRecursionDepth;
+   // Maximum number of reflection and refraction bounces of a ray
+   unsigned int maxRecursionDepth = 5;
    unsigned int imageWidth;
    unsigned int imageHeight;
    Color backgroundColor;
    Color ambientLightColor;
+   // Tone mapping of the raw image: 1 - exp( -value * exposure ) followed by the gamma correction
+   float exposure = 1.1f;
+   float gamma = 1.6f;
+   // Number of threads used for rendering. 0 uses all hardware threads, 1 renders on the calling thread only
+   unsigned int threadCount = 0;
+   // The image is split into square tiles of this size (in pixels), which are distributed among the threads
+   unsigned int tileSize = 32;
+   // Traces the primary rays in SIMD packets of neighbouring pixels (8 rays with AVX2, 4 with SSE). The packet width is detected at runtime
+   bool packetTracing = true;
 };
 
 #endif //SEQUENCIAL_TRACEROPTIONS_H
@@ -0,0 +1,184 @@
+//
+// Created by dominik on 18.10.26.
+//
+
+#ifndef SEQUENCIAL_TRANSFORM_H
+#define SEQUENCIAL_TRANSFORM_H
+
+#include "AABB.h"
+#include "Objects.h"
+#include <numbers>
+#include <stdexcept>
+
+/**
+ * @brief Affine transformation (a 3x4 matrix) together with its inverse
+ *
+ * Maps object space of an instance into world space. The inverse is kept with the matrix,
+ * because the rays are transformed into object space and the normals back with the inverse transpose
+ */
+class Transform
+{
+   public:
+      // Identity
+      Transform() = default;
+
+      static Transform translation( const Vector3f& offset )
+      {
+         Transform transform;
+         for( size_t row = 0; row < 3; ++row )
+         {
+            transform.matrix[ row ][ 3 ] = offset[ row ];
+            transform.inverseMatrix[ row ][ 3 ] = -offset[ row ];
+         }
+         return transform;
+      }
+
+      /**
+       * @throws std::runtime_error If a factor is 0, the transformation wouldn't be invertible
+       */
+      static Transform scale( const Vector3f& factors )
+      {
+         Transform transform;
+         for( size_t i = 0; i < 3; ++i )
+         {
+            if( factors[ i ] == 0.f )
+               throw std::runtime_error( "A scale factor can't be 0" );
+            transform.matrix[ i ][ i ] = factors[ i ];
+            transform.inverseMatrix[ i ][ i ] = 1.f / factors[ i ];
+         }
+         return transform;
+      }
+
+      /**
+       * @brief Rotation around the x, then y, then z-axis
+       * @param degrees Angles around the axes in degrees
+       */
+      static Transform rotation( const Vector3f& degrees )
+      {
+         Transform result;
+         for( size_t axis = 0; axis < 3; ++axis )
+         {
+            float radians = degrees[ axis ] * std::numbers::pi_v<float> / 180.f;
+            float sine = std::sin( radians ), cosine = std::cos( radians );
+            size_t first = ( axis + 1 ) % 3, second = ( axis + 2 ) % 3;
+
+            // The inverse of a rotation is its transpose
+            Transform rotation;
+            rotation.matrix[ first ][ first ] = rotation.matrix[ second ][ second ] = cosine;
+            rotation.matrix[ first ][ second ] = -sine;
+            rotation.matrix[ second ][ first ] = sine;
+            rotation.inverseMatrix[ first ][ first ] = rotation.inverseMatrix[ second ][ second ] = cosine;
+            rotation.inverseMatrix[ first ][ second ] = sine;
+            rotation.inverseMatrix[ second ][ first ] = -sine;
+            result = rotation * result;
+         }
+         return result;
+      }
+
+      // Applies other first, then this
+      Transform operator*( const Transform& other ) const
+      {
+         Transform result;
+         multiply( matrix, other.matrix, result.matrix );
+         multiply( other.inverseMatrix, inverseMatrix, result.inverseMatrix );
+         return result;
+      }
+
+      [[nodiscard]] Transform inverse() const
+      {
+         Transform result;
+         std::copy( &inverseMatrix[ 0 ][ 0 ], &inverseMatrix[ 0 ][ 0 ] + 12, &result.matrix[ 0 ][ 0 ] );
+         std::copy( &matrix[ 0 ][ 0 ], &matrix[ 0 ][ 0 ] + 12, &result.inverseMatrix[ 0 ][ 0 ] );
+         return result;
+      }
+
+      [[nodiscard]] Vector3f transformPoint( const Vector3f& point ) const
+      {
+         return apply( matrix, point, 1.f );
+      }
+
+      [[nodiscard]] Vector3f transformVector( const Vector3f& vector ) const
+      {
+         return apply( matrix, vector, 0.f );
+      }
+
+      // Normals are transformed by the inverse transpose, so they stay perpendicular to the surface under non-uniform scaling. Not normalized
+      [[nodiscard]] Vector3f transformNormal( const Vector3f& normal ) const
+      {
+         Vector3f result;
+         for( size_t column = 0; column < 3; ++column )
+            result[ column ] = inverseMatrix[ 0 ][ column ] * normal[ 0 ] + inverseMatrix[ 1 ][ column ] * normal[ 1 ] +
+                               inverseMatrix[ 2 ][ column ] * normal[ 2 ];
+         return result;
+      }
+
+      /**
+       * @brief Transforms a world ray into object space. The object space direction is normalized again,
+       * because the intersection functions expect a normalized direction
+       * @param distanceScale Out parameter. An object space distance is the world distance multiplied by this
+       */
+      [[nodiscard]] Ray toObjectSpace( const Ray& ray, float& distanceScale ) const
+      {
+         Vector3f direction = apply( inverseMatrix, ray.direction, 0.f );
+         distanceScale = std::sqrt( VectorOps::dotProduct( direction, direction ) );
+         return { apply( inverseMatrix, ray.startPoint, 1.f ), direction / distanceScale };
+      }
+
+      /**
+       * @brief Converts a hit of the object space ray back into world space
+       * @param ray The world ray
+       * @param distance World distance of the hit
+       * @param result Hit data in object space, overwritten by the world space data
+       */
+      void toWorldSpace( const Ray& ray, float distance, RayHitResult& result ) const
+      {
+         result.distance = distance;
+         result.hitPoint = ray.startPoint + ( distance * ray.direction );
+         result.normal = transformNormal( result.normal );
+         result.normal.normalize();
+      }
+
+      // Bounds of the transformed box. Infinite boxes stay infinite
+      [[nodiscard]] AABB transformBounds( const AABB& bounds ) const
+      {
+         if( bounds.isEmpty() || !bounds.isFinite() )
+            return bounds;
+
+         AABB result;
+         for( int corner = 0; corner < 8; ++corner )
+         {
+            Vector3f point( ( corner & 1 ) ? bounds.maxPoint.x() : bounds.minPoint.x(), ( corner & 2 ) ? bounds.maxPoint.y() : bounds.minPoint.y(),
+                            ( corner & 4 ) ? bounds.maxPoint.z() : bounds.minPoint.z() );
+            result.grow( transformPoint( point ) );
+         }
+         return result;
+      }
+
+   private:
+      static Vector3f apply( const float ( &m )[ 3 ][ 4 ], const Vector3f& vector, float w )
+      {
+         Vector3f result;
+         for( size_t row = 0; row < 3; ++row )
+            result[ row ] = m[ row ][ 0 ] * vector[ 0 ] + m[ row ][ 1 ] * vector[ 1 ] + m[ row ][ 2 ] * vector[ 2 ] + m[ row ][ 3 ] * w;
+         return result;
+      }
+
+      // result = lhs * rhs, with the implicit last row ( 0, 0, 0, 1 )
+      static void multiply( const float ( &lhs )[ 3 ][ 4 ], const float ( &rhs )[ 3 ][ 4 ], float ( &result )[ 3 ][ 4 ] )
+      {
+         for( size_t row = 0; row < 3; ++row )
+         {
+            for( size_t column = 0; column < 4; ++column )
+            {
+               result[ row ][ column ] = lhs[ row ][ 0 ] * rhs[ 0 ][ column ] + lhs[ row ][ 1 ] * rhs[ 1 ][ column ] +
+                                         lhs[ row ][ 2 ] * rhs[ 2 ][ column ];
+            }
+            result[ row ][ 3 ] += lhs[ row ][ 3 ];
+         }
+      }
+
+      float matrix[ 3 ][ 4 ] = { { 1.f, 0.f, 0.f, 0.f }, { 0.f, 1.f, 0.f, 0.f }, { 0.f, 0.f, 1.f, 0.f } };
+      float inverseMatrix[ 3 ][ 4 ] = { { 1.f, 0.f, 0.f, 0.f }, { 0.f, 1.f, 0.f, 0.f }, { 0.f, 0.f, 1.f, 0.f } };
+};
+
+#endif //SEQUENCIAL_TRANSFORM_H
@@ -0,0 +1,170 @@
+//
+// Created by dominik on 18.10.26.
+//
+
+#include "TriangleMesh.h"
+#include "Intersections.h"
+#include "RenderStats.h"
+#include "Scene.h"
+#include <stdexcept>
+#include <string>
+
+TriangleMesh::TriangleMesh( std::vector<Vector3f> vertices, std::vector<uint32_t> indices, std::vector<Vector3f> normals,
+                            std::vector<uint32_t> normalIndices )
+{
+   if( indices.size() % 3 != 0 )
+      throw std::runtime_error( "The index count of a triangle mesh has to be a multiple of 3" );
+   if( indices.size() / 3 > UINT32_MAX )
+      throw std::runtime_error( "Too many triangles in a mesh" );
+   if( !normals.empty() && normalIndices.size() != indices.size() )
+      throw std::runtime_error( "A triangle mesh with normals needs a normal index for every vertex index" );
+
+   for( auto index: indices )
+   {
+      if( index >= vertices.size() )
+         throw std::runtime_error( "Vertex index " + std::to_string( index ) + " out of range" );
+   }
+   for( auto index: normalIndices )
+   {
+      if( index >= normals.size() )
+         throw std::runtime_error( "Normal index " + std::to_string( index ) + " out of range" );
+   }
+
+   size_t triangleCount = indices.size() / 3;
+   std::vector<AABB> bounds( triangleCount );
+   for( size_t i = 0; i < triangleCount; ++i )
+   {
+      for( size_t corner = 0; corner < 3; ++corner )
+         bounds[ i ].grow( vertices[ indices[ 3 * i + corner ] ] );
+   }
+   bvh = BVH( bounds );
+
+   // Reorder the index triplets, so a BVH leaf is a contiguous range of triangles
+   std::vector<uint32_t> reordered( indices.size() ), reorderedNormals( normalIndices.size() );
+   const auto& order = bvh.getPrimitiveIndices();
+   for( size_t i = 0; i < triangleCount; ++i )
+   {
+      for( size_t corner = 0; corner < 3; ++corner )
+      {
+         reordered[ 3 * i + corner ] = indices[ 3 * order[ i ] + corner ];
+         if( !normals.empty() )
+            reorderedNormals[ 3 * i + corner ] = normalIndices[ 3 * order[ i ] + corner ];
+      }
+   }
+
+   this->vertices = std::move( vertices );
+   this->indices = std::move( reordered );
+   this->normals = std::move( normals );
+   this->normalIndices = std::move( reorderedNormals );
+}
+
+bool TriangleMesh::findClosest( const Ray& ray, float& closestDistance, uint32_t& triangle ) const
+{
+   bool found = false;
+   bvh.traverse( ray.startPoint, ray.inverseDirection, closestDistance, [ & ]( uint32_t first, uint32_t count, float& maxDistance )
+   {
+      RAYTRACER_STAT( triangleTests, count );
+      float distance;
+      for( auto i = first; i < first + count; ++i )
+      {
+         if( triangleDistance( ray, i, distance ) && distance < maxDistance )
+         {
+            maxDistance = distance;
+            triangle = i;
+            found = true;
+         }
+      }
+      return false;
+   } );
+   return found;
+}
+
+bool TriangleMesh::isOccluded( const Ray& ray, float maxDistance ) const
+{
+   float limit = maxDistance;
+   return bvh.traverse( ray.startPoint, ray.inverseDirection, limit, [ & ]( uint32_t first, uint32_t count, float& )
+   {
+      RAYTRACER_STAT( triangleTests, count );
+      float distance;
+      for( auto i = first; i < first + count; ++i )
+      {
+         if( triangleDistance( ray, i, distance ) && distance < maxDistance )
+            return true;
+      }
+      return false;
+   } );
+}
+
+void TriangleMesh::surface( const Ray& ray, uint32_t triangle, float distance, RayHitResult& result ) const
+{
+   const uint32_t* corners = &indices[ 3 * triangle ];
+   if( normals.empty() )
+   {
+      Intersection::triangleSurface( ray, vertices[ corners[ 0 ] ], vertices[ corners[ 1 ] ], vertices[ corners[ 2 ] ], distance, result );
+      return;
+   }
+
+   const uint32_t* normalCorners = &normalIndices[ 3 * triangle ];
+   Vector3f vertexNormals[ 3 ] = { normals[ normalCorners[ 0 ] ], normals[ normalCorners[ 1 ] ], normals[ normalCorners[ 2 ] ] };
+   Intersection::triangleSurface( ray, vertices[ corners[ 0 ] ], vertices[ corners[ 1 ] ], vertices[ corners[ 2 ] ], distance, result,
+                                  vertexNormals );
+}
+
+AABB TriangleMesh::getBounds() const
+{
+   return bvh.isEmpty() ? AABB() : bvh.getNodes()[ 0 ].bounds;
+}
+
+size_t TriangleMesh::getTriangleCount() const
+{
+   return indices.size() / 3;
+}
+
+size_t TriangleMesh::getVertexCount() const
+{
+   return vertices.size();
+}
+
+bool TriangleMesh::hasNormals() const
+{
+   return !normals.empty();
+}
+
+bool TriangleMesh::triangleDistance( const Ray& ray, uint32_t triangle, float& distance ) const
+{
+   const uint32_t* corners = &indices[ 3 * triangle ];
+   float u, v;
+   return Intersection::triangleDistance( ray, vertices[ corners[ 0 ] ], vertices[ corners[ 1 ] ], vertices[ corners[ 2 ] ], distance,
+                                          u, v );
+}
+
+Mesh::Mesh( std::shared_ptr<const TriangleMesh> geometry, const Material& material )
+   : SceneObject( geometry->getBounds().centroid(), material ), geometry( std::move( geometry ) )
+{
+}
+
+bool Mesh::intersects( const Ray& ray, RayHitResult& result ) const
+{
+   float distance = std::numeric_limits<float>::infinity();
+   uint32_t triangle;
+   if( !geometry->findClosest( ray, distance, triangle ) )
+      return false;
+
+   geometry->surface( ray, triangle, distance, result );
+   return true;
+}
+
+bool Mesh::occludes( const Ray& ray, float maxDistance ) const
+{
+   return geometry->isOccluded( ray, maxDistance );
+}
+
+AABB Mesh::getBounds() const
+{
+   return geometry->getBounds();
+}
+
+uint32_t Mesh::addToScene( Scene& scene ) const
+{
+   return scene.addMesh( geometry, scene.addMaterial( material ) );
+}
@@ -0,0 +1,99 @@
+//
+// Created by dominik on 18.10.26.
+//
+
+#ifndef SEQUENCIAL_TRIANGLEMESH_H
+#define SEQUENCIAL_TRIANGLEMESH_H
+
+#include "BVH.h"
+#include "MappedArray.h"
+#include "Objects.h"
+#include <memory>
+#include <vector>
+
+/**
+ * @brief Triangle mesh geometry: a vertex buffer, an index buffer with three vertex indices per triangle, and a BVH over the triangles
+ *
+ * Every mesh has its own BVH, so the scene only sees the mesh bounds and a mesh of millions of triangles is one scene primitive.
+ * The triangles are reordered in the BVH order when the mesh is built, the vertices keep their order.
+ * Optional vertex normals (with their own index buffer, as in OBJ files) make the shading smooth, otherwise the triangles are flat.
+ * The geometry is immutable, so it can be shared by any number of Mesh objects
+ */
+class TriangleMesh
+{
+   public:
+      /**
+       * @param vertices Vertex positions
+       * @param indices Three vertex indices per triangle. Counter-clockwise triangles face outward
+       * @param normals Optional vertex normals
+       * @param normalIndices Three normal indices per triangle. Required if the normals are given
+       * @throws std::runtime_error If an index is out of range or the index buffer sizes don't match
+       */
+      TriangleMesh( std::vector<Vector3f> vertices, std::vector<uint32_t> indices, std::vector<Vector3f> normals = {},
+                    std::vector<uint32_t> normalIndices = {} );
+
+      /**
+       * @brief Finds the closest triangle hit by a ray
+       * @param closestDistance In/out parameter. Only triangles closer than this are considered
+       * @param triangle Out parameter with the index of the closest triangle, if any was found
+       * @return True if a triangle closer than closestDistance was found
+       */
+      bool findClosest( const Ray& ray, float& closestDistance, uint32_t& triangle ) const;
+
+      /**
+       * @return True if any triangle intersects the ray closer than maxDistance
+       */
+      [[nodiscard]] bool isOccluded( const Ray& ray, float maxDistance ) const;
+
+      /**
+       * @brief Calculates the hit point and normal of a triangle hit found by findClosest
+       */
+      void surface( const Ray& ray, uint32_t triangle, float distance, RayHitResult& result ) const;
+
+      [[nodiscard]] AABB getBounds() const;
+
+      [[nodiscard]] size_t getTriangleCount() const;
+
+      [[nodiscard]] size_t getVertexCount() const;
+
+      [[nodiscard]] bool hasNormals() const;
+
+   private:
+      // Saves and maps the buffers directly
+      friend class SceneFile;
+      // Hashes the buffers for the frame cache keys
+      friend class SceneHasher;
+
+      TriangleMesh() = default;
+
+      [[nodiscard]] bool triangleDistance( const Ray& ray, uint32_t triangle, float& distance ) const;
+
+      MappedArray<Vector3f> vertices;
+      MappedArray<uint32_t> indices;
+      MappedArray<Vector3f> normals;
+      MappedArray<uint32_t> normalIndices;
+      BVH bvh;
+};
+
+/**
+ * @brief Scene object made of a triangle mesh. The geometry is shared, only the pointer is copied with the object
+ */
+class Mesh : public SceneObject
+{
+   public:
+      Mesh() = delete;
+
+      Mesh( std::shared_ptr<const TriangleMesh> geometry, const Material& material );
+
+      bool intersects( const Ray& ray, RayHitResult& result ) const override;
+
+      [[nodiscard]] bool occludes( const Ray& ray, float maxDistance ) const override;
+
+      [[nodiscard]] AABB getBounds() const override;
+
+      uint32_t addToScene( Scene& scene ) const override;
+
+      std::shared_ptr<const TriangleMesh> geometry;
+};
+
+#endif //SEQUENCIAL_TRIANGLEMESH_H
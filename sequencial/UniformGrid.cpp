@@ -0,0 +1,239 @@
+//
+// Created by dominik on 18.10.26.
+//
+
+#include "UniformGrid.h"
+#include <bit>
+
+UniformGrid::UniformGrid( const std::vector<AABB>& primitiveBounds, Layout layout )
+{
+   if( primitiveBounds.empty() )
+      return;
+
+   for( const auto& box: primitiveBounds )
+      bounds.grow( box );
+
+   // Cells of the volume divided among CELLS_PER_PRIMITIVE times the primitives. Flat axes (e.g. all primitives on a floor) don't count into the volume
+   Vector3f extents = bounds.extents();
+   float largest = std::max( std::max( extents.x(), extents.y() ), extents.z() );
+   double volume = 1.0;
+   int dimensions = 0;
+   for( size_t axis = 0; axis < 3; ++axis )
+   {
+      if( extents[ axis ] > largest * 1e-4f )
+      {
+         volume *= extents[ axis ];
+         ++dimensions;
+      }
+   }
+   double cellCount = CELLS_PER_PRIMITIVE * static_cast<double>( primitiveBounds.size() );
+   float size = dimensions == 0 ? 1.f : static_cast<float>( std::pow( volume / cellCount, 1.0 / dimensions ) );
+
+   setCellSize( size, MAX_HASHED_RESOLUTION );
+   while( getCellCount() > MAX_DENSE_CELLS )
+   {
+      size *= static_cast<float>( std::cbrt( static_cast<double>( getCellCount() ) / MAX_DENSE_CELLS ) ) * 1.01f;
+      setCellSize( size, MAX_HASHED_RESOLUTION );
+   }
+   // Large overlapping primitives would be referenced by too many cells
+   while( countReferences( primitiveBounds ) > MAX_REFERENCES_PER_PRIMITIVE * primitiveBounds.size() )
+   {
+      size *= 2.f;
+      setCellSize( size, MAX_HASHED_RESOLUTION );
+   }
+
+   size_t occupied = buildDense( primitiveBounds );
+   double occupancy = static_cast<double>( occupied ) / static_cast<double>( getCellCount() );
+   if( layout == Layout::DENSE || ( layout == Layout::AUTOMATIC && occupancy >= MIN_DENSE_OCCUPANCY ) )
+      return;
+
+   // The occupied part of the world gets about as many cells as the whole world had, so the cells shrink by the cube root of the occupancy
+   cellStarts = {};
+   size *= static_cast<float>( std::cbrt( occupancy ) );
+   while( !buildHashed( primitiveBounds, size ) )
+      size *= 2.f;
+}
+
+bool UniformGrid::isEmpty() const
+{
+   return references.empty();
+}
+
+bool UniformGrid::isHashed() const
+{
+   return hashed;
+}
+
+const AABB& UniformGrid::getBounds() const
+{
+   return bounds;
+}
+
+size_t UniformGrid::getCellCount() const
+{
+   return static_cast<size_t>( resolution[ 0 ] ) * resolution[ 1 ] * resolution[ 2 ];
+}
+
+size_t UniformGrid::getReferenceCount() const
+{
+   return references.size();
+}
+
+void UniformGrid::setCellSize( float size, uint32_t maxResolution )
+{
+   Vector3f extents = bounds.extents();
+   for( size_t axis = 0; axis < 3; ++axis )
+   {
+      float cells = std::ceil( extents[ axis ] / size );
+      resolution[ axis ] = static_cast<uint32_t>( std::clamp( cells, 1.f, static_cast<float>( maxResolution ) ) );
+      // A flat axis has a single cell of any size
+      cellSize[ axis ] = extents[ axis ] > 0.f ? extents[ axis ] / static_cast<float>( resolution[ axis ] ) : 1.f;
+      inverseCellSize[ axis ] = 1.f / cellSize[ axis ];
+   }
+}
+
+void UniformGrid::cellRange( const AABB& box, uint32_t ( &first )[ 3 ], uint32_t ( &last )[ 3 ] ) const
+{
+   for( size_t axis = 0; axis < 3; ++axis )
+   {
+      auto maxCell = static_cast<float>( resolution[ axis ] - 1 );
+      first[ axis ] = static_cast<uint32_t>(
+         std::clamp( ( box.minPoint[ axis ] - bounds.minPoint[ axis ] ) * inverseCellSize[ axis ], 0.f, maxCell ) );
+      last[ axis ] = static_cast<uint32_t>(
+         std::clamp( ( box.maxPoint[ axis ] - bounds.minPoint[ axis ] ) * inverseCellSize[ axis ], 0.f, maxCell ) );
+   }
+}
+
+size_t UniformGrid::countReferences( const std::vector<AABB>& primitiveBounds ) const
+{
+   uint32_t first[ 3 ], last[ 3 ];
+   size_t referenceCount = 0;
+   for( const auto& box: primitiveBounds )
+   {
+      cellRange( box, first, last );
+      referenceCount += static_cast<size_t>( last[ 0 ] - first[ 0 ] + 1 ) * ( last[ 1 ] - first[ 1 ] + 1 ) * ( last[ 2 ] - first[ 2 ] + 1 );
+   }
+   return referenceCount;
+}
+
+size_t UniformGrid::buildDense( const std::vector<AABB>& primitiveBounds )
+{
+   hashed = false;
+   size_t cellCount = getCellCount();
+   auto cellIndex = [ & ]( uint32_t x, uint32_t y, uint32_t z )
+   {
+      return x + static_cast<size_t>( resolution[ 0 ] ) * ( y + static_cast<size_t>( resolution[ 1 ] ) * z );
+   };
+
+   // Counting sort of the references by the cell: count, prefix sum, fill
+   cellStarts.assign( cellCount + 1, 0 );
+   uint32_t first[ 3 ], last[ 3 ];
+   for( const auto& box: primitiveBounds )
+   {
+      cellRange( box, first, last );
+      for( auto z = first[ 2 ]; z <= last[ 2 ]; ++z )
+         for( auto y = first[ 1 ]; y <= last[ 1 ]; ++y )
+            for( auto x = first[ 0 ]; x <= last[ 0 ]; ++x )
+               ++cellStarts[ cellIndex( x, y, z ) + 1 ];
+   }
+
+   size_t occupied = 0;
+   for( size_t i = 0; i < cellCount; ++i )
+   {
+      occupied += cellStarts[ i + 1 ] > 0;
+      cellStarts[ i + 1 ] += cellStarts[ i ];
+   }
+
+   references.resize( cellStarts[ cellCount ] );
+   std::vector<uint32_t> cursors( cellStarts.begin(), cellStarts.end() - 1 );
+   for( uint32_t i = 0; i < primitiveBounds.size(); ++i )
+   {
+      cellRange( primitiveBounds[ i ], first, last );
+      for( auto z = first[ 2 ]; z <= last[ 2 ]; ++z )
+         for( auto y = first[ 1 ]; y <= last[ 1 ]; ++y )
+            for( auto x = first[ 0 ]; x <= last[ 0 ]; ++x )
+               references[ cursors[ cellIndex( x, y, z ) ]++ ] = i;
+   }
+   return occupied;
+}
+
+bool UniformGrid::buildHashed( const std::vector<AABB>& primitiveBounds, float size )
+{
+   setCellSize( size, MAX_HASHED_RESOLUTION );
+   size_t referenceCount = countReferences( primitiveBounds );
+   if( referenceCount > MAX_REFERENCES_PER_PRIMITIVE * primitiveBounds.size() )
+      return false;
+
+   // At most half of the slots are used
+   hashed = true;
+   size_t slotCount = std::bit_ceil( 2 * std::min( referenceCount, getCellCount() ) );
+   slotMask = slotCount - 1;
+   hashedCells.assign( slotCount, {} );
+
+   // The same counting sort as the dense layout, the counts are kept in the hashed cells
+   uint32_t first[ 3 ], last[ 3 ];
+   for( const auto& box: primitiveBounds )
+   {
+      cellRange( box, first, last );
+      for( auto z = first[ 2 ]; z <= last[ 2 ]; ++z )
+         for( auto y = first[ 1 ]; y <= last[ 1 ]; ++y )
+            for( auto x = first[ 0 ]; x <= last[ 0 ]; ++x )
+            {
+               uint64_t key = cellKey( x, y, z );
+               HashedCell& cell = hashedCells[ findSlot( key ) ];
+               cell.key = key;
+               ++cell.count;
+            }
+   }
+
+   uint32_t start = 0;
+   for( auto& cell: hashedCells )
+   {
+      cell.first = start;
+      start += cell.count;
+      cell.count = 0;
+   }
+
+   references.resize( referenceCount );
+   for( uint32_t i = 0; i < primitiveBounds.size(); ++i )
+   {
+      cellRange( primitiveBounds[ i ], first, last );
+      for( auto z = first[ 2 ]; z <= last[ 2 ]; ++z )
+         for( auto y = first[ 1 ]; y <= last[ 1 ]; ++y )
+            for( auto x = first[ 0 ]; x <= last[ 0 ]; ++x )
+            {
+               HashedCell& cell = hashedCells[ findSlot( cellKey( x, y, z ) ) ];
+               references[ cell.first + cell.count++ ] = i;
+            }
+   }
+   return true;
+}
+
+uint64_t UniformGrid::cellKey( uint32_t x, uint32_t y, uint32_t z )
+{
+   return static_cast<uint64_t>( x ) | ( static_cast<uint64_t>( y ) << 21 ) | ( static_cast<uint64_t>( z ) << 42 );
+}
+
+size_t UniformGrid::findSlot( uint64_t key ) const
+{
+   // Fibonacci hashing spreads the neighbouring cells over the table
+   size_t slot = static_cast<size_t>( ( key * 0x9E3779B97F4A7C15ull ) >> 32 ) & slotMask;
+   while( hashedCells[ slot ].key != key && hashedCells[ slot ].key != EMPTY_KEY )
+      slot = ( slot + 1 ) & slotMask;
+   return slot;
+}
+
+void UniformGrid::cellReferences( uint32_t x, uint32_t y, uint32_t z, uint32_t& first, uint32_t& count ) const
+{
+   if( hashed )
+   {
+      const HashedCell& cell = hashedCells[ findSlot( cellKey( x, y, z ) ) ];
+      first = cell.first;
+      count = cell.key == EMPTY_KEY ? 0 : cell.count;
+      return;
+   }
+
+   size_t cell = x + static_cast<size_t>( resolution[ 0 ] ) * ( y + static_cast<size_t>( resolution[ 1 ] ) * z );
+   first = cellStarts[ cell ];
+   count = cellStarts[ cell + 1 ] - first;
+}
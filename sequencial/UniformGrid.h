@@ -0,0 +1,203 @@
+//
+// Created by dominik on 18.10.26.
+//
+
+#ifndef SEQUENCIAL_UNIFORMGRID_H
+#define SEQUENCIAL_UNIFORMGRID_H
+
+#include "AABB.h"
+#include "Objects.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Uniform grid over primitive bounding boxes, an alternative to the BVH for evenly spread primitives of similar size
+ *
+ * Every cell lists the primitives whose bounds overlap it, and a ray walks the cells it crosses front to back using 3D-DDA.
+ * The grid is built in O(N) by a counting sort of the primitive-cell references, without any sorting or splitting.
+ * The cell size is chosen automatically, so there are about CELLS_PER_PRIMITIVE cells per primitive.
+ *
+ * A dense grid stores a range for every cell. When most of the dense cells stay empty (a large, mostly empty world with clusters of primitives),
+ * the hashed layout is used instead: the cells are made smaller, so the occupied part of the world gets the cells, and only the occupied cells are stored in a hash table.
+ *
+ * Like the BVH, the grid only knows the primitive indices. The cell lists are sorted, so runs of consecutive indices are passed to the leaf function
+ * as one range, which suits the primitive arrays reordered in the BVH order
+ */
+class UniformGrid
+{
+   public:
+      enum class Layout : uint8_t
+      {
+         // Hashed for mostly empty worlds, dense otherwise
+         AUTOMATIC,
+         DENSE,
+         HASHED
+      };
+
+      static constexpr float CELLS_PER_PRIMITIVE = 3.f;
+      static constexpr size_t MAX_DENSE_CELLS = size_t( 1 ) << 24;
+      // Maximum number of cells along an axis of the hashed layout. The cell coordinates are packed into 21 bits each
+      static constexpr uint32_t MAX_HASHED_RESOLUTION = 1 << 20;
+      // The automatic layout is hashed when less than this fraction of the dense cells is occupied
+      static constexpr float MIN_DENSE_OCCUPANCY = 0.1f;
+      // The cells are enlarged until the primitives reference at most this many cells on average
+      static constexpr size_t MAX_REFERENCES_PER_PRIMITIVE = 8;
+
+      UniformGrid() = default;
+
+      /**
+       * @brief Builds the grid
+       * @param primitiveBounds Bounding boxes of all primitives. All of them have to be finite
+       * @param layout Dense or hashed cells, chosen by the occupancy of the dense cells by default
+       */
+      explicit UniformGrid( const std::vector<AABB>& primitiveBounds, Layout layout = Layout::AUTOMATIC );
+
+      /**
+       * @brief Walks the cells crossed by the ray front to back and calls the leaf function for the primitives of every cell
+       *
+       * A primitive overlapping several cells is passed once per cell. The walk stops once the closest hit is in the cells already visited
+       * @param maxDistance In/out parameter with the current closest hit distance. The leaf function is expected to shrink it when it finds a closer hit
+       * @param leafFunction Callable as bool( uint32_t first, uint32_t count, float& maxDistance ) for every run of consecutive primitive indices
+       * in a cell. Returning true stops the walk (e.g. for any-hit queries)
+       * @return True if the leaf function stopped the walk
+       */
+      template<typename LeafFunction>
+      bool traverse( const Ray& ray, float& maxDistance, LeafFunction&& leafFunction ) const;
+
+      [[nodiscard]] bool isEmpty() const;
+
+      [[nodiscard]] bool isHashed() const;
+
+      [[nodiscard]] const AABB& getBounds() const;
+
+      /**
+       * @return Number of cells the grid covers, including the empty ones which aren't stored in the hashed layout
+       */
+      [[nodiscard]] size_t getCellCount() const;
+
+      /**
+       * @return Number of primitive references in all cells
+       */
+      [[nodiscard]] size_t getReferenceCount() const;
+
+   private:
+      // Range of references of an occupied cell in the hashed layout
+      struct HashedCell
+      {
+         uint64_t key = EMPTY_KEY;
+         uint32_t first = 0;
+         uint32_t count = 0;
+      };
+
+      static constexpr uint64_t EMPTY_KEY = UINT64_MAX;
+
+      // Sets the resolution and the cell size for cells of roughly the given size
+      void setCellSize( float size, uint32_t maxResolution );
+
+      // Index range of the cells overlapped by a box
+      void cellRange( const AABB& box, uint32_t ( &first )[ 3 ], uint32_t ( &last )[ 3 ] ) const;
+
+      // Number of cells overlapped by all the primitives together
+      [[nodiscard]] size_t countReferences( const std::vector<AABB>& primitiveBounds ) const;
+
+      // Returns the number of occupied cells
+      size_t buildDense( const std::vector<AABB>& primitiveBounds );
+
+      // Returns false if the primitives would reference too many cells of the given size, then the grid has to be built again
+      bool buildHashed( const std::vector<AABB>& primitiveBounds, float size );
+
+      [[nodiscard]] static uint64_t cellKey( uint32_t x, uint32_t y, uint32_t z );
+
+      // Finds the hashed cell or the empty slot where it belongs
+      [[nodiscard]] size_t findSlot( uint64_t key ) const;
+
+      // Reference range of a cell. The count is 0 for empty cells
+      void cellReferences( uint32_t x, uint32_t y, uint32_t z, uint32_t& first, uint32_t& count ) const;
+
+      AABB bounds;
+      uint32_t resolution[ 3 ] = { 0, 0, 0 };
+      Vector3f cellSize;
+      Vector3f inverseCellSize;
+      // Maps a mixed cell key to a slot of hashedCells
+      uint64_t slotMask = 0;
+      // Primitive indices of all cells, sorted within a cell
+      std::vector<uint32_t> references;
+      // Dense layout: references of cell i are [ cellStarts[ i ], cellStarts[ i + 1 ] )
+      std::vector<uint32_t> cellStarts;
+      // Hashed layout: open addressing with linear probing, the size is a power of two
+      std::vector<HashedCell> hashedCells;
+      bool hashed = false;
+};
+
+template<typename LeafFunction>
+bool UniformGrid::traverse( const Ray& ray, float& maxDistance, LeafFunction&& leafFunction ) const
+{
+   if( references.empty() )
+      return false;
+
+   // Clip the ray by the grid bounds
+   float entry = 0.f, exit = maxDistance;
+   for( size_t axis = 0; axis < 3; ++axis )
+   {
+      float t1 = ( bounds.minPoint[ axis ] - ray.startPoint[ axis ] ) * ray.inverseDirection[ axis ];
+      float t2 = ( bounds.maxPoint[ axis ] - ray.startPoint[ axis ] ) * ray.inverseDirection[ axis ];
+      if( std::isnan( t1 ) || std::isnan( t2 ) )
+         continue;
+      entry = std::max( entry, std::min( t1, t2 ) );
+      exit = std::min( exit, std::max( t1, t2 ) );
+   }
+   if( entry > exit )
+      return false;
+
+   int cell[ 3 ], step[ 3 ], end[ 3 ];
+   float next[ 3 ], delta[ 3 ];
+   for( size_t axis = 0; axis < 3; ++axis )
+   {
+      float position = ray.startPoint[ axis ] + entry * ray.direction[ axis ] - bounds.minPoint[ axis ];
+      cell[ axis ] = static_cast<int>( std::clamp( position * inverseCellSize[ axis ], 0.f, static_cast<float>( resolution[ axis ] - 1 ) ) );
+
+      if( ray.direction[ axis ] == 0.f )
+      {
+         step[ axis ] = 0;
+         end[ axis ] = -1;
+         next[ axis ] = delta[ axis ] = std::numeric_limits<float>::infinity();
+         continue;
+      }
+
+      bool positive = ray.direction[ axis ] > 0.f;
+      step[ axis ] = positive ? 1 : -1;
+      end[ axis ] = positive ? static_cast<int>( resolution[ axis ] ) : -1;
+      float boundary = bounds.minPoint[ axis ] + static_cast<float>( cell[ axis ] + ( positive ? 1 : 0 ) ) * cellSize[ axis ];
+      next[ axis ] = ( boundary - ray.startPoint[ axis ] ) * ray.inverseDirection[ axis ];
+      delta[ axis ] = cellSize[ axis ] * std::abs( ray.inverseDirection[ axis ] );
+   }
+
+   while( true )
+   {
+      uint32_t first, count;
+      cellReferences( static_cast<uint32_t>( cell[ 0 ] ), static_cast<uint32_t>( cell[ 1 ] ), static_cast<uint32_t>( cell[ 2 ] ), first, count );
+      for( uint32_t i = first, cellEnd = first + count; i < cellEnd; )
+      {
+         uint32_t runStart = i;
+         while( ++i < cellEnd && references[ i ] == references[ i - 1 ] + 1 )
+            ;
+         if( leafFunction( references[ runStart ], i - runStart, maxDistance ) )
+            return true;
+      }
+
+      size_t axis = next[ 0 ] < next[ 1 ] ? ( next[ 0 ] < next[ 2 ] ? 0 : 2 ) : ( next[ 1 ] < next[ 2 ] ? 1 : 2 );
+      float cellExit = next[ axis ];
+      // A hit inside the visited cells can't be beaten by the cells further along the ray
+      if( maxDistance <= cellExit || cellExit > exit )
+         return false;
+
+      cell[ axis ] += step[ axis ];
+      if( cell[ axis ] == end[ axis ] )
+         return false;
+      next[ axis ] += delta[ axis ];
+   }
+}
+
+#endif //SEQUENCIAL_UNIFORMGRID_H
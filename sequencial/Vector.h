@@ -157,6 +157,14 @@ namespace VectorOps
       return result;
    }
 
+   template<typename T>
+   Vector<T, 3> crossProduct( const Vector<T, 3>& lhs, const Vector<T, 3>& rhs )
+   {
+      return Vector<T, 3>( lhs[ 1 ] * rhs[ 2 ] - lhs[ 2 ] * rhs[ 1 ],
+                           lhs[ 2 ] * rhs[ 0 ] - lhs[ 0 ] * rhs[ 2 ],
+                           lhs[ 0 ] * rhs[ 1 ] - lhs[ 1 ] * rhs[ 0 ] );
+   }
+
    template<typename T, size_t N>
    Vector<T, N> hadamardProduct( const Vector<T, N>& lhs, const Vector<T, N>& rhs )
    {
@@ -0,0 +1,200 @@
+//
+// Created by dominik on 18.10.26.
+//
+
+#include "WideBVH.h"
+#include <algorithm>
+
+WideBVH::WideBVH( const BVH& bvh )
+{
+   if( bvh.isEmpty() )
+      return;
+
+   switch( Simd::detectWidth() )
+   {
+      case 8:
+         collapse( bvh, nodes8 );
+         break;
+      case 4:
+         collapse( bvh, nodes4 );
+         break;
+      default:
+         break;
+   }
+}
+
+template<int WIDTH>
+void WideBVH::collapse( const BVH& bvh, std::vector<WideNode<WIDTH>>& nodes )
+{
+   const auto& binaryNodes = bvh.getNodes();
+   nodes.reserve( binaryNodes.size() / ( WIDTH - 1 ) + 1 );
+
+   // Pairs of a wide node and the binary node it's made of
+   std::vector<std::pair<uint32_t, uint32_t>> pending{ { 0u, 0u } };
+   nodes.emplace_back();
+   while( !pending.empty() )
+   {
+      auto [ wideIndex, binaryIndex ] = pending.back();
+      pending.pop_back();
+
+      // Open the interior child with the largest surface area until the node is full, the large children are the most likely to be hit
+      std::vector<uint32_t> children;
+      const BVH::Node& root = binaryNodes[ binaryIndex ];
+      if( root.isLeaf() )
+         children.push_back( binaryIndex );
+      else
+         children.insert( children.end(), { root.leftFirst, root.leftFirst + 1 } );
+
+      while( children.size() < WIDTH )
+      {
+         auto largest = children.end();
+         float largestArea = -1.f;
+         for( auto child = children.begin(); child != children.end(); ++child )
+         {
+            const BVH::Node& node = binaryNodes[ *child ];
+            float area = node.bounds.surfaceArea();
+            if( !node.isLeaf() && area > largestArea )
+            {
+               largest = child;
+               largestArea = area;
+            }
+         }
+         if( largest == children.end() )
+            break;
+
+         // Replaced in place, so the children keep the binary tree order
+         uint32_t opened = *largest;
+         *largest = binaryNodes[ opened ].leftFirst;
+         children.insert( largest + 1, binaryNodes[ opened ].leftFirst + 1 );
+      }
+
+      WideNode<WIDTH> wide;
+      if( sources.size() < nodes.size() * WIDTH )
+         sources.resize( nodes.size() * WIDTH, NO_SOURCE );
+      constexpr float nan = std::numeric_limits<float>::quiet_NaN();
+      for( int lane = 0; lane < WIDTH; ++lane )
+      {
+         if( lane >= static_cast<int>( children.size() ) )
+         {
+            wide.minX[ lane ] = wide.minY[ lane ] = wide.minZ[ lane ] = nan;
+            wide.maxX[ lane ] = wide.maxY[ lane ] = wide.maxZ[ lane ] = nan;
+            wide.child[ lane ] = wide.count[ lane ] = 0;
+            continue;
+         }
+
+         const BVH::Node& node = binaryNodes[ children[ lane ] ];
+         sources[ wideIndex * WIDTH + lane ] = children[ lane ];
+         wide.minX[ lane ] = node.bounds.minPoint.x();
+         wide.minY[ lane ] = node.bounds.minPoint.y();
+         wide.minZ[ lane ] = node.bounds.minPoint.z();
+         wide.maxX[ lane ] = node.bounds.maxPoint.x();
+         wide.maxY[ lane ] = node.bounds.maxPoint.y();
+         wide.maxZ[ lane ] = node.bounds.maxPoint.z();
+         if( node.isLeaf() )
+         {
+            wide.child[ lane ] = node.leftFirst;
+            wide.count[ lane ] = node.primitiveCount;
+         }
+         else
+         {
+            wide.child[ lane ] = static_cast<uint32_t>( nodes.size() );
+            wide.count[ lane ] = 0;
+            pending.emplace_back( wide.child[ lane ], children[ lane ] );
+            nodes.emplace_back();
+         }
+      }
+      nodes[ wideIndex ] = wide;
+   }
+}
+
+void WideBVH::refit( const BVH& bvh, const std::vector<uint32_t>& changedPositions )
+{
+   if( !nodes8.empty() )
+      refitNodes( bvh, changedPositions, nodes8 );
+   else if( !nodes4.empty() )
+      refitNodes( bvh, changedPositions, nodes4 );
+}
+
+template<int WIDTH>
+void WideBVH::refitNodes( const BVH& bvh, const std::vector<uint32_t>& changedPositions, std::vector<WideNode<WIDTH>>& nodes )
+{
+   if( changedPositions.empty() )
+      return;
+   prepareRefit( nodes );
+
+   const auto& binaryNodes = bvh.getNodes();
+   for( auto position: changedPositions )
+   {
+      // Walk up from the node with the leaf until a node doesn't change. The lanes of a node cover the whole binary subtree of its parent lane,
+      // so the nodes above it are up to date too
+      uint32_t current = primitiveNodes[ position ];
+      while( true )
+      {
+         WideNode<WIDTH>& node = nodes[ current ];
+         bool changed = false;
+         for( int lane = 0; lane < WIDTH; ++lane )
+         {
+            uint32_t source = sources[ current * WIDTH + lane ];
+            if( source == NO_SOURCE )
+               continue;
+
+            const AABB& bounds = binaryNodes[ source ].bounds;
+            float* lanes[ 6 ] = { node.minX, node.minY, node.minZ, node.maxX, node.maxY, node.maxZ };
+            float values[ 6 ] = { bounds.minPoint.x(), bounds.minPoint.y(), bounds.minPoint.z(),
+                                  bounds.maxPoint.x(), bounds.maxPoint.y(), bounds.maxPoint.z() };
+            for( int i = 0; i < 6; ++i )
+            {
+               if( lanes[ i ][ lane ] != values[ i ] )
+               {
+                  lanes[ i ][ lane ] = values[ i ];
+                  changed = true;
+               }
+            }
+         }
+
+         if( !changed || current == 0 )
+            break;
+         current = parents[ current ];
+      }
+   }
+}
+
+template<int WIDTH>
+void WideBVH::prepareRefit( const std::vector<WideNode<WIDTH>>& nodes )
+{
+   if( !parents.empty() )
+      return;
+
+   parents.assign( nodes.size(), 0 );
+   for( uint32_t i = 0; i < nodes.size(); ++i )
+   {
+      const WideNode<WIDTH>& node = nodes[ i ];
+      for( int lane = 0; lane < WIDTH; ++lane )
+      {
+         // The root is nobody's child, so a child 0 without a count is an unused lane
+         if( node.count[ lane ] > 0 )
+         {
+            if( primitiveNodes.size() < node.child[ lane ] + node.count[ lane ] )
+               primitiveNodes.resize( node.child[ lane ] + node.count[ lane ] );
+            std::fill_n( primitiveNodes.begin() + node.child[ lane ], node.count[ lane ], i );
+         }
+         else if( node.child[ lane ] != 0 )
+            parents[ node.child[ lane ] ] = i;
+      }
+   }
+}
+
+bool WideBVH::isEmpty() const
+{
+   return nodes4.empty() && nodes8.empty();
+}
+
+unsigned int WideBVH::getWidth() const
+{
+   return !nodes8.empty() ? 8u : !nodes4.empty() ? 4u : 0u;
+}
+
+size_t WideBVH::getNodeCount() const
+{
+   return nodes4.size() + nodes8.size();
+}
@@ -0,0 +1,133 @@
+//
+// Created by dominik on 18.10.26.
+//
+
+#ifndef SEQUENCIAL_WIDEBVH_H
+#define SEQUENCIAL_WIDEBVH_H
+
+#include "BVH.h"
+#include "Simd.h"
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+/**
+ * @brief Node of a wide BVH with the bounds of all its children stored as structure of arrays, so one SIMD slab test checks all of them
+ *
+ * A child with a primitive count is a leaf with the primitive range [ child, child + count ), otherwise it's the index of an interior node.
+ * Unused children have NaN bounds, which never pass the slab test. The node is aligned to cache lines (2 lines for 4 children, 4 for 8)
+ */
+template<int WIDTH>
+struct alignas( 64 ) WideNode
+{
+   float minX[ WIDTH ], minY[ WIDTH ], minZ[ WIDTH ];
+   float maxX[ WIDTH ], maxY[ WIDTH ], maxZ[ WIDTH ];
+   uint32_t child[ WIDTH ];
+   uint32_t count[ WIDTH ];
+};
+
+static_assert( sizeof( WideNode<4> ) == 128 && sizeof( WideNode<8> ) == 256 );
+
+#if SIMD_X86
+namespace WideKernels
+{
+   namespace SSE
+   {
+      using Float = Simd::Float4;
+#include "WideBVHKernels.inl"
+   }
+}
+
+SIMD_AVX2_BEGIN
+namespace WideKernels
+{
+   namespace AVX2
+   {
+      using Float = Simd::Float8;
+#include "WideBVHKernels.inl"
+   }
+}
+SIMD_AVX2_END
+#endif
+
+/**
+ * @brief BVH with 4 or 8 children per node, traversed by testing one ray against all children of a node at once
+ *
+ * A binary BVH leaves most of the SIMD lanes idle and visits a node (and risks a cache miss) for every level of the tree.
+ * The wide BVH is made by collapsing a built binary BVH: the largest interior children are replaced by their children until a node has the SIMD width of children.
+ * The leaves and the primitive order are the same as in the binary BVH, so the primitive arrays don't change.
+ * The children hit by a ray are visited in the order of their entry distance.
+ * Every child remembers the binary node it was made of, so after a refit of the binary BVH the wide nodes copy the new bounds without collapsing again.
+ *
+ * The width is the SIMD width detected at runtime: 8 children with AVX2 and 4 with SSE. Without SIMD the wide BVH stays empty
+ */
+class WideBVH
+{
+   public:
+      WideBVH() = default;
+
+      /**
+       * @brief Collapses a built binary BVH
+       */
+      explicit WideBVH( const BVH& bvh );
+
+      /**
+       * @brief Traverses the tree front to back and calls the leaf function for every leaf the ray hits. Same contract as BVH::traverse
+       */
+      template<typename LeafFunction>
+      bool traverse( const Vector3f& origin, const Vector3f& inverseDirection, float& maxDistance, LeafFunction&& leafFunction ) const;
+
+      /**
+       * @brief Copies the bounds of the refitted binary BVH it was collapsed from. The tree structure doesn't change
+       *
+       * Only the nodes above the changed primitives are updated, so the cost is O(changed primitives * tree depth), like BVH::refit.
+       * The parent links needed for it are computed by the first refit
+       * @param bvh The binary BVH after its refit. It must not have been rebuilt since the collapse
+       * @param changedPositions Positions of the changed primitives in the BVH order, as passed to BVH::refit
+       */
+      void refit( const BVH& bvh, const std::vector<uint32_t>& changedPositions );
+
+      [[nodiscard]] bool isEmpty() const;
+
+      /**
+       * @return Number of children per node, 0 if the tree is empty
+       */
+      [[nodiscard]] unsigned int getWidth() const;
+
+      [[nodiscard]] size_t getNodeCount() const;
+
+   private:
+      static constexpr uint32_t NO_SOURCE = UINT32_MAX;
+
+      template<int WIDTH>
+      void collapse( const BVH& bvh, std::vector<WideNode<WIDTH>>& nodes );
+
+      template<int WIDTH>
+      void refitNodes( const BVH& bvh, const std::vector<uint32_t>& changedPositions, std::vector<WideNode<WIDTH>>& nodes );
+
+      // Computes the parent links and the node of every primitive when the first refit needs them
+      template<int WIDTH>
+      void prepareRefit( const std::vector<WideNode<WIDTH>>& nodes );
+
+      std::vector<WideNode<4>> nodes4;
+      std::vector<WideNode<8>> nodes8;
+      // Binary node of every child, node * width + lane. NO_SOURCE for the unused children
+      std::vector<uint32_t> sources;
+      // Refit data, empty until the first refit
+      std::vector<uint32_t> parents;
+      std::vector<uint32_t> primitiveNodes;
+};
+
+template<typename LeafFunction>
+bool WideBVH::traverse( const Vector3f& origin, const Vector3f& inverseDirection, float& maxDistance, LeafFunction&& leafFunction ) const
+{
+#if SIMD_X86
+   if( !nodes8.empty() )
+      return WideKernels::AVX2::traverse( nodes8.data(), origin, inverseDirection, maxDistance, leafFunction );
+   if( !nodes4.empty() )
+      return WideKernels::SSE::traverse( nodes4.data(), origin, inverseDirection, maxDistance, leafFunction );
+#endif
+   return false;
+}
+
+#endif //SEQUENCIAL_WIDEBVH_H
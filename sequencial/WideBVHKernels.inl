@@ -0,0 +1,87 @@
+//
+// Created by dominik on 18.10.26.
+//
+
+// No include guard. This file is included by WideBVH.h once per instruction set, inside a namespace which defines
+// the Float register type (Simd::Float4 or Simd::Float8). See Simd.h
+
+/**
+ * Traverses a wide BVH with one ray. All children of a node are tested by one slab test, the same math as AABB::intersects.
+ * The children which are hit are sorted by the entry distance and pushed to the stack, so the closest one is visited first
+ */
+template<typename LeafFunction>
+bool traverse( const WideNode<Float::WIDTH>* nodes, const Vector3f& origin, const Vector3f& inverseDirection, float& maxDistance,
+               LeafFunction&& leafFunction )
+{
+   constexpr int WIDTH = Float::WIDTH;
+   struct Entry
+   {
+      uint32_t child;
+      uint32_t count;
+      float distance;
+   };
+
+   // Every level of the binary tree adds at most WIDTH - 1 postponed children
+   Entry stack[ BVH::MAX_DEPTH * ( WIDTH - 1 ) + WIDTH ];
+   int stackSize = 0;
+
+   Float originX = Float::broadcast( origin.x() ), originY = Float::broadcast( origin.y() ), originZ = Float::broadcast( origin.z() );
+   Float inverseX = Float::broadcast( inverseDirection.x() ), inverseY = Float::broadcast( inverseDirection.y() ),
+         inverseZ = Float::broadcast( inverseDirection.z() );
+   Float zero = Float::broadcast( 0.f );
+   uint32_t current = 0;
+
+   while( true )
+   {
+      const WideNode<WIDTH>& node = nodes[ current ];
+      Float tx1 = ( Float::load( node.minX ) - originX ) * inverseX;
+      Float tx2 = ( Float::load( node.maxX ) - originX ) * inverseX;
+      Float ty1 = ( Float::load( node.minY ) - originY ) * inverseY;
+      Float ty2 = ( Float::load( node.maxY ) - originY ) * inverseY;
+      Float tz1 = ( Float::load( node.minZ ) - originZ ) * inverseZ;
+      Float tz2 = ( Float::load( node.maxZ ) - originZ ) * inverseZ;
+
+      Float tMin = max( max( min( tx1, tx2 ), min( ty1, ty2 ) ), min( tz1, tz2 ) );
+      Float tMax = min( min( max( tx1, tx2 ), max( ty1, ty2 ) ), max( tz1, tz2 ) );
+      int hits = moveMask( greaterOrEqual( tMax, max( tMin, zero ) ) & lessThan( tMin, Float::broadcast( maxDistance ) ) );
+
+      if( hits != 0 )
+      {
+         alignas( 32 ) float entries[ WIDTH ];
+         tMin.store( entries );
+
+         // Insertion sort of the hit children, farthest first, so the closest one ends on the top of the stack. Ties keep the lane order
+         int first = stackSize;
+         for( ; hits != 0; hits &= hits - 1 )
+         {
+            int lane = __builtin_ctz( static_cast<unsigned int>( hits ) );
+            Entry entry{ node.child[ lane ], node.count[ lane ], entries[ lane ] };
+            int position = stackSize++;
+            while( position > first && stack[ position - 1 ].distance <= entry.distance )
+            {
+               stack[ position ] = stack[ position - 1 ];
+               --position;
+            }
+            stack[ position ] = entry;
+         }
+      }
+
+      // Pop the leaves and stop at the next interior node which is still closer than the closest hit
+      while( true )
+      {
+         if( stackSize == 0 )
+            return false;
+
+         const Entry& entry = stack[ --stackSize ];
+         if( entry.distance >= maxDistance )
+            continue;
+         if( entry.count == 0 )
+         {
+            current = entry.child;
+            break;
+         }
+         if( leafFunction( entry.child, entry.count, maxDistance ) )
+            return true;
+      }
+   }
+}
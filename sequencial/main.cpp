@@ -1,78 +1,175 @@
 #include "RayTracer.h"
 #include "Levels.h"
-#include "lodepng.h"
+#include "SceneFile.h"
+#include "ImageWriter.h"
+#include "FrameCache.h"
 #include <memory>
 #include <chrono>
 #include <iostream>
-
-void chooseLevel( int levelID, TracerOptions& options, std::vector<std::shared_ptr<SceneObject>>& objects, std::vector<Light>& lights )
-{
-   // TODO ugly, use map
-   switch( levelID )
-   {
-      case 1:
-         BasicLevel().loadLevel( options, objects, lights );
-         break;
-      case 2:
-         LightColors().loadLevel( options, objects, lights );
-         break;
-      case 3:
-         HighResLights().loadLevel( options, objects, lights );
-         break;
-      case 4:
-         LightCombination().loadLevel( options, objects, lights );
-         break;
-      case 5:
-         Space().loadLevel( options, objects, lights );
-         break;
-      default:
-         throw std::runtime_error( "Invalid level ID" );
-   }
-}
+#include <stdexcept>
+#include <string>
 
 int main( int argc, char** argv ){
    static constexpr int RGBABytes = 4;
 
    TracerOptions options;
-   if( argc != 2 )
+   if( argc < 2 )
    {
-      std::cout << "Usage: " << argv[ 0 ] << " <level ID>" << std::endl;
-      std::cout << "Available levels: 1, 2, 3, 4, 5, 6" << std::endl;
+      std::cout << "Usage: " << argv[ 0 ] << " <level ID|scene.json|scene.rtscene|procedural level> [output file] [fast|balanced|max]"
+            " [--cache <directory>] [--cache-size <MB>]" << std::endl;
+      std::cout << "Available levels: 1 - " << LEVEL_COUNT << ", a scene loaded from a JSON file, or a binary scene made by sceneconvert" << std::endl;
+      std::cout << "Procedural levels: grid|clusters|overlap[:spheres=N][:blocks=N][:lights=N][:seed=N][:width=N][:height=N], e.g. grid:spheres=1M" <<
+            std::endl;
+      std::cout << "The output format is chosen by the extension: .png (default output.png), .ppm, .pfm (colors before tone mapping), or .qoi" << std::endl;
+      std::cout << "The last argument sets the PNG compression level (balanced by default)" << std::endl;
+      std::cout << "--cache copies the frame from the cache directory if the same scene was rendered with the same options before, "
+            "and stores the rendered frames there. The least recently used frames over the size limit (1024 MB by default) are evicted" << std::endl;
       return -1;
    }
 
-   // TODO better invalid string handling
-   int levelID = std::stoi( argv[ 1 ] );
+   std::string levelArgument = argv[ 1 ];
+   std::string outputPath = "output.png";
+   CompressionLevel compressionLevel = CompressionLevel::BALANCED;
+   std::string cacheDirectory;
+   uint64_t cacheSize = FrameCache::DEFAULT_MAX_SIZE;
+   for( int i = 2; i < argc; ++i )
+   {
+      std::string argument = argv[ i ];
+      if( ( argument == "--cache" || argument == "--cache-size" ) && i + 1 == argc )
+      {
+         std::cerr << argument << " needs a value" << std::endl;
+         return -1;
+      }
+
+      if( argument == "--cache" )
+         cacheDirectory = argv[ ++i ];
+      else if( argument == "--cache-size" )
+      {
+         auto size = FrameCache::parseMegabytes( argv[ ++i ] );
+         if( !size )
+         {
+            std::cerr << "--cache-size needs a size in MB" << std::endl;
+            return -1;
+         }
+         cacheSize = *size;
+      }
+      else if( argument == "fast" )
+         compressionLevel = CompressionLevel::FAST;
+      else if( argument == "balanced" )
+         compressionLevel = CompressionLevel::BALANCED;
+      else if( argument == "max" )
+         compressionLevel = CompressionLevel::MAX;
+      else
+         outputPath = argument;
+   }
+
+   // The file can only be opened once the scene gives the image size, but a wrong format is reported before the scene is loaded
+   try
+   {
+      ImageWriter::checkFormat( outputPath );
+   }
+   catch( const std::runtime_error& error )
+   {
+      std::cerr << error.what() << std::endl;
+      return -1;
+   }
 
    RayTracer rayTracer;
 
-   std::vector<std::shared_ptr<SceneObject>> objects;
+   auto loadStart = std::chrono::high_resolution_clock::now();
+   Scene scene;
    std::vector<Light> lights;
-   chooseLevel( levelID, options, objects, lights );
+   try
+   {
+      // A binary scene is mapped as it is, the other levels are generated or loaded and built
+      if( levelArgument.ends_with( ".rtscene" ) )
+         scene = SceneFile::load( levelArgument, options, lights );
+      else
+         scene = createLevel( levelArgument )->loadScene( options, lights );
+   }
+   catch( const std::runtime_error& error )
+   {
+      std::cerr << error.what() << std::endl;
+      return -1;
+   }
 
    auto start = std::chrono::high_resolution_clock::now();
+   std::cout << "Scene loading took " << std::chrono::duration_cast<std::chrono::milliseconds>( start - loadStart ).count() << " ms" <<
+         std::endl;
+
+   // The scene is loaded even on a hit, the key hashes the built scene, so it covers the levels and scene files the same way
+   std::unique_ptr<FrameCache> cache;
+   std::string frameKey;
+   if( !cacheDirectory.empty() )
+   {
+      try
+      {
+         cache = std::make_unique<FrameCache>( cacheDirectory, cacheSize );
+      }
+      catch( const std::filesystem::filesystem_error& error )
+      {
+         std::cerr << error.what() << std::endl;
+         return -1;
+      }
 
-   auto image = RayTracer::generateRawImage( options, objects, lights );
+      frameKey = FrameCache::frameKey( FrameCache::sceneKey( scene, lights ), options, outputPath, compressionLevel );
+      if( cache->fetch( frameKey, outputPath ) )
+      {
+         std::cout << "Frame cache hit " << frameKey << ", copied in " << std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::high_resolution_clock::now() - start ).count() << " ms" << std::endl;
+         return 0;
+      }
+      start = std::chrono::high_resolution_clock::now();
+   }
+
+   // The rows are written to the file as they are rendered, the whole image is never kept in memory
+   // The tiles are rendered and the PNG file is compressed by the same options.threadCount threads
+   RenderStats stats;
+   ThreadPool pool( options.threadCount );
+   try
+   {
+      auto writer = ImageWriter::create( outputPath, options.imageWidth, options.imageHeight, compressionLevel, pool );
+      if( writer->isHdr() )
+      {
+         RayTracer::generateRows( options, scene, lights, [ & ]( unsigned int, const Color* row )
+         {
+            writer->writeColorRow( row );
+         }, &stats, &pool );
+      }
+      else
+      {
+         RayTracer::generateRawRows( options, scene, lights, [ & ]( unsigned int, const unsigned char* row )
+         {
+            writer->writeRow( row );
+         }, &stats, &pool );
+      }
+      writer->finish();
+   }
+   catch( const std::runtime_error& error )
+   {
+      std::cerr << error.what() << std::endl;
+      return -1;
+   }
 
    auto end = std::chrono::high_resolution_clock::now();
    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>( end - start );
    std::cout << "Image generation took " << duration.count() << " ms" << std::endl;
-   std::cout << "Image is: " << options.imageWidth << "x" << options.imageHeight << " == " << image.size() / RGBABytes <<
-         " pixels and " << image.size() << " bytes." <<
+   std::cout << "Image is: " << options.imageWidth << "x" << options.imageHeight << " == " << options.imageWidth * options.imageHeight <<
+         " pixels and " << static_cast<size_t>( options.imageWidth ) * options.imageHeight * RGBABytes << " bytes." <<
          std::endl;
+   std::cout << "Rays: " << stats.primary << " primary, " << stats.secondary << " secondary, " << stats.shadow << " shadow" << std::endl;
+   if( Stats::ENABLED )
+   {
+      std::cout << "Intersection tests: " << stats.sphereTests << " spheres, " << stats.planeTests << " planes, " << stats.blockTests <<
+            " blocks, " << stats.triangleTests << " triangles, " << stats.instanceTests << " instances" << std::endl;
+      std::cout << "Hits: " << stats.hits << ", occluded lights: " << stats.occludedLights << std::endl;
+   }
 
-   /*
-   // Convert to lodepng format
-   std::vector<unsigned char> image( pixels.size() * RGBABytes );
-
-   for( size_t i = 0; i < pixels.size(); ++i )
+   if( cache )
    {
-      image[ i * RGBABytes + 0 ] = pixels[ i ].R;
-      image[ i * RGBABytes + 1 ] = pixels[ i ].G;
-      image[ i * RGBABytes + 2 ] = pixels[ i ].B;
-      image[ i * RGBABytes + 3 ] = pixels[ i ].alpha;
+      bool stored = cache->store( frameKey, outputPath );
+      auto cacheStats = cache->getStatistics();
+      std::cout << "Frame cache miss " << frameKey << ( stored ? ", stored" : ", not stored" ) << ". The cache has " << cacheStats.frameCount <<
+            " frames, " << ( cacheStats.size >> 20 ) << " MB" << std::endl;
    }
-*/
-   // Generating png
-   lodepng::encode( "output.png", image, options.imageWidth, options.imageHeight );
 }